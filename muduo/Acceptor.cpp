@@ -4,33 +4,80 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <unistd.h>
 
-static int createNonBlocking(){
-	int sockfd=::socket(AF_INET,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+static int createNonBlocking(sa_family_t family){
+	int sockfd=::socket(family,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
 	if(sockfd<0){
 		LOG_FATAL("%s:%s:%d  listen socket create err:%d \n",__FILE__, __FUNCTION__, __LINE__,errno);
 	}
 	return sockfd;
 }
 
+//path上是上次退出时留下的socket文件(没有进程在监听)时删除它；普通文件和正在使用的socket都不动，留给bind报错
+static void removeStaleUnixSocket(const InetAddress& listenAddr,const std::string& path){
+	struct stat st;
+	if(::lstat(path.c_str(),&st)<0||!S_ISSOCK(st.st_mode)){
+		return;
+	}
+	int probe=::socket(AF_UNIX,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+	if(probe<0){
+		return;
+	}
+	//ECONNREFUSED说明没有人监听；连上了或者EAGAIN(backlog满)说明另一个服务器还在用
+	if(::connect(probe,listenAddr.sockAddr(),listenAddr.sockAddrLen())<0&&errno==ECONNREFUSED){
+		::unlink(path.c_str());
+	}
+	::close(probe);
+}
+
 Acceptor::Acceptor(EventLoop *loop, const InetAddress& listenAddr, bool reuseport)
 	:loop_(loop)
-	,acceptSocket_(createNonBlocking())
-	,acceptChannel_(loop_,acceptChannel_.fd())
+	,acceptSocket_(createNonBlocking(listenAddr.family()))
+	,acceptChannel_(loop_,acceptSocket_.fd())
 	,listenning_(false)
 	,reuseport_(reuseport)
+	,unixDev_(0)
+	,unixIno_(0)
 {
-	acceptSocket_.setReuseAddr(true);
-	acceptSocket_.setReusePort(true);
+	if(listenAddr.isUnix()){
+		//上次退出时留下的socket文件会让bind失败，抽象命名空间的地址不对应文件
+		std::string path=listenAddr.unixPath();
+		if(!path.empty()&&path[0]!='@'){
+			removeStaleUnixSocket(listenAddr,path);
+			unixPath_=path;
+		}
+	}
+	else{
+		acceptSocket_.setReuseAddr(true);
+		acceptSocket_.setReusePort(reuseport_);
+	}
 	acceptSocket_.bindAddress(listenAddr);
+	if(!unixPath_.empty()){	//记下自己创建的文件，析构时只删除它
+		struct stat st;
+		if(::lstat(unixPath_.c_str(),&st)==0){
+			unixDev_=st.st_dev;
+			unixIno_=st.st_ino;
+		}
+		else{
+			unixPath_.clear();
+		}
+	}
 	acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead,this));
 
 }
 Acceptor::~Acceptor(){
 	acceptChannel_.disableAll();
 	acceptChannel_.remove();
+	if(!unixPath_.empty()){
+		//文件可能已经被别人删除重建，还是我们bind出来的那个socket才删除
+		struct stat st;
+		if(::lstat(unixPath_.c_str(),&st)==0&&S_ISSOCK(st.st_mode)&&st.st_dev==unixDev_&&st.st_ino==unixIno_){
+			::unlink(unixPath_.c_str());
+		}
+	}
 }
 
 
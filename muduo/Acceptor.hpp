@@ -1,5 +1,7 @@
 #pragma once
 #include <functional>
+#include <string>
+#include <sys/types.h>
 
 #include "noncopyable.hpp"
 #include "Socket.hpp"
@@ -24,4 +26,7 @@ private:
 	NewConnectionCallback newConnectionCallback_;
 	bool listenning_;
 	bool reuseport_;
+	std::string unixPath_;	//监听AF_UNIX文件路径时，析构时删除socket文件
+	dev_t unixDev_;	//bind出来的socket文件，析构时确认还是它才删除
+	ino_t unixIno_;
 };
\ No newline at end of file
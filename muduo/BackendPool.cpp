@@ -0,0 +1,225 @@
+#include "BackendPool.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+#include "EventLoopThreadPool.hpp"
+#include "TcpClient.hpp"
+#include "TcpConnection.hpp"
+
+#include <algorithm>
+#include <future>
+
+BackendPool::BackendPool(EventLoopThreadPool* threadPool,const std::vector<InetAddress>& backends,const std::string& nameArg)
+	:name_(nameArg)
+	,minConnections_(1)
+	,maxConnections_(4)
+	,maxPendingPerConnection_(1)
+	,maxFailures_(5)
+	,ejectionSeconds_(10)
+	,connectionCallback_(defaultConnectionCallback)
+	,messageCallback_(defaultMessageCallback)
+{
+	if(!threadPool->started()){
+		LOG_FATAL("BackendPool [%s] thread pool is not started \n",name_.c_str());
+	}
+	for(EventLoop* loop:threadPool->getAllLoops()){
+		std::shared_ptr<LoopPool> pool=std::make_shared<LoopPool>();
+		pool->loop=loop;
+		pool->next=0;
+		pool->backends.reserve(backends.size());
+		for(const InetAddress& addr:backends){
+			Backend backend;
+			backend.addr=addr;
+			backend.outstanding=0;
+			backend.failures=0;
+			pool->backends.push_back(std::move(backend));
+		}
+		poolByLoop_[loop]=pool.get();
+		pools_.push_back(std::move(pool));
+	}
+}
+
+//连接和回调都属于各自的loop，要在loop线程里销毁
+BackendPool::~BackendPool(){
+	for(std::shared_ptr<LoopPool>& pool:pools_){
+		EventLoop* loop=pool->loop;
+		std::shared_ptr<LoopPool> victim(std::move(pool));
+		if(loop->isInLoopThread()){
+			victim.reset();
+		}
+		else{
+			std::promise<void> done;
+			loop->runInLoop([&victim,&done](){
+				victim.reset();
+				done.set_value();
+			});
+			done.get_future().wait();
+		}
+	}
+}
+
+void BackendPool::setConnectionLimits(int minPerBackend,int maxPerBackend){
+	minConnections_=std::max(minPerBackend,0);
+	maxConnections_=std::max(maxPerBackend,std::max(minConnections_,1));
+}
+
+void BackendPool::start(){
+	for(const std::shared_ptr<LoopPool>& pool:pools_){
+		LoopPool* p=pool.get();
+		pool->loop->runInLoop([this,p](){ startInLoop(p); });
+	}
+}
+
+void BackendPool::startInLoop(LoopPool* pool){
+	for(Backend& backend:pool->backends){
+		while(static_cast<int>(backend.members.size())<minConnections_){
+			addMember(pool,backend);
+		}
+	}
+}
+
+void BackendPool::addMember(LoopPool* pool,Backend& backend){
+	std::unique_ptr<Member> member(new Member);
+	member->outstanding=0;
+	member->client.reset(new TcpClient(pool->loop,backend.addr,name_));
+	member->client->enableRetry();
+
+	Member* m=member.get();
+	Backend* b=&backend;
+	std::weak_ptr<LoopPool> weakPool;
+	for(const std::shared_ptr<LoopPool>& p:pools_){
+		if(p.get()==pool){
+			weakPool=p;
+		}
+	}
+	ConnectionCallback userCallback=connectionCallback_;
+	//池析构以后连接上还可能有回调，只在池还活着时更新状态
+	member->client->setConnectionCallback([this,weakPool,m,b,userCallback](const TcpConnectionPtr& conn){
+		std::shared_ptr<LoopPool> alive=weakPool.lock();
+		if(alive){
+			if(conn->connected()){
+				m->conn=conn;
+			}
+			else{
+				m->conn.reset();
+				recordFailure(*b);	//连接意外断开也算一次失败
+			}
+		}
+		userCallback(conn);
+	});
+	//后端一直连不上(例如ECONNREFUSED)时从来不会有连接回调，连接失败也要计数，否则永远不会被摘除
+	member->client->setConnectErrorCallback([this,weakPool,b](int err){
+		std::shared_ptr<LoopPool> alive=weakPool.lock();
+		if(alive){
+			LOG_INFO("BackendPool [%s] connect to %s failed, errno %d \n",name_.c_str(),b->addr.toIpPort().c_str(),err);
+			recordFailure(*b);
+		}
+	});
+	member->client->setMessageCallback(messageCallback_);
+	member->client->connect();
+	backend.members.push_back(std::move(member));
+}
+
+BackendPool::LoopPool* BackendPool::poolOf(EventLoop* loop)const{
+	auto it=poolByLoop_.find(loop);
+	return it==poolByLoop_.end()?nullptr:it->second;
+}
+
+bool BackendPool::ejected(const Backend& backend,Timestamp now)const{
+	return backend.ejectedUntil.valid()&&now<backend.ejectedUntil;
+}
+
+//已连接的成员里未完成请求最少的一个
+BackendPool::Member* BackendPool::pickMember(Backend& backend){
+	Member* best=nullptr;
+	for(const std::unique_ptr<Member>& member:backend.members){
+		if(member->conn&&member->conn->connected()){
+			if(best==nullptr||member->outstanding<best->outstanding){
+				best=member.get();
+			}
+		}
+	}
+	return best;
+}
+
+BackendPool::Lease BackendPool::acquire(EventLoop* loop){
+	Lease lease;
+	LoopPool* pool=poolOf(loop);
+	if(pool==nullptr){
+		LOG_ERROR("BackendPool::acquire [%s] loop %p is not in the pool \n",name_.c_str(),loop);
+		return lease;
+	}
+	const Timestamp now=Timestamp::now();
+	const size_t n=pool->backends.size();
+	Backend* bestBackend=nullptr;
+	Member* bestMember=nullptr;
+	for(size_t i=0;i<n;++i){
+		Backend& backend=pool->backends[(pool->next+i)%n];
+		if(ejected(backend,now)){
+			continue;
+		}
+		Member* member=pickMember(backend);
+		if(member==nullptr){
+			continue;
+		}
+		if(bestBackend==nullptr||backend.outstanding<bestBackend->outstanding){
+			bestBackend=&backend;
+			bestMember=member;
+		}
+	}
+	if(n>0){
+		pool->next=(pool->next+1)%n;
+	}
+	if(bestBackend==nullptr){
+		return lease;
+	}
+	//选中的连接已经忙了，在上限以内再建一条，本次仍然使用现有连接
+	if(bestMember->outstanding>=maxPendingPerConnection_
+		&&static_cast<int>(bestBackend->members.size())<maxConnections_){
+		addMember(pool,*bestBackend);
+	}
+	++bestBackend->outstanding;
+	++bestMember->outstanding;
+	lease.conn_=bestMember->conn;
+	lease.member_=bestMember;
+	lease.backend_=bestBackend;
+	return lease;
+}
+
+void BackendPool::release(Lease& lease,bool ok){
+	if(!lease){
+		return;
+	}
+	--lease.member_->outstanding;
+	--lease.backend_->outstanding;
+	if(ok){
+		lease.backend_->failures=0;
+	}
+	else{
+		recordFailure(*lease.backend_);
+	}
+	lease=Lease();
+}
+
+void BackendPool::recordFailure(Backend& backend){
+	if(++backend.failures>=maxFailures_){
+		backend.ejectedUntil=addTime(Timestamp::now(),ejectionSeconds_);
+		//恢复以后再失败一次就重新摘除，成功一次才清零
+		backend.failures=maxFailures_-1;
+		LOG_ERROR("BackendPool [%s] eject %s for %.1f seconds \n",name_.c_str(),backend.addr.toIpPort().c_str(),ejectionSeconds_);
+	}
+}
+
+size_t BackendPool::connectedCount(EventLoop* loop)const{
+	size_t count=0;
+	LoopPool* pool=poolOf(loop);
+	if(pool){
+		for(const Backend& backend:pool->backends){
+			for(const std::unique_ptr<Member>& member:backend.members){
+				if(member->conn&&member->conn->connected()){
+					++count;
+				}
+			}
+		}
+	}
+	return count;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "noncopyable.hpp"
+#include "InetAddress.hpp"
+#include "Callbacks.hpp"
+#include "Timestamp.hpp"
+
+class EventLoop;
+class EventLoopThreadPool;
+class TcpClient;
+
+/*
+后端长连接池：EventLoopThreadPool里的每个loop各有一组到所有后端的连接
+在loop N上处理的请求只使用loop N拥有的后端连接，全程不跨线程
+- 每个loop、每个后端保持[min,max]条连接，start时先建立min条预热
+- 按未完成请求数最少选择后端和连接，连接都忙时在max以内新建连接
+- 连续失败(请求失败、连接意外断开或者连接失败)达到阈值的后端被摘除一段时间，期间不再选择
+除start之外的接口都只能在对应的loop线程里调用；BackendPool要在loop线程退出之前析构
+*/
+class BackendPool:noncopyable{
+private:
+	struct Member;
+	struct Backend;
+public:
+	//一次借用：记录借出的连接，请求完成以后交给release
+	class Lease{
+	public:
+		Lease():member_(nullptr),backend_(nullptr){}
+		explicit operator bool()const{return member_!=nullptr;}
+		const TcpConnectionPtr& connection()const{return conn_;}
+	private:
+		friend class BackendPool;
+		TcpConnectionPtr conn_;
+		Member* member_;
+		Backend* backend_;
+	};
+
+	BackendPool(EventLoopThreadPool* threadPool,const std::vector<InetAddress>& backends,const std::string& nameArg);
+	~BackendPool();
+
+	//以下设置都需要在start之前调用
+	void setConnectionLimits(int minPerBackend,int maxPerBackend);
+	//一条连接上未完成的请求达到这个数就算忙，不支持多路复用的协议用1
+	void setMaxPendingPerConnection(int n){maxPendingPerConnection_=n;}
+	//连续失败maxFailures次以后摘除seconds秒
+	void setEjection(int maxFailures,double seconds){maxFailures_=maxFailures;ejectionSeconds_=seconds;}
+	void setConnectionCallback(const ConnectionCallback& cb){connectionCallback_=cb;}
+	void setMessageCallback(const MessageCallback& cb){messageCallback_=cb;}
+
+	//在每个loop里建立min条连接，线程安全
+	void start();
+
+	//从loop自己的连接里选一条，没有可用连接时返回空的Lease
+	Lease acquire(EventLoop* loop);
+	//请求完成，ok为false时记一次失败
+	void release(Lease& lease,bool ok);
+
+	//loop上可以使用的连接数
+	size_t connectedCount(EventLoop* loop)const;
+
+private:
+	struct Member{
+		std::unique_ptr<TcpClient> client;
+		TcpConnectionPtr conn;	//在连接回调里更新，避免每次acquire都去拿TcpClient的锁
+		int outstanding;
+	};
+	struct Backend{
+		InetAddress addr;
+		std::vector<std::unique_ptr<Member>> members;
+		int outstanding;
+		int failures;	//连续失败次数
+		Timestamp ejectedUntil;
+	};
+	struct LoopPool{
+		EventLoop* loop;
+		std::vector<Backend> backends;
+		size_t next;	//未完成请求数相同时轮流选择
+	};
+
+	LoopPool* poolOf(EventLoop* loop)const;
+	void startInLoop(LoopPool* pool);
+	void addMember(LoopPool* pool,Backend& backend);
+	Member* pickMember(Backend& backend);
+	void recordFailure(Backend& backend);
+	bool ejected(const Backend& backend,Timestamp now)const;
+
+	const std::string name_;
+	std::vector<std::shared_ptr<LoopPool>> pools_;	//连接回调里用weak_ptr判断池是否已经析构
+	std::unordered_map<EventLoop*,LoopPool*> poolByLoop_;	//构造以后只读
+	int minConnections_;
+	int maxConnections_;
+	int maxPendingPerConnection_;
+	int maxFailures_;
+	double ejectionSeconds_;
+	ConnectionCallback connectionCallback_;
+	MessageCallback messageCallback_;
+};
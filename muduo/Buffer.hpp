@@ -2,6 +2,10 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <assert.h>
 
 class Buffer{
 public:
@@ -11,6 +15,12 @@ public:
 		:buffer_(kCheapPrepend+initialSize)
 		,readerIndex_(kCheapPrepend)
 		,writerIndex_(kCheapPrepend){}
+	void swap(Buffer& rhs){
+		buffer_.swap(rhs.buffer_);
+		std::swap(readerIndex_,rhs.readerIndex_);
+		std::swap(writerIndex_,rhs.writerIndex_);
+	}
+
 	size_t readableBytes() const{
 		return writerIndex_-readerIndex_;
 	}
@@ -20,6 +30,9 @@ public:
 	size_t prependableBytes()const{
 		return readerIndex_;
 	}
+	size_t internalCapacity()const{
+		return buffer_.capacity();
+	}
 
 	//返回缓冲区中可读元素的起始地址
 	const char* peek()const{
@@ -40,6 +53,11 @@ public:
 		readerIndex_=writerIndex_=kCheapPrepend;
 	}
 
+	void retrieveInt64(){retrieve(sizeof(int64_t));}
+	void retrieveInt32(){retrieve(sizeof(int32_t));}
+	void retrieveInt16(){retrieve(sizeof(int16_t));}
+	void retrieveInt8(){retrieve(sizeof(int8_t));}
+
 	//把onMessage上报的Buffer数据，转成string类型的数据返回
 	std::string retrieveAllAsString(){
 		return retrieveAsString(readableBytes());  
@@ -64,6 +82,98 @@ public:
 		writerIndex_+=len;
 	}
 
+	void append(const void* data,size_t len){
+		append(static_cast<const char*>(data),len);
+	}
+
+	//以网络字节序追加整数
+	void appendInt64(int64_t x){
+		int64_t be64=htobe64(x);
+		append(&be64,sizeof(be64));
+	}
+	void appendInt32(int32_t x){
+		int32_t be32=htobe32(x);
+		append(&be32,sizeof(be32));
+	}
+	void appendInt16(int16_t x){
+		int16_t be16=htobe16(x);
+		append(&be16,sizeof(be16));
+	}
+	void appendInt8(int8_t x){
+		append(&x,sizeof(x));
+	}
+
+	//从可读区域读取网络字节序的整数，并移动readerIndex_
+	int64_t readInt64(){
+		int64_t result=peekInt64();
+		retrieveInt64();
+		return result;
+	}
+	int32_t readInt32(){
+		int32_t result=peekInt32();
+		retrieveInt32();
+		return result;
+	}
+	int16_t readInt16(){
+		int16_t result=peekInt16();
+		retrieveInt16();
+		return result;
+	}
+	int8_t readInt8(){
+		int8_t result=peekInt8();
+		retrieveInt8();
+		return result;
+	}
+
+	//只查看不读取，要求readableBytes()>=sizeof(intN_t)
+	int64_t peekInt64()const{
+		assert(readableBytes()>=sizeof(int64_t));
+		int64_t be64=0;
+		::memcpy(&be64,peek(),sizeof(be64));
+		return be64toh(be64);
+	}
+	int32_t peekInt32()const{
+		assert(readableBytes()>=sizeof(int32_t));
+		int32_t be32=0;
+		::memcpy(&be32,peek(),sizeof(be32));
+		return be32toh(be32);
+	}
+	int16_t peekInt16()const{
+		assert(readableBytes()>=sizeof(int16_t));
+		int16_t be16=0;
+		::memcpy(&be16,peek(),sizeof(be16));
+		return be16toh(be16);
+	}
+	int8_t peekInt8()const{
+		assert(readableBytes()>=sizeof(int8_t));
+		return *peek();
+	}
+
+	//把数据写到可读区域的前面，使用kCheapPrepend预留的空间，不需要搬移已有数据
+	void prepend(const void* data,size_t len){
+		assert(len<=prependableBytes());
+		readerIndex_-=len;
+		const char* d=static_cast<const char*>(data);
+		std::copy(d,d+len,begin()+readerIndex_);
+	}
+
+	//以网络字节序在可读区域前面写入整数，常用于先写消息体再补长度头
+	void prependInt64(int64_t x){
+		int64_t be64=htobe64(x);
+		prepend(&be64,sizeof(be64));
+	}
+	void prependInt32(int32_t x){
+		int32_t be32=htobe32(x);
+		prepend(&be32,sizeof(be32));
+	}
+	void prependInt16(int16_t x){
+		int16_t be16=htobe16(x);
+		prepend(&be16,sizeof(be16));
+	}
+	void prependInt8(int8_t x){
+		prepend(&x,sizeof(x));
+	}
+
 	char* beginWrite(){
 		return begin()+writerIndex_;
 	}
@@ -72,6 +182,17 @@ public:
 		return begin()+writerIndex_;
 	}
 
+	//直接往beginWrite()写入len字节以后调用
+	void hasWritten(size_t len){
+		assert(len<=wirtableBytes());
+		writerIndex_+=len;
+	}
+	//撤销最后写入的len字节
+	void unwrite(size_t len){
+		assert(len<=readableBytes());
+		writerIndex_-=len;
+	}
+
 	//从fd上读取数据
 	ssize_t readFd(int fd,int* saveErrno);
 	//从fd上发送数据
@@ -0,0 +1,177 @@
+#pragma once
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+/*
+代替std::function的回调类型，目标对象不超过kInlineSize字节时直接存放在内部，不需要堆分配
+kInlineSize能放下 std::bind(&Class::method,this,shared_ptr) 或者捕获几个指针和shared_ptr的lambda
+libstdc++的std::function只能内部存放16字节以内、可平凡拷贝的对象，绑定了shared_ptr的回调每次都要new
+Callable可以拷贝(例如TcpServer把用户回调拷贝给每个连接)，放进去的目标对象必须可拷贝，否则编译失败
+要存放只能移动的目标(捕获了unique_ptr或者另一个MoveOnlyCallable)时用MoveOnlyCallable
+*/
+template<typename Signature,bool Copyable=true>
+class Callable;
+
+template<typename Signature>
+using MoveOnlyCallable=Callable<Signature,false>;
+
+template<typename R,typename... Args,bool Copyable>
+class Callable<R(Args...),Copyable>{
+	struct Disabled{};
+	//MoveOnlyCallable没有拷贝构造，只声明了移动构造时编译器生成的拷贝构造是deleted
+	using CopySource=typename std::conditional<Copyable,Callable,Disabled>::type;
+
+public:
+	static const size_t kInlineSize=48;
+
+	Callable():ops_(nullptr){}
+	Callable(std::nullptr_t):ops_(nullptr){}
+
+	template<typename F,typename=typename std::enable_if<
+		!std::is_same<typename std::decay<F>::type,Callable>::value>::type>
+	Callable(F&& f):ops_(nullptr){
+		using Target=typename std::decay<F>::type;
+		static_assert(!Copyable||std::is_copy_constructible<Target>::value,
+			"Callable target must be copyable, use MoveOnlyCallable for move-only targets");
+		if(!isEmpty(f)){
+			construct<Target>(std::integral_constant<bool,fitsInline<Target>()>(),std::forward<F>(f));
+		}
+	}
+
+	Callable(Callable&& rhs)noexcept:ops_(rhs.ops_){
+		if(ops_){
+			ops_->move(&rhs.storage_,&storage_);
+			rhs.ops_=nullptr;
+		}
+	}
+
+	Callable(const CopySource& rhs):ops_(rhs.ops_){
+		if(ops_){
+			rhs.ops_->copy(&rhs.storage_,&storage_);
+		}
+	}
+
+	~Callable(){reset();}
+
+	Callable& operator=(Callable&& rhs)noexcept{
+		if(this!=&rhs){
+			reset();
+			if(rhs.ops_){
+				rhs.ops_->move(&rhs.storage_,&storage_);
+				ops_=rhs.ops_;
+				rhs.ops_=nullptr;
+			}
+		}
+		return *this;
+	}
+
+	Callable& operator=(const CopySource& rhs){
+		if(this!=&rhs){
+			Callable tmp(rhs);
+			*this=std::move(tmp);
+		}
+		return *this;
+	}
+
+	Callable& operator=(std::nullptr_t){
+		reset();
+		return *this;
+	}
+
+	explicit operator bool()const{return ops_!=nullptr;}
+
+	R operator()(Args... args)const{
+		return ops_->invoke(const_cast<Storage*>(&storage_),std::forward<Args>(args)...);
+	}
+
+private:
+	using Storage=typename std::aligned_storage<kInlineSize,alignof(max_align_t)>::type;
+
+	using CopyFunc=void (*)(const void* from,void* to);
+	struct Ops{
+		R (*invoke)(void* storage,Args&&... args);
+		void (*move)(void* from,void* to);	//移动到to并销毁from
+		CopyFunc copy;	//MoveOnlyCallable里为nullptr
+		void (*destroy)(void* storage);
+	};
+
+	template<typename F>
+	static constexpr bool fitsInline(){
+		return sizeof(F)<=kInlineSize&&alignof(F)<=alignof(Storage)&&std::is_nothrow_move_constructible<F>::value;
+	}
+
+	//空的函数指针、std::function转换过来以后仍然是空的
+	template<typename F>
+	static bool isEmpty(const F&){return false;}
+	template<typename T>
+	static bool isEmpty(T* p){return p==nullptr;}
+	template<typename S>
+	static bool isEmpty(const std::function<S>& f){return !f;}
+
+	//目标对象直接存放在storage_里
+	template<typename F>
+	struct InlineOps{
+		static F* get(void* storage){return static_cast<F*>(storage);}
+		static R invoke(void* storage,Args&&... args){
+			return (*get(storage))(std::forward<Args>(args)...);
+		}
+		static void move(void* from,void* to){
+			new(to) F(std::move(*get(from)));
+			get(from)->~F();
+		}
+		static void copy(const void* from,void* to){
+			new(to) F(*static_cast<const F*>(from));
+		}
+		static void destroy(void* storage){get(storage)->~F();}
+	};
+
+	//目标对象在堆上，storage_里只存指针
+	template<typename F>
+	struct HeapOps{
+		static F*& get(void* storage){return *static_cast<F**>(storage);}
+		static R invoke(void* storage,Args&&... args){
+			return (*get(storage))(std::forward<Args>(args)...);
+		}
+		static void move(void* from,void* to){
+			new(to) F*(get(from));
+		}
+		static void copy(const void* from,void* to){
+			new(to) F*(new F(**static_cast<F* const*>(from)));
+		}
+		static void destroy(void* storage){delete get(storage);}
+	};
+
+	template<typename Impl,typename F>
+	static const Ops* opsFor(){
+		static const Ops ops={&Impl::invoke,&Impl::move,copyFn<Impl>(std::integral_constant<bool,Copyable>()),&Impl::destroy};
+		return &ops;
+	}
+	template<typename Impl>
+	static CopyFunc copyFn(std::true_type){return &Impl::copy;}
+	template<typename Impl>
+	static CopyFunc copyFn(std::false_type){return nullptr;}
+
+	template<typename F,typename Arg>
+	void construct(std::true_type,Arg&& f){
+		new(&storage_) F(std::forward<Arg>(f));
+		ops_=opsFor<InlineOps<F>,F>();
+	}
+	template<typename F,typename Arg>
+	void construct(std::false_type,Arg&& f){
+		new(&storage_) F*(new F(std::forward<Arg>(f)));
+		ops_=opsFor<HeapOps<F>,F>();
+	}
+
+	void reset(){
+		if(ops_){
+			ops_->destroy(&storage_);
+			ops_=nullptr;
+		}
+	}
+
+	Storage storage_;
+	const Ops* ops_;
+};
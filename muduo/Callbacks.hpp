@@ -2,14 +2,24 @@
 #include <memory>
 #include <functional>
 
+#include "Callable.hpp"
+
 class Buffer;
 class TcpConnection;
 class Timestamp;
 
 using TcpConnectionPtr=std::shared_ptr<TcpConnection>;
-using ConnectionCallback=std::function<void(const TcpConnectionPtr&)>;
-using CloseCallback=std::function<void(const TcpConnectionPtr&)>;
-using WriteCompleteCallback=std::function<void(const TcpConnectionPtr&)>;
+using TimerCallback=Callable<void()>;
+using ConnectionCallback=Callable<void(const TcpConnectionPtr&)>;
+using CloseCallback=Callable<void(const TcpConnectionPtr&)>;
+using WriteCompleteCallback=Callable<void(const TcpConnectionPtr&)>;
+
+using MessageCallback=Callable<void(const TcpConnectionPtr&,Buffer*,Timestamp)>;
+//conn借用自loop，只在回调期间有效，不增减引用计数
+using BorrowedMessageCallback=Callable<void(TcpConnection&,Buffer*,Timestamp)>;
+using HighWaterMarkCallback=Callable<void(const TcpConnectionPtr&,size_t)>;
+using LowWaterMarkCallback=Callable<void(const TcpConnectionPtr&,size_t)>;
 
-using MessageCallback=std::function<void(const TcpConnectionPtr&,Buffer*,Timestamp)>;
-using HighWaterMarkCallback=std::function<void(const TcpConnectionPtr&,size_t)>;
\ No newline at end of file
+//TcpServer/TcpClient没有设置回调时使用：前者什么都不做，后者丢弃收到的数据
+void defaultConnectionCallback(const TcpConnectionPtr& conn);
+void defaultMessageCallback(const TcpConnectionPtr& conn,Buffer* buffer,Timestamp receiveTime);
\ No newline at end of file
@@ -11,13 +11,14 @@
 #include "Timestamp.hpp"
 #include "EventLoop.hpp"
 #include "Logger.hpp"
+#include "Callable.hpp"
 
 class EventLoop;
 
 class Channel:noncopyable{
 public:
-    using EventCallback= std::function<void()> ;
-    using ReadEventCallback=std::function<void(Timestamp)>;
+    using EventCallback=Callable<void()> ;
+    using ReadEventCallback=Callable<void(Timestamp)>;
     Channel(EventLoop* loop,int fd);
     ~Channel();
 
@@ -0,0 +1,86 @@
+#pragma once
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "noncopyable.hpp"
+
+/*
+保存在TcpConnection对象内部的用户状态，取代按name()做key的全局map
+不超过kInlineSize字节的类型直接构造在内部的存储里，不需要堆分配；更大的类型退化为new
+取出时按类型检查，不依赖RTTI
+*/
+class ConnectionContext:noncopyable{
+public:
+	static const size_t kInlineSize=64;
+
+	ConnectionContext():ptr_(nullptr),type_(nullptr),destroy_(nullptr){}
+	~ConnectionContext(){reset();}
+
+	//销毁原来的状态，用args构造一个T，返回它的引用
+	template<typename T,typename... Args>
+	T& emplace(Args&&... args){
+		reset();
+		T* p=construct<T>(std::integral_constant<bool,fitsInline<T>()>(),std::forward<Args>(args)...);
+		ptr_=p;
+		type_=typeTag<T>();
+		return *p;
+	}
+
+	//类型不匹配或者为空时返回nullptr
+	template<typename T>
+	T* get(){return type_==typeTag<T>()?static_cast<T*>(ptr_):nullptr;}
+	template<typename T>
+	const T* get()const{return type_==typeTag<T>()?static_cast<const T*>(ptr_):nullptr;}
+
+	bool empty()const{return ptr_==nullptr;}
+
+	void reset(){
+		if(ptr_){
+			destroy_(ptr_);
+			ptr_=nullptr;
+			type_=nullptr;
+			destroy_=nullptr;
+		}
+	}
+
+private:
+	template<typename T>
+	static constexpr bool fitsInline(){
+		return sizeof(T)<=kInlineSize&&alignof(T)<=alignof(Storage);
+	}
+
+	template<typename T,typename... Args>
+	T* construct(std::true_type,Args&&... args){
+		T* p=new(&storage_) T(std::forward<Args>(args)...);
+		destroy_=&destroyInline<T>;
+		return p;
+	}
+	template<typename T,typename... Args>
+	T* construct(std::false_type,Args&&... args){
+		T* p=new T(std::forward<Args>(args)...);
+		destroy_=&destroyHeap<T>;
+		return p;
+	}
+
+	//每个类型对应一个静态变量，用它的地址作为类型标识
+	template<typename T>
+	struct TypeTag{static const char id;};
+	template<typename T>
+	static const void* typeTag(){return &TypeTag<typename std::decay<T>::type>::id;}
+
+	template<typename T>
+	static void destroyInline(void* p){static_cast<T*>(p)->~T();}
+	template<typename T>
+	static void destroyHeap(void* p){delete static_cast<T*>(p);}
+
+	using Storage=std::aligned_storage<kInlineSize,alignof(max_align_t)>::type;
+	Storage storage_;
+	void* ptr_;
+	const void* type_;
+	void (*destroy_)(void*);
+};
+
+template<typename T>
+const char ConnectionContext::TypeTag<T>::id=0;
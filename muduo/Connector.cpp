@@ -0,0 +1,227 @@
+#include "Connector.hpp"
+#include "Logger.hpp"
+#include "Channel.hpp"
+#include "EventLoop.hpp"
+#include "CurrentThread.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+static int createNonBlocking(sa_family_t family){
+	int sockfd=::socket(family,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+	if(sockfd<0){
+		LOG_FATAL("%s:%s:%d  connect socket create err:%d \n",__FILE__, __FUNCTION__, __LINE__,errno);
+	}
+	return sockfd;
+}
+
+static int getSocketError(int sockfd){
+	int optval;
+	socklen_t optlen=sizeof(optval);
+	if(::getsockopt(sockfd,SOL_SOCKET,SO_ERROR,&optval,&optlen)<0){
+		return errno;
+	}
+	return optval;
+}
+
+//端口随机分配到和目标相同时，本机连接会连到自己
+static bool isSelfConnect(int sockfd){
+	struct sockaddr_in local,peer;
+	socklen_t len=sizeof(local);
+	::memset(&local,0,sizeof(local));
+	::memset(&peer,0,sizeof(peer));
+	if(::getsockname(sockfd,(struct sockaddr*)&local,&len)<0){
+		return false;
+	}
+	len=sizeof(peer);
+	if(::getpeername(sockfd,(struct sockaddr*)&peer,&len)<0){
+		return false;
+	}
+	return local.sin_port==peer.sin_port&&local.sin_addr.s_addr==peer.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop* loop,const InetAddress& serverAddr)
+	:loop_(loop)
+	,serverAddr_(serverAddr)
+	,connect_(false)
+	,state_(kDisconnected)
+	,initRetryDelayMs_(kInitRetryDelayMs)
+	,maxRetryDelayMs_(kMaxRetryDelayMs)
+	,retryDelayMs_(kInitRetryDelayMs)
+{
+}
+
+Connector::~Connector(){
+	if(channel_){
+		LOG_ERROR("Connector::dtor channel is still alive\n");
+	}
+}
+
+void Connector::setRetryDelay(int initMs,int maxMs){
+	initRetryDelayMs_=initMs;
+	maxRetryDelayMs_=std::max(initMs,maxMs);
+	retryDelayMs_=initMs;
+}
+
+void Connector::start(){
+	connect_=true;
+	loop_->runInLoop(std::bind(&Connector::startInLoop,shared_from_this()));
+}
+
+void Connector::startInLoop(){
+	if(state_!=kDisconnected){
+		return;
+	}
+	if(connect_){
+		connect();
+	}
+	else{
+		LOG_DEBUG("Connector::startInLoop do not connect\n");
+	}
+}
+
+void Connector::stop(){
+	connect_=false;
+	loop_->queueInLoop(std::bind(&Connector::stopInLoop,shared_from_this()));
+}
+
+void Connector::stopInLoop(){
+	loop_->cancel(retryTimer_);
+	if(state_==kConnecting){
+		setState(kDisconnected);
+		int sockfd=removeAndResetChannel();
+		::close(sockfd);	//不再重试
+	}
+}
+
+void Connector::restart(){
+	setState(kDisconnected);
+	retryDelayMs_=initRetryDelayMs_;
+	connect_=true;
+	startInLoop();
+}
+
+void Connector::connect(){
+	int sockfd=createNonBlocking(serverAddr_.family());
+	int ret=::connect(sockfd,serverAddr_.sockAddr(),serverAddr_.sockAddrLen());
+	int savedErrno=(ret==0)?0:errno;
+	switch(savedErrno){
+		case 0:
+		case EINPROGRESS:	//连接正在建立，等socket可写
+		case EINTR:
+		case EISCONN:
+			connecting(sockfd);
+			break;
+
+		case EAGAIN:	//本地端口用完等暂时性错误，稍后重试
+		case EADDRINUSE:
+		case EADDRNOTAVAIL:
+		case ECONNREFUSED:
+		case ENETUNREACH:
+		case ENOENT:	//AF_UNIX的socket文件还没有创建
+			retry(sockfd,savedErrno);
+			break;
+
+		default:
+			LOG_ERROR("Connector::connect error %d \n",savedErrno);
+			::close(sockfd);
+			if(connectErrorCallback_){
+				connectErrorCallback_(savedErrno);
+			}
+			break;
+	}
+}
+
+void Connector::connecting(int sockfd){
+	setState(kConnecting);
+	channel_.reset(new Channel(loop_,sockfd));
+	channel_->setWriteCallback(std::bind(&Connector::handleWrite,this));
+	channel_->setERRORCallback(std::bind(&Connector::handleError,this));
+	channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel(){
+	channel_->disableAll();
+	channel_->remove();
+	int sockfd=channel_->fd();
+	//当前可能正在Channel::handleEvent里，不能直接销毁channel_
+	loop_->queueInLoop(std::bind(&Connector::resetChannel,shared_from_this()));
+	return sockfd;
+}
+
+void Connector::resetChannel(){
+	channel_.reset();
+}
+
+void Connector::handleWrite(){
+	if(state_!=kConnecting){
+		return;
+	}
+	int sockfd=removeAndResetChannel();
+	int err=getSocketError(sockfd);
+	if(err){
+		LOG_ERROR("Connector::handleWrite SO_ERROR=%d \n",err);
+		retry(sockfd,err);
+	}
+	else if(!serverAddr_.isUnix()&&isSelfConnect(sockfd)){
+		LOG_ERROR("Connector::handleWrite self connect\n");
+		retry(sockfd,ECONNREFUSED);	//自连接说明对端没有在监听
+	}
+	else{
+		setState(kConnected);
+		retryDelayMs_=initRetryDelayMs_;
+		if(connect_&&newConnectionCallback_){
+			newConnectionCallback_(sockfd);
+		}
+		else{
+			::close(sockfd);
+		}
+	}
+}
+
+void Connector::handleError(){
+	if(state_==kConnecting){
+		int sockfd=removeAndResetChannel();
+		int err=getSocketError(sockfd);
+		LOG_ERROR("Connector::handleError SO_ERROR=%d \n",err);
+		retry(sockfd,err);
+	}
+}
+
+//在[delay/2,delay]里均匀取值，同一时刻断开的大量连接不会在同一时刻重连
+int Connector::nextRetryDelay(){
+	static thread_local std::minstd_rand engine(static_cast<unsigned>(CurrentThread::tid())
+		^static_cast<unsigned>(Timestamp::now().microSecondsSinceEpoch()));
+	int half=retryDelayMs_/2;
+	std::uniform_int_distribution<int> dist(0,retryDelayMs_-half);
+	return half+dist(engine);
+}
+
+void Connector::retry(int sockfd,int err){
+	::close(sockfd);
+	setState(kDisconnected);
+	if(connectErrorCallback_){
+		connectErrorCallback_(err);
+	}
+	if(connect_){
+		int delayMs=nextRetryDelay();
+		LOG_INFO("Connector::retry connecting to %s in %d milliseconds\n",serverAddr_.toIpPort().c_str(),delayMs);
+		std::weak_ptr<Connector> weakConnector(shared_from_this());
+		retryTimer_=loop_->runAfter(delayMs/1000.0,[weakConnector](){
+			ConnectorPtr connector=weakConnector.lock();
+			if(connector){
+				connector->startInLoop();
+			}
+		});
+		retryDelayMs_=std::min(retryDelayMs_*2,maxRetryDelayMs_);
+	}
+	else{
+		LOG_DEBUG("Connector::retry do not connect\n");
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <atomic>
+
+#include "noncopyable.hpp"
+#include "InetAddress.hpp"
+#include "TimerId.hpp"
+
+class Channel;
+class EventLoop;
+
+/*
+TcpClient使用的主动连接器，和Acceptor相对
+非阻塞connect，EINPROGRESS时把socket交给Channel等待可写，可写以后检查SO_ERROR判断连接结果
+失败时按指数退避加随机抖动重试，避免大量连接同时重连
+*/
+class Connector:noncopyable,public std::enable_shared_from_this<Connector>{
+public:
+	using NewConnectionCallback=std::function<void(int sockfd)>;
+	//一次连接尝试失败(例如ECONNREFUSED)，err是失败的errno，之后按退避重试
+	using ConnectErrorCallback=std::function<void(int err)>;
+
+	static const int kInitRetryDelayMs=500;
+	static const int kMaxRetryDelayMs=30*1000;
+
+	Connector(EventLoop* loop,const InetAddress& serverAddr);
+	~Connector();
+
+	void setNewConnectionCallback(const NewConnectionCallback& cb){newConnectionCallback_=cb;}
+	void setConnectErrorCallback(const ConnectErrorCallback& cb){connectErrorCallback_=cb;}
+	//重试间隔从initMs开始每次翻倍，不超过maxMs，需要在start之前调用
+	void setRetryDelay(int initMs,int maxMs);
+
+	void start();	//可以在任意线程调用
+	void restart();	//只能在loop线程调用
+	void stop();	//可以在任意线程调用
+
+	const InetAddress& serverAddress()const{return serverAddr_;}
+
+private:
+	enum States{kDisconnected,kConnecting,kConnected};
+	void setState(States s){state_=s;}
+	void startInLoop();
+	void stopInLoop();
+	void connect();
+	void connecting(int sockfd);
+	void handleWrite();
+	void handleError();
+	void retry(int sockfd,int err);
+	int removeAndResetChannel();
+	void resetChannel();
+	int nextRetryDelay();	//带抖动的本次等待时间
+
+	EventLoop* loop_;
+	InetAddress serverAddr_;
+	std::atomic_bool connect_;
+	States state_;
+	std::unique_ptr<Channel> channel_;
+	NewConnectionCallback newConnectionCallback_;
+	ConnectErrorCallback connectErrorCallback_;
+	int initRetryDelayMs_;
+	int maxRetryDelayMs_;
+	int retryDelayMs_;
+	TimerId retryTimer_;
+};
+
+using ConnectorPtr=std::shared_ptr<Connector>;
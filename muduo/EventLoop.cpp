@@ -2,6 +2,8 @@
 #include "Logger.hpp"
 #include "Channel.hpp"
 #include "Poller.hpp"
+#include "TimerQueue.hpp"
+#include "MemoryPool.hpp"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -25,7 +27,9 @@ EventLoop::EventLoop()
 	:looping_(false)
 	,quit_(false)
 	,threadId_(CurrentThread::tid())
+	,memoryPool_(std::make_shared<MemoryPool>())
 	,poller_(Poller::newDefaultPoller(this))
+	,timerQueue_(new TimerQueue(this))
 	,wakeupFd_(createEventfd())
 	,wakeupChannel_(new Channel(this,wakeupFd_))
 	,callingPendingFunctors_(false)
@@ -50,6 +54,10 @@ EventLoop::~EventLoop(){
 	t_loopInThisThread=nullptr;
 }
 
+EventLoop* EventLoop::loopOfCurrentThread(){
+	return t_loopInThisThread;
+}
+
 void EventLoop::handleRead(){
 	uint64_t one=1;
 	ssize_t n=read(wakeupFd_,&one,sizeof(one));
@@ -71,6 +79,7 @@ void EventLoop::loop(){
 		}
 		//执行当前EventLoop事件循环需要处理的回调操作
 		doPendingFunctors();
+		doIterationEndFunctors();
 	}
 	LOG_INFO("EventLoop %p stop looping \n",this);
 	looping_=false;
@@ -89,7 +98,7 @@ void EventLoop::runInLoop(Functor cb){
 		cb();
 	}
 	else{	//非在当前Loop线程执行cb
-		queueInLoop(cb);
+		queueInLoop(std::move(cb));
 	}
 }
 
@@ -97,7 +106,7 @@ void EventLoop::runInLoop(Functor cb){
 void EventLoop::queueInLoop(Functor cb){
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		pendingFunctors_.emplace_back(cb);
+		pendingFunctors_.emplace_back(std::move(cb));
 	}
 	//唤醒相应的，需要执行上面回调操作的loop的线程
 	if(!isInLoopThread()||callingPendingFunctors_){
@@ -105,6 +114,31 @@ void EventLoop::queueInLoop(Functor cb){
 	}
 }
 
+void EventLoop::runAtIterationEnd(Functor cb){
+	if(!isInLoopThread()){
+		LOG_FATAL("EventLoop::runAtIterationEnd %p called in thread %d \n",this,CurrentThread::tid());
+	}
+	iterationEndFunctors_.emplace_back(std::move(cb));
+}
+
+TimerId EventLoop::runAt(Timestamp time,TimerCallback cb){
+	return timerQueue_->addTimer(std::move(cb),time,0.0);
+}
+
+TimerId EventLoop::runAfter(double delay,TimerCallback cb){
+	Timestamp time(addTime(Timestamp::now(),delay));
+	return runAt(time,std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval,TimerCallback cb){
+	Timestamp time(addTime(Timestamp::now(),interval));
+	return timerQueue_->addTimer(std::move(cb),time,interval);
+}
+
+void EventLoop::cancel(TimerId timerId){
+	timerQueue_->cancel(timerId);
+}
+
 //唤醒loop所在的线程 向wakefd写一个数据
 void EventLoop::wakeup(){
 	uint64_t one=1;
@@ -129,14 +163,27 @@ bool EventLoop::hasChannel(Channel* channel){
 
 //执行回调
 void EventLoop::doPendingFunctors(){
-	std::vector<Functor> functors;
 	callingPendingFunctors_=true;
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		functors.swap(pendingFunctors_);
+		runningFunctors_.swap(pendingFunctors_);
 	}
-	for(const Functor &functor:functors){
+	for(const Functor &functor:runningFunctors_){
 		functor();  //执行当前loop需要执行的回调操作
 	}
+	runningFunctors_.clear();	//保留容量
+	callingPendingFunctors_=false;
+}
+
+void EventLoop::doIterationEndFunctors(){
+	//这里queueInLoop的回调要等到下一轮才执行，需要像doPendingFunctors一样唤醒poll
+	callingPendingFunctors_=true;
+	while(!iterationEndFunctors_.empty()){
+		runningIterationEndFunctors_.swap(iterationEndFunctors_);
+		for(const Functor &functor:runningIterationEndFunctors_){
+			functor();
+		}
+		runningIterationEndFunctors_.clear();
+	}
 	callingPendingFunctors_=false;
-}
\ No newline at end of file
+}
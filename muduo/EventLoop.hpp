@@ -8,13 +8,17 @@
 #include "Timestamp.hpp"
 #include "noncopyable.hpp"
 #include "CurrentThread.hpp"
+#include "Callbacks.hpp"
+#include "TimerId.hpp"
 
 class Channel;
 class Poller;
+class TimerQueue;
+class MemoryPool;
 
 class EventLoop:noncopyable{
 public:
-	using Functor=std::function<void()>;
+	using Functor=MoveOnlyCallable<void()>;	//内部存放bind(成员函数,shared_ptr)这样的回调，不需要堆分配；队列里的回调只移动，可以捕获只能移动的对象
 
 	EventLoop();
 	~EventLoop();
@@ -26,19 +30,33 @@ public:
 
 	void runInLoop(Functor cb);  //在当前Loop执行cb
 	void queueInLoop(Functor cb);	//把cb放入队列，唤醒loop所在的线程执行cb
+	//本轮所有channel事件和pendingFunctors处理完、poll休眠之前执行cb，只能在loop线程调用
+	void runAtIterationEnd(Functor cb);
 
 	void wakeup();	//唤醒loop所在的线程
 
+	//定时器，线程安全
+	TimerId runAt(Timestamp time,TimerCallback cb);	//在time时刻执行cb
+	TimerId runAfter(double delay,TimerCallback cb);	//delay秒以后执行cb
+	TimerId runEvery(double interval,TimerCallback cb);	//每隔interval秒执行cb
+	void cancel(TimerId timerId);
+
 	//实际就是调用poller的方法
 	void updateChannel(Channel* channel);
 	void removeChannel(Channel* channel);
 	bool hasChannel(Channel* channel);
 
+	//本loop的内存池，用于回收连接相关的对象
+	const std::shared_ptr<MemoryPool>& memoryPool()const{return memoryPool_;}
+
 	//判断loop是否在自己创建时的线程
 	bool isInLoopThread()const {return threadId_==CurrentThread::tid();}
+	//当前线程的loop，线程里没有loop时返回nullptr
+	static EventLoop* loopOfCurrentThread();
 private:
 	void handleRead();  //wakeup
 	void doPendingFunctors();	//执行回调
+	void doIterationEndFunctors();
 
 	using ChannelList=std::vector<Channel*>;
 	std::atomic_bool looping_;
@@ -47,7 +65,9 @@ private:
 	const pid_t threadId_;	//记录当前线程所在的线程id
 
 	Timestamp pollReturnTime_;  //poller返回发生事件的channels的时间点
+	std::shared_ptr<MemoryPool> memoryPool_;	//要在poller_之前构造
 	std::unique_ptr<Poller> poller_;
+	std::unique_ptr<TimerQueue> timerQueue_;
 
 	int wakeupFd_;  //主要作用：当mainloop获取一个新用户的channel，通过轮询选择subloop通过改成员唤醒subloop处理
 	std::unique_ptr<Channel> wakeupChannel_;
@@ -57,4 +77,8 @@ private:
 	std::atomic_bool callingPendingFunctors_;  //标识当前loop是否有需要执行的回调
 	std::vector<Functor> pendingFunctors_;  //存储loop需要执行的所有回调
 	std::mutex mutex_;	//互斥锁，迎来保护上面的vector的线程安全
+	std::vector<Functor> runningFunctors_;	//和pendingFunctors_交换后执行，两个vector的容量反复使用，不再每轮分配
+
+	std::vector<Functor> iterationEndFunctors_;	//只在loop线程访问，不需要加锁
+	std::vector<Functor> runningIterationEndFunctors_;
 };
\ No newline at end of file
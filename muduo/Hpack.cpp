@@ -0,0 +1,442 @@
+#include "Hpack.hpp"
+#include "Buffer.hpp"
+
+namespace{
+struct StaticEntry{
+	const char* name;
+	const char* value;
+};
+
+const StaticEntry kStaticTable[HpackTable::kStaticEntries]={
+	{":authority",""},{":method","GET"},{":method","POST"},{":path","/"},{":path","/index.html"},
+	{":scheme","http"},{":scheme","https"},{":status","200"},{":status","204"},{":status","206"},
+	{":status","304"},{":status","400"},{":status","404"},{":status","500"},{"accept-charset",""},
+	{"accept-encoding","gzip, deflate"},{"accept-language",""},{"accept-ranges",""},{"accept",""},{"access-control-allow-origin",""},
+	{"age",""},{"allow",""},{"authorization",""},{"cache-control",""},{"content-disposition",""},
+	{"content-encoding",""},{"content-language",""},{"content-length",""},{"content-location",""},{"content-range",""},
+	{"content-type",""},{"cookie",""},{"date",""},{"etag",""},{"expect",""},
+	{"expires",""},{"from",""},{"host",""},{"if-match",""},{"if-modified-since",""},
+	{"if-none-match",""},{"if-range",""},{"if-unmodified-since",""},{"last-modified",""},{"link",""},
+	{"location",""},{"max-forwards",""},{"proxy-authenticate",""},{"proxy-authorization",""},{"range",""},
+	{"referer",""},{"refresh",""},{"retry-after",""},{"server",""},{"set-cookie",""},
+	{"strict-transport-security",""},{"transfer-encoding",""},{"user-agent",""},{"vary",""},{"via",""},
+	{"www-authenticate",""},
+};
+
+struct HuffmanCode{
+	uint32_t code;
+	uint8_t bits;
+};
+
+//下标是符号，256是EOS
+const HuffmanCode kHuffmanCodes[257]={
+	{0x1ff8,13},{0x7fffd8,23},{0xfffffe2,28},{0xfffffe3,28},{0xfffffe4,28},{0xfffffe5,28},{0xfffffe6,28},{0xfffffe7,28},
+	{0xfffffe8,28},{0xffffea,24},{0x3ffffffc,30},{0xfffffe9,28},{0xfffffea,28},{0x3ffffffd,30},{0xfffffeb,28},{0xfffffec,28},
+	{0xfffffed,28},{0xfffffee,28},{0xfffffef,28},{0xffffff0,28},{0xffffff1,28},{0xffffff2,28},{0x3ffffffe,30},{0xffffff3,28},
+	{0xffffff4,28},{0xffffff5,28},{0xffffff6,28},{0xffffff7,28},{0xffffff8,28},{0xffffff9,28},{0xffffffa,28},{0xffffffb,28},
+	{0x14,6},{0x3f8,10},{0x3f9,10},{0xffa,12},{0x1ff9,13},{0x15,6},{0xf8,8},{0x7fa,11},
+	{0x3fa,10},{0x3fb,10},{0xf9,8},{0x7fb,11},{0xfa,8},{0x16,6},{0x17,6},{0x18,6},
+	{0x0,5},{0x1,5},{0x2,5},{0x19,6},{0x1a,6},{0x1b,6},{0x1c,6},{0x1d,6},
+	{0x1e,6},{0x1f,6},{0x5c,7},{0xfb,8},{0x7ffc,15},{0x20,6},{0xffb,12},{0x3fc,10},
+	{0x1ffa,13},{0x21,6},{0x5d,7},{0x5e,7},{0x5f,7},{0x60,7},{0x61,7},{0x62,7},
+	{0x63,7},{0x64,7},{0x65,7},{0x66,7},{0x67,7},{0x68,7},{0x69,7},{0x6a,7},
+	{0x6b,7},{0x6c,7},{0x6d,7},{0x6e,7},{0x6f,7},{0x70,7},{0x71,7},{0x72,7},
+	{0xfc,8},{0x73,7},{0xfd,8},{0x1ffb,13},{0x7fff0,19},{0x1ffc,13},{0x3ffc,14},{0x22,6},
+	{0x7ffd,15},{0x3,5},{0x23,6},{0x4,5},{0x24,6},{0x5,5},{0x25,6},{0x26,6},
+	{0x27,6},{0x6,5},{0x74,7},{0x75,7},{0x28,6},{0x29,6},{0x2a,6},{0x7,5},
+	{0x2b,6},{0x76,7},{0x2c,6},{0x8,5},{0x9,5},{0x2d,6},{0x77,7},{0x78,7},
+	{0x79,7},{0x7a,7},{0x7b,7},{0x7ffe,15},{0x7fc,11},{0x3ffd,14},{0x1ffd,13},{0xffffffc,28},
+	{0xfffe6,20},{0x3fffd2,22},{0xfffe7,20},{0xfffe8,20},{0x3fffd3,22},{0x3fffd4,22},{0x3fffd5,22},{0x7fffd9,23},
+	{0x3fffd6,22},{0x7fffda,23},{0x7fffdb,23},{0x7fffdc,23},{0x7fffdd,23},{0x7fffde,23},{0xffffeb,24},{0x7fffdf,23},
+	{0xffffec,24},{0xffffed,24},{0x3fffd7,22},{0x7fffe0,23},{0xffffee,24},{0x7fffe1,23},{0x7fffe2,23},{0x7fffe3,23},
+	{0x7fffe4,23},{0x1fffdc,21},{0x3fffd8,22},{0x7fffe5,23},{0x3fffd9,22},{0x7fffe6,23},{0x7fffe7,23},{0xffffef,24},
+	{0x3fffda,22},{0x1fffdd,21},{0xfffe9,20},{0x3fffdb,22},{0x3fffdc,22},{0x7fffe8,23},{0x7fffe9,23},{0x1fffde,21},
+	{0x7fffea,23},{0x3fffdd,22},{0x3fffde,22},{0xfffff0,24},{0x1fffdf,21},{0x3fffdf,22},{0x7fffeb,23},{0x7fffec,23},
+	{0x1fffe0,21},{0x1fffe1,21},{0x3fffe0,22},{0x1fffe2,21},{0x7fffed,23},{0x3fffe1,22},{0x7fffee,23},{0x7fffef,23},
+	{0xfffea,20},{0x3fffe2,22},{0x3fffe3,22},{0x3fffe4,22},{0x7ffff0,23},{0x3fffe5,22},{0x3fffe6,22},{0x7ffff1,23},
+	{0x3ffffe0,26},{0x3ffffe1,26},{0xfffeb,20},{0x7fff1,19},{0x3fffe7,22},{0x7ffff2,23},{0x3fffe8,22},{0x1ffffec,25},
+	{0x3ffffe2,26},{0x3ffffe3,26},{0x3ffffe4,26},{0x7ffffde,27},{0x7ffffdf,27},{0x3ffffe5,26},{0xfffff1,24},{0x1ffffed,25},
+	{0x7fff2,19},{0x1fffe3,21},{0x3ffffe6,26},{0x7ffffe0,27},{0x7ffffe1,27},{0x3ffffe7,26},{0x7ffffe2,27},{0xfffff2,24},
+	{0x1fffe4,21},{0x1fffe5,21},{0x3ffffe8,26},{0x3ffffe9,26},{0xffffffd,28},{0x7ffffe3,27},{0x7ffffe4,27},{0x7ffffe5,27},
+	{0xfffec,20},{0xfffff3,24},{0xfffed,20},{0x1fffe6,21},{0x3fffe9,22},{0x1fffe7,21},{0x1fffe8,21},{0x7ffff3,23},
+	{0x3fffea,22},{0x3fffeb,22},{0x1ffffee,25},{0x1ffffef,25},{0xfffff4,24},{0xfffff5,24},{0x3ffffea,26},{0x7ffff4,23},
+	{0x3ffffeb,26},{0x7ffffe6,27},{0x3ffffec,26},{0x3ffffed,26},{0x7ffffe7,27},{0x7ffffe8,27},{0x7ffffe9,27},{0x7ffffea,27},
+	{0x7ffffeb,27},{0xffffffe,28},{0x7ffffec,27},{0x7ffffed,27},{0x7ffffee,27},{0x7ffffef,27},{0x7fffff0,27},{0x3ffffee,26},
+	{0x3fffffff,30},
+};
+
+//规范Huffman码按(长度,符号)排序后码值连续递增，解码时比较左对齐的32位窗口就能确定长度
+struct HuffmanDecodeTable{
+	HuffmanDecodeTable(){
+		int count[31]={0};
+		for(int sym=0;sym<257;++sym){
+			++count[kHuffmanCodes[sym].bits];
+		}
+		uint32_t code=0;
+		int offset=0;
+		for(int len=1;len<=30;++len){
+			first[len]=code;
+			start[len]=offset;
+			limit[len]=static_cast<uint64_t>(code+count[len])<<(32-len);
+			offset+=count[len];
+			code=(code+count[len])<<1;
+		}
+		int next[31];
+		for(int len=1;len<=30;++len){
+			next[len]=start[len];
+		}
+		for(int sym=0;sym<257;++sym){
+			symbols[next[kHuffmanCodes[sym].bits]++]=static_cast<uint16_t>(sym);
+		}
+	}
+
+	uint32_t first[31];
+	int start[31];
+	uint64_t limit[31];
+	uint16_t symbols[257];
+};
+
+const HuffmanDecodeTable& huffmanDecodeTable(){
+	static const HuffmanDecodeTable table;
+	return table;
+}
+
+const uint64_t kMaxInteger=(1u<<28);
+
+//N位前缀整数，firstByte是前缀之外的标志位
+void encodeInteger(Buffer* out,uint8_t firstByte,int prefixBits,uint64_t value){
+	const uint64_t mask=(1u<<prefixBits)-1;
+	if(value<mask){
+		out->appendInt8(static_cast<int8_t>(firstByte|value));
+		return;
+	}
+	out->appendInt8(static_cast<int8_t>(firstByte|mask));
+	value-=mask;
+	while(value>=128){
+		out->appendInt8(static_cast<int8_t>((value&0x7f)|0x80));
+		value>>=7;
+	}
+	out->appendInt8(static_cast<int8_t>(value));
+}
+
+bool decodeInteger(const uint8_t** p,const uint8_t* end,int prefixBits,uint64_t* value){
+	const uint64_t mask=(1u<<prefixBits)-1;
+	uint64_t v=**p&mask;
+	++*p;
+	if(v<mask){
+		*value=v;
+		return true;
+	}
+	for(int shift=0;*p<end&&shift<=28;shift+=7){
+		const uint8_t b=**p;
+		++*p;
+		v+=static_cast<uint64_t>(b&0x7f)<<shift;
+		if((b&0x80)==0){
+			*value=v;
+			return v<=kMaxInteger;
+		}
+	}
+	return false;
+}
+
+void encodeString(Buffer* out,StringPiece s){
+	const size_t huffmanLen=Huffman::encodedLength(s);
+	if(huffmanLen<s.size()){
+		encodeInteger(out,0x80,7,huffmanLen);
+		Huffman::encode(s,out);
+	}
+	else{
+		encodeInteger(out,0x00,7,s.size());
+		out->append(s.data(),s.size());
+	}
+}
+
+bool decodeString(const uint8_t** p,const uint8_t* end,std::string* out){
+	if(*p>=end){
+		return false;
+	}
+	const bool huffman=(**p&0x80)!=0;
+	uint64_t len=0;
+	if(!decodeInteger(p,end,7,&len)||len>static_cast<uint64_t>(end-*p)){
+		return false;
+	}
+	const char* data=reinterpret_cast<const char*>(*p);
+	*p+=len;
+	out->clear();
+	if(huffman){
+		return Huffman::decode(data,len,out);
+	}
+	out->assign(data,len);
+	return true;
+}
+
+//每个响应都不一样的值进动态表只会挤掉有用的条目
+bool worthIndexing(StringPiece name){
+	return !name.equals("content-length")&&!name.equals("content-range")&&!name.equals("etag")&&!name.equals("last-modified");
+}
+}
+
+bool HpackTable::get(size_t index,StringPiece* name,StringPiece* value)const{
+	if(index==0){
+		return false;
+	}
+	if(index<=kStaticEntries){
+		*name=kStaticTable[index-1].name;
+		*value=kStaticTable[index-1].value;
+		return true;
+	}
+	index-=kStaticEntries+1;
+	if(index>=entries_.size()){
+		return false;
+	}
+	*name=entries_[index].first;
+	*value=entries_[index].second;
+	return true;
+}
+
+size_t HpackTable::find(StringPiece name,StringPiece value,bool* nameOnly)const{
+	size_t nameIndex=0;
+	for(size_t i=0;i<kStaticEntries;++i){
+		if(name.equals(kStaticTable[i].name)){
+			if(value.equals(kStaticTable[i].value)){
+				*nameOnly=false;
+				return i+1;
+			}
+			if(nameIndex==0){
+				nameIndex=i+1;
+			}
+		}
+	}
+	for(size_t i=0;i<entries_.size();++i){
+		if(name.equals(entries_[i].first)){
+			if(value.equals(entries_[i].second)){
+				*nameOnly=false;
+				return kStaticEntries+1+i;
+			}
+			if(nameIndex==0){
+				nameIndex=kStaticEntries+1+i;
+			}
+		}
+	}
+	*nameOnly=true;
+	return nameIndex;
+}
+
+void HpackTable::add(StringPiece name,StringPiece value){
+	const size_t entrySize=name.size()+value.size()+kEntryOverhead;
+	if(entrySize>maxSize_){
+		evict(0);
+		return;
+	}
+	evict(maxSize_-entrySize);
+	entries_.emplace_front(name.asString(),value.asString());
+	size_+=entrySize;
+}
+
+void HpackTable::setMaxSize(size_t maxSize){
+	maxSize_=maxSize;
+	evict(maxSize);
+}
+
+void HpackTable::evict(size_t limit){
+	while(size_>limit&&!entries_.empty()){
+		size_-=entries_.back().first.size()+entries_.back().second.size()+kEntryOverhead;
+		entries_.pop_back();
+	}
+}
+
+size_t Huffman::encodedLength(StringPiece s){
+	size_t bits=0;
+	for(size_t i=0;i<s.size();++i){
+		bits+=kHuffmanCodes[static_cast<uint8_t>(s[i])].bits;
+	}
+	return (bits+7)/8;
+}
+
+void Huffman::encode(StringPiece s,Buffer* out){
+	const size_t len=encodedLength(s);
+	out->ensureWritableBytes(len);
+	char* dst=out->beginWrite();
+	uint64_t acc=0;
+	int bits=0;
+	for(size_t i=0;i<s.size();++i){
+		const HuffmanCode& code=kHuffmanCodes[static_cast<uint8_t>(s[i])];
+		acc=(acc<<code.bits)|code.code;
+		bits+=code.bits;
+		while(bits>=8){
+			bits-=8;
+			*dst++=static_cast<char>(acc>>bits);
+		}
+	}
+	if(bits>0){	//用EOS的前缀(全1)补齐最后一个字节
+		*dst++=static_cast<char>((acc<<(8-bits))|(0xff>>bits));
+	}
+	out->hasWritten(len);
+}
+
+bool Huffman::decode(const char* data,size_t len,std::string* out){
+	const HuffmanDecodeTable& table=huffmanDecodeTable();
+	const uint8_t* p=reinterpret_cast<const uint8_t*>(data);
+	const uint8_t* end=p+len;
+	uint64_t acc=0;	//左对齐，高位是下一个要解码的位
+	int bits=0;
+	while(true){
+		while(bits<=56&&p<end){
+			acc|=static_cast<uint64_t>(*p++)<<(56-bits);
+			bits+=8;
+		}
+		if(bits==0){
+			return true;
+		}
+		uint32_t window=static_cast<uint32_t>(acc>>32);
+		if(bits<32){
+			window|=0xffffffffu>>bits;
+		}
+		int codeLen=5;
+		while(window>=table.limit[codeLen]){
+			++codeLen;
+		}
+		if(codeLen>bits){	//剩下的只能是不超过7位的全1填充
+			return bits<=7&&(window>>(32-bits))==(1u<<bits)-1;
+		}
+		const uint16_t sym=table.symbols[table.start[codeLen]+((window>>(32-codeLen))-table.first[codeLen])];
+		if(sym==256){
+			return false;
+		}
+		out->push_back(static_cast<char>(sym));
+		acc<<=codeLen;
+		bits-=codeLen;
+	}
+}
+
+HpackDecoder::HpackDecoder(size_t maxTableSize,size_t maxHeaderListSize)
+	:table_(maxTableSize)
+	,settingsMaxSize_(maxTableSize)
+	,maxHeaderListSize_(maxHeaderListSize)
+{
+}
+
+HpackDecoder::Result HpackDecoder::decode(const char* data,size_t len,HpackHeaderList* headers){
+	const uint8_t* p=reinterpret_cast<const uint8_t*>(data);
+	const uint8_t* end=p+len;
+	size_t listSize=0;
+	bool tooLarge=false;
+	bool headerSeen=false;
+	std::string name;
+	std::string value;
+	while(p<end){
+		const uint8_t b=*p;
+		if((b&0xe0)==0x20){	//动态表大小更新，只能出现在头部块开头
+			uint64_t size=0;
+			if(headerSeen||!decodeInteger(&p,end,5,&size)||size>settingsMaxSize_){
+				return kCompressionError;
+			}
+			table_.setMaxSize(size);
+			continue;
+		}
+		headerSeen=true;
+		StringPiece namePiece;
+		StringPiece valuePiece;
+		if(b&0x80){	//索引
+			uint64_t index=0;
+			if(!decodeInteger(&p,end,7,&index)||!table_.get(index,&namePiece,&valuePiece)){
+				return kCompressionError;
+			}
+			name.assign(namePiece.data(),namePiece.size());
+			value.assign(valuePiece.data(),valuePiece.size());
+		}
+		else{	//字面值：01带索引、0000不索引、0001永不索引
+			const bool indexing=(b&0xc0)==0x40;
+			uint64_t index=0;
+			if(!decodeInteger(&p,end,indexing?6:4,&index)){
+				return kCompressionError;
+			}
+			if(index==0){
+				if(!decodeString(&p,end,&name)){
+					return kCompressionError;
+				}
+			}
+			else if(table_.get(index,&namePiece,&valuePiece)){
+				name.assign(namePiece.data(),namePiece.size());
+			}
+			else{
+				return kCompressionError;
+			}
+			if(!decodeString(&p,end,&value)){
+				return kCompressionError;
+			}
+			if(indexing){
+				table_.add(name,value);
+			}
+		}
+		listSize+=name.size()+value.size()+HpackTable::kEntryOverhead;
+		if(listSize>maxHeaderListSize_){
+			tooLarge=true;
+		}
+		if(!tooLarge){
+			headers->emplace_back(name,value);
+		}
+	}
+	return tooLarge?kHeaderListTooLarge:kOk;
+}
+
+HpackEncoder::HpackEncoder(size_t maxTableSize)
+	:table_(maxTableSize)
+	,pendingMaxSize_(maxTableSize)
+	,minPendingMaxSize_(maxTableSize)
+	,sizeUpdatePending_(false)
+{
+}
+
+void HpackEncoder::setMaxTableSize(size_t maxSize){
+	//对端允许得再大也只用默认大小，限制每条连接的内存
+	const size_t size=maxSize<HpackTable::kDefaultMaxSize?maxSize:HpackTable::kDefaultMaxSize;
+	if(!sizeUpdatePending_){
+		if(size==table_.maxSize()){
+			return;
+		}
+		minPendingMaxSize_=size;
+	}
+	else if(size<minPendingMaxSize_){
+		minPendingMaxSize_=size;
+	}
+	pendingMaxSize_=size;
+	sizeUpdatePending_=true;
+}
+
+void HpackEncoder::beginBlock(Buffer* out){
+	if(!sizeUpdatePending_){
+		return;
+	}
+	if(minPendingMaxSize_<pendingMaxSize_){
+		//对端先按较小的值淘汰表项，本地表也要先淘汰一遍，两边的动态表才一致
+		encodeInteger(out,0x20,5,minPendingMaxSize_);
+		table_.setMaxSize(minPendingMaxSize_);
+	}
+	encodeInteger(out,0x20,5,pendingMaxSize_);
+	table_.setMaxSize(pendingMaxSize_);
+	sizeUpdatePending_=false;
+}
+
+void HpackEncoder::encode(StringPiece name,StringPiece value,Buffer* out,bool sensitive){
+	bool nameOnly=false;
+	const size_t index=table_.find(name,value,&nameOnly);
+	if(index!=0&&!nameOnly&&!sensitive){
+		encodeInteger(out,0x80,7,index);
+		return;
+	}
+	const bool indexing=!sensitive&&worthIndexing(name);
+	if(indexing){
+		encodeInteger(out,0x40,6,index);
+	}
+	else{
+		encodeInteger(out,sensitive?0x10:0x00,4,index);
+	}
+	if(index==0){
+		encodeString(out,name);
+	}
+	encodeString(out,value);
+	if(indexing){
+		table_.add(name,value);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+#include "StringPiece.hpp"
+
+class Buffer;
+
+/*
+HPACK(RFC 7541)头部压缩：静态表、动态表和Huffman编码
+HTTP/2的头部名字都是小写，编解码都不做大小写转换
+*/
+using HpackHeaderList=std::vector<std::pair<std::string,std::string>>;
+
+//静态表和动态表合起来的索引空间：1..61是静态表，62开始是动态表，最新加入的条目索引最小
+class HpackTable{
+public:
+	static const size_t kStaticEntries=61;
+	static const size_t kEntryOverhead=32;	//每个条目除了名字和值以外计入的大小
+	static const size_t kDefaultMaxSize=4096;
+
+	explicit HpackTable(size_t maxSize=kDefaultMaxSize):maxSize_(maxSize),size_(0){}
+
+	bool get(size_t index,StringPiece* name,StringPiece* value)const;
+	//返回名字和值都相同的索引，没有时返回只有名字相同的索引(nameOnly为true)，都没有返回0
+	size_t find(StringPiece name,StringPiece value,bool* nameOnly)const;
+	//条目比整个表还大时清空动态表，不加入
+	void add(StringPiece name,StringPiece value);
+	void setMaxSize(size_t maxSize);
+	size_t maxSize()const{return maxSize_;}
+	size_t size()const{return size_;}
+
+private:
+	void evict(size_t limit);
+
+	std::deque<std::pair<std::string,std::string>> entries_;	//最新的在前
+	size_t maxSize_;
+	size_t size_;
+};
+
+//Huffman编解码，码表是RFC 7541附录B的规范Huffman码
+struct Huffman{
+	static size_t encodedLength(StringPiece s);
+	static void encode(StringPiece s,Buffer* out);
+	//填充不是全1、超过7位或者出现EOS时返回false
+	static bool decode(const char* data,size_t len,std::string* out);
+};
+
+class HpackDecoder:noncopyable{
+public:
+	enum Result{kOk,kCompressionError,kHeaderListTooLarge};
+
+	//maxTableSize是我们在SETTINGS_HEADER_TABLE_SIZE里允许对端使用的动态表大小
+	explicit HpackDecoder(size_t maxTableSize=HpackTable::kDefaultMaxSize,size_t maxHeaderListSize=64*1024);
+
+	//解码一个完整的头部块。头部列表超限时仍然解码完整个块以保持动态表同步，返回kHeaderListTooLarge
+	Result decode(const char* data,size_t len,HpackHeaderList* headers);
+
+private:
+	HpackTable table_;
+	size_t settingsMaxSize_;
+	size_t maxHeaderListSize_;
+};
+
+class HpackEncoder:noncopyable{
+public:
+	explicit HpackEncoder(size_t maxTableSize=HpackTable::kDefaultMaxSize);
+
+	//对端SETTINGS_HEADER_TABLE_SIZE变化时调用，下一个头部块开头会带上动态表大小更新
+	void setMaxTableSize(size_t maxSize);
+	//每个头部块开始时调用一次
+	void beginBlock(Buffer* out);
+	//sensitive的头部(例如set-cookie)以Never Indexed方式发送，不进动态表
+	void encode(StringPiece name,StringPiece value,Buffer* out,bool sensitive=false);
+
+private:
+	HpackTable table_;
+	size_t pendingMaxSize_;
+	size_t minPendingMaxSize_;	//两次头部块之间先缩小再放大时，两个值都要告诉对端
+	bool sizeUpdatePending_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Buffer.hpp"
+
+/*
+HTTP/2帧(RFC 9113)的常量和帧头读写
+帧头9字节：24位长度、8位类型、8位标志、1位保留+31位流id，都是网络字节序
+*/
+struct Http2Frame{
+	enum Type{
+		kData=0x0,kHeaders=0x1,kPriority=0x2,kRstStream=0x3,kSettings=0x4,
+		kPushPromise=0x5,kPing=0x6,kGoAway=0x7,kWindowUpdate=0x8,kContinuation=0x9,
+	};
+	//kEndStream和kAck的值相同，分别用在DATA/HEADERS和SETTINGS/PING上
+	enum Flag{kEndStream=0x1,kAck=0x1,kEndHeaders=0x4,kPadded=0x8,kPriorityFlag=0x20};
+	enum ErrorCode{
+		kNoError=0x0,kProtocolError=0x1,kInternalError=0x2,kFlowControlError=0x3,
+		kSettingsTimeout=0x4,kStreamClosed=0x5,kFrameSizeError=0x6,kRefusedStream=0x7,
+		kCancel=0x8,kCompressionError=0x9,kConnectError=0xa,kEnhanceYourCalm=0xb,
+	};
+	enum Setting{
+		kHeaderTableSize=0x1,kEnablePush=0x2,kMaxConcurrentStreams=0x3,
+		kInitialWindowSize=0x4,kMaxFrameSize=0x5,kMaxHeaderListSize=0x6,
+	};
+
+	static const size_t kHeaderSize=9;
+	static const uint32_t kDefaultMaxFrameSize=16384;
+	static const uint32_t kMaxAllowedFrameSize=(1u<<24)-1;
+	static const int32_t kDefaultWindowSize=65535;
+	static const int64_t kMaxWindowSize=0x7fffffff;
+	//h2c prior knowledge时客户端的连接序言，后面紧跟SETTINGS帧
+	static const char* clientPreface(){return "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";}
+	static const size_t kClientPrefaceLength=24;
+
+	uint32_t length;
+	uint8_t type;
+	uint8_t flags;
+	uint32_t streamId;
+
+	//buf里够一个帧头时解析出来，不取走数据
+	static bool peek(const Buffer* buf,Http2Frame* frame){
+		if(buf->readableBytes()<kHeaderSize){
+			return false;
+		}
+		const uint8_t* p=reinterpret_cast<const uint8_t*>(buf->peek());
+		frame->length=(static_cast<uint32_t>(p[0])<<16)|(static_cast<uint32_t>(p[1])<<8)|p[2];
+		frame->type=p[3];
+		frame->flags=p[4];
+		frame->streamId=readUint32(p+5)&0x7fffffff;
+		return true;
+	}
+
+	static void appendHeader(Buffer* buf,uint32_t length,uint8_t type,uint8_t flags,uint32_t streamId){
+		char header[kHeaderSize];
+		header[0]=static_cast<char>(length>>16);
+		header[1]=static_cast<char>(length>>8);
+		header[2]=static_cast<char>(length);
+		header[3]=static_cast<char>(type);
+		header[4]=static_cast<char>(flags);
+		header[5]=static_cast<char>(streamId>>24);
+		header[6]=static_cast<char>(streamId>>16);
+		header[7]=static_cast<char>(streamId>>8);
+		header[8]=static_cast<char>(streamId);
+		buf->append(header,kHeaderSize);
+	}
+
+	static uint32_t readUint32(const uint8_t* p){
+		return (static_cast<uint32_t>(p[0])<<24)|(static_cast<uint32_t>(p[1])<<16)|(static_cast<uint32_t>(p[2])<<8)|p[3];
+	}
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <stdint.h>
+
+#include "Hpack.hpp"
+#include "StringPiece.hpp"
+
+//HTTP/2的一个请求：伪头部单独保存，其余头部按收到的顺序放在headers()里，名字都是小写
+class Http2Request{
+public:
+	Http2Request():streamId_(0){}
+
+	uint32_t streamId()const{return streamId_;}
+	const std::string& method()const{return method_;}
+	const std::string& path()const{return path_;}	//含查询串
+	const std::string& scheme()const{return scheme_;}
+	const std::string& authority()const{return authority_;}
+	const HpackHeaderList& headers()const{return headers_;}
+	const std::string& body()const{return body_;}
+
+	//name必须是小写，找不到返回空的StringPiece；同名头部只返回第一个
+	StringPiece header(StringPiece name)const{
+		for(const std::pair<std::string,std::string>& field:headers_){
+			if(name.equals(field.first)){
+				return field.second;
+			}
+		}
+		return StringPiece();
+	}
+
+private:
+	friend class Http2Session;
+
+	uint32_t streamId_;
+	std::string method_;
+	std::string path_;
+	std::string scheme_;
+	std::string authority_;
+	HpackHeaderList headers_;
+	std::string body_;
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include <ctype.h>
+
+#include "noncopyable.hpp"
+#include "HttpResponse.hpp"
+
+/*
+HTTP/2的响应：HttpCallback返回以后由Http2Session编码成HEADERS帧，body交给写调度器按流量控制窗口和优先级切成DATA帧
+和HttpResponse不同，头部先收集起来，因为要经过HPACK编码，并且可能分成多个帧
+*/
+class Http2Response:noncopyable{
+public:
+	Http2Response():statusCode_(200){}
+
+	void setStatus(int code){statusCode_=code;}
+	//名字转成小写；connection、transfer-encoding等HTTP/1.1的逐跳头部在HTTP/2里是非法的，会被丢弃
+	void addHeader(StringPiece name,StringPiece value,bool sensitive=false){
+		std::string lower(name.data(),name.size());
+		for(char& c:lower){
+			c=static_cast<char>(::tolower(static_cast<unsigned char>(c)));
+		}
+		headers_.push_back(Header{std::move(lower),value.asString(),sensitive});
+	}
+	void setContentType(StringPiece type){addHeader("content-type",type);}
+	void setBody(StringPiece body){body_.assign(body.data(),body.size());}
+	void setBody(const char* body){body_.assign(body);}
+	void setBody(std::string&& body){body_=std::move(body);}
+	//和HttpResponse::setStreamBody一样按需拉取，不写content-length，END_STREAM随最后一个DATA帧发出
+	//producer暂时没有数据时只挂起这个流，其它流照常发送
+	void setStreamBody(HttpBodyProducer producer){producer_=std::move(producer);}
+	//唤醒挂起的流，见HttpStreamResumer
+	HttpStreamResumer streamResumer()const{return resumer_;}
+
+	int statusCode()const{return statusCode_;}
+
+private:
+	friend class Http2Session;
+
+	struct Header{
+		std::string name;
+		std::string value;
+		bool sensitive;
+	};
+
+	int statusCode_;
+	std::vector<Header> headers_;
+	std::string body_;
+	HttpBodyProducer producer_;
+	HttpStreamResumer resumer_;	//由Http2Session设置
+};
@@ -0,0 +1,44 @@
+#include "Http2Server.hpp"
+
+namespace{
+void defaultHttpCallback(const Http2Request&,Http2Response* resp){
+	resp->setStatus(404);
+	resp->setBody("Not Found");
+}
+}
+
+Http2Server::Http2Server(EventLoop* loop,const InetAddress& listenAddr,const std::string& name,TcpServer::Option option)
+	:server_(loop,listenAddr,name,option)
+	,httpCallback_(defaultHttpCallback)
+	,lowWaterMark_(16*1024)
+{
+	server_.setConnectionCallback([this](const TcpConnectionPtr& conn){ onConnection(conn); });
+	server_.setBorrowedMessageCallback([this](TcpConnection& conn,Buffer* buf,Timestamp){
+		onMessage(conn,buf);
+	});
+}
+
+void Http2Server::onConnection(const TcpConnectionPtr& conn){
+	if(conn->connected()){
+		//帧都很小，不能等Nagle
+		conn->setTcpNoDelay(true);
+		Http2Session& session=conn->setContext<Http2Session>(conn.get(),&httpCallback_,config_);
+		conn->setHighWaterMarkCallback(HighWaterMarkCallback(),config_.highWaterMark);
+		conn->setLowWaterMarkCallback([](const TcpConnectionPtr& c,size_t){
+			Http2Session* s=c->getContext<Http2Session>();
+			if(s){
+				s->onWritable();
+			}
+		},lowWaterMark_);
+		session.start();
+	}
+}
+
+void Http2Server::onMessage(TcpConnection& conn,Buffer* buf){
+	Http2Session* session=conn.getContext<Http2Session>();
+	if(session==nullptr||!conn.connected()){
+		buf->retrieveAll();
+		return;
+	}
+	session->onMessage(buf);
+}
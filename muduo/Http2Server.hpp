@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+
+#include "noncopyable.hpp"
+#include "TcpServer.hpp"
+#include "Http2Session.hpp"
+
+/*
+TcpServer之上的HTTP/2服务器，明文h2c，客户端必须以prior knowledge方式直接发送连接序言(curl --http2-prior-knowledge)
+- 每条连接一个Http2Session放在连接的context里，一条连接上的多个请求并发处理，响应按优先级交错发送
+- Http2Callback同步填写Http2Response；setStreamBody的响应按需拉取，受流量控制窗口和连接的高低水位限制
+*/
+class Http2Server:noncopyable{
+public:
+	Http2Server(EventLoop* loop,const InetAddress& listenAddr,const std::string& name,TcpServer::Option option=TcpServer::kNoReusePort);
+
+	void setHttpCallback(const Http2Callback& cb){httpCallback_=cb;}
+	void setThreadNum(int num){server_.setThreadNum(num);}
+	//以下设置对之后建立的连接生效
+	void setMaxConcurrentStreams(uint32_t streams){config_.maxConcurrentStreams=streams;}
+	//我们的接收窗口，大窗口让上传不必频繁等WINDOW_UPDATE，但每条流最多缓存这么多未处理的body
+	void setInitialWindowSize(int32_t bytes){config_.initialWindowSize=bytes;}
+	void setMaxHeaderListSize(size_t bytes){config_.maxHeaderListSize=bytes;}
+	void setMaxBodyBytes(size_t bytes){config_.maxBodyBytes=bytes;}
+	//写调度器让待发送数据最多达到high，降到low以下再继续
+	void setWaterMarks(size_t low,size_t high){lowWaterMark_=low;config_.highWaterMark=high;}
+	TcpServer& tcpServer(){return server_;}
+
+	void start(){server_.start();}
+
+private:
+	void onConnection(const TcpConnectionPtr& conn);
+	void onMessage(TcpConnection& conn,Buffer* buf);
+
+	TcpServer server_;
+	Http2Callback httpCallback_;
+	Http2Session::Config config_;
+	size_t lowWaterMark_;
+};
@@ -0,0 +1,805 @@
+#include "Http2Session.hpp"
+#include "TcpConnection.hpp"
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace{
+const uint16_t kDefaultWeight=16;
+const uint8_t kDefaultUrgency=3;
+const uint64_t kStride=1<<16;
+
+//去掉PADDED帧的填充，填充长度超过帧长度时返回false
+bool stripPadding(const Http2Frame& frame,const char** payload,uint32_t* length){
+	if((frame.flags&Http2Frame::kPadded)==0){
+		return true;
+	}
+	if(*length<1){
+		return false;
+	}
+	const uint32_t padding=static_cast<uint8_t>(**payload);
+	if(padding>=*length){
+		return false;
+	}
+	++*payload;
+	*length-=1+padding;
+	return true;
+}
+
+//HTTP/2里禁止的逐跳头部
+bool connectionSpecific(StringPiece name){
+	return name.equals("connection")||name.equals("keep-alive")||name.equals("proxy-connection")
+		||name.equals("transfer-encoding")||name.equals("upgrade");
+}
+
+//RFC 9218的priority头部，例如"u=1, i"，只取紧急度
+uint8_t parseUrgency(const std::string& value){
+	const size_t pos=value.find("u=");
+	if(pos!=std::string::npos&&pos+2<value.size()&&value[pos+2]>='0'&&value[pos+2]<='7'){
+		return static_cast<uint8_t>(value[pos+2]-'0');
+	}
+	return kDefaultUrgency;
+}
+}
+
+struct Http2Session::Stream{
+	Stream(uint32_t idArg,int64_t sendWindowArg,int64_t recvWindowArg)
+		:id(idArg),remoteClosed(false),responding(false),parked(false),sendWindow(sendWindowArg),recvWindow(recvWindowArg)
+		,bodyOffset(0),pending(0),urgency(kDefaultUrgency),weight(kDefaultWeight),pass(0){}
+
+	//还没有发出的body字节：setBody的数据，或者producer产生的数据，两者只会有一个
+	size_t available()const{return pending.readableBytes()>0?pending.readableBytes():body.size()-bodyOffset;}
+	const char* data()const{return pending.readableBytes()>0?pending.peek():body.data()+bodyOffset;}
+	void consume(size_t n){
+		if(pending.readableBytes()>0){
+			pending.retrieve(n);
+		}
+		else{
+			bodyOffset+=n;
+		}
+	}
+
+	uint32_t id;
+	Http2Request request;
+	bool remoteClosed;	//收到了END_STREAM
+	bool responding;	//HEADERS已经发出，body还在发送
+	bool parked;	//producer暂时没有数据，不在sending_里，等resume
+	int64_t sendWindow;
+	int64_t recvWindow;
+	std::string body;
+	size_t bodyOffset;
+	Buffer pending;
+	HttpBodyProducer producer;
+	uint8_t urgency;
+	uint16_t weight;	//1..256
+	uint64_t pass;	//stride调度的虚拟完成时间，越小越先发
+};
+
+Http2Session::Http2Session(TcpConnection* conn,const Http2Callback* callback,const Config& config)
+	:conn_(conn)
+	,callback_(callback)
+	,config_(config)
+	,decoder_(HpackTable::kDefaultMaxSize,config.maxHeaderListSize)
+	,encoder_(HpackTable::kDefaultMaxSize)
+	,virtualTime_(0)
+	,blockStream_(0)
+	,blockEndStream_(false)
+	,blockNewStream_(false)
+	,blockSelfDependent_(false)
+	,blockWeight_(kDefaultWeight)
+	,lastStreamId_(0)
+	,connSendWindow_(Http2Frame::kDefaultWindowSize)
+	,connRecvWindow_(Http2Frame::kDefaultWindowSize)
+	,peerInitialWindow_(Http2Frame::kDefaultWindowSize)
+	,peerMaxFrameSize_(Http2Frame::kDefaultMaxFrameSize)
+	,uncommitted_(0)
+	,prefaceReceived_(false)
+	,settingsReceived_(false)
+	,goingAway_(false)
+	,peerGoAway_(false)
+{
+}
+
+Http2Session::~Http2Session()=default;
+
+void Http2Session::start(){
+	struct{
+		uint16_t id;
+		uint32_t value;
+	}const settings[]={
+		{Http2Frame::kEnablePush,0},
+		{Http2Frame::kMaxConcurrentStreams,config_.maxConcurrentStreams},
+		{Http2Frame::kInitialWindowSize,static_cast<uint32_t>(config_.initialWindowSize)},
+		{Http2Frame::kMaxHeaderListSize,static_cast<uint32_t>(config_.maxHeaderListSize)},
+	};
+	const size_t count=sizeof(settings)/sizeof(settings[0]);
+	Buffer* out=output(Http2Frame::kHeaderSize+6*count);
+	Http2Frame::appendHeader(out,6*count,Http2Frame::kSettings,0,0);
+	for(size_t i=0;i<count;++i){
+		out->appendInt16(static_cast<int16_t>(settings[i].id));
+		out->appendInt32(static_cast<int32_t>(settings[i].value));
+	}
+	//连接级窗口不受SETTINGS影响，初始是65535，需要单独放大
+	if(config_.initialWindowSize>Http2Frame::kDefaultWindowSize){
+		writeWindowUpdate(0,config_.initialWindowSize-Http2Frame::kDefaultWindowSize);
+		connRecvWindow_=config_.initialWindowSize;
+	}
+	commit();
+}
+
+void Http2Session::onMessage(Buffer* buf){
+	if(goingAway_){
+		buf->retrieveAll();
+		return;
+	}
+	if(!prefaceReceived_){
+		const size_t n=buf->readableBytes()<Http2Frame::kClientPrefaceLength?buf->readableBytes():Http2Frame::kClientPrefaceLength;
+		if(::memcmp(buf->peek(),Http2Frame::clientPreface(),n)!=0){
+			connectionError(Http2Frame::kProtocolError,"bad connection preface");
+			buf->retrieveAll();
+			return;
+		}
+		if(n<Http2Frame::kClientPrefaceLength){
+			return;
+		}
+		buf->retrieve(n);
+		prefaceReceived_=true;
+	}
+	Http2Frame frame;
+	while(!goingAway_&&Http2Frame::peek(buf,&frame)){
+		//我们没有修改SETTINGS_MAX_FRAME_SIZE，对端的帧不能超过默认值
+		if(frame.length>Http2Frame::kDefaultMaxFrameSize){
+			connectionError(Http2Frame::kFrameSizeError,"frame too large");
+			break;
+		}
+		if(buf->readableBytes()<Http2Frame::kHeaderSize+frame.length){
+			break;
+		}
+		handleFrame(frame,buf->peek()+Http2Frame::kHeaderSize);
+		buf->retrieve(Http2Frame::kHeaderSize+frame.length);
+	}
+	if(goingAway_){
+		buf->retrieveAll();
+		return;
+	}
+	flush();
+}
+
+void Http2Session::onWritable(){
+	if(!goingAway_){
+		flush();
+	}
+}
+
+void Http2Session::handleFrame(const Http2Frame& frame,const char* payload){
+	if(blockStream_!=0&&(frame.type!=Http2Frame::kContinuation||frame.streamId!=blockStream_)){
+		connectionError(Http2Frame::kProtocolError,"expected CONTINUATION");
+		return;
+	}
+	if(!settingsReceived_&&frame.type!=Http2Frame::kSettings){	//序言之后的第一个帧必须是SETTINGS
+		connectionError(Http2Frame::kProtocolError,"SETTINGS expected");
+		return;
+	}
+	switch(frame.type){
+	case Http2Frame::kData: handleData(frame,payload); break;
+	case Http2Frame::kHeaders: handleHeaders(frame,payload); break;
+	case Http2Frame::kPriority: handlePriority(frame,payload); break;
+	case Http2Frame::kRstStream: handleRstStream(frame,payload); break;
+	case Http2Frame::kSettings: handleSettings(frame,payload); break;
+	case Http2Frame::kPushPromise: connectionError(Http2Frame::kProtocolError,"PUSH_PROMISE from client"); break;
+	case Http2Frame::kPing: handlePing(frame,payload); break;
+	case Http2Frame::kGoAway: handleGoAway(frame); break;
+	case Http2Frame::kWindowUpdate: handleWindowUpdate(frame,payload); break;
+	case Http2Frame::kContinuation: handleContinuation(frame,payload); break;
+	default: break;	//未知类型的帧直接忽略
+	}
+}
+
+void Http2Session::handleData(const Http2Frame& frame,const char* payload){
+	if(frame.streamId==0){
+		connectionError(Http2Frame::kProtocolError,"DATA on stream 0");
+		return;
+	}
+	//流量控制按整个帧(含填充)计算，不管流是否还存在
+	connRecvWindow_-=frame.length;
+	if(connRecvWindow_<0){
+		connectionError(Http2Frame::kFlowControlError,"connection window exceeded");
+		return;
+	}
+	if(connRecvWindow_<config_.initialWindowSize/2){
+		writeWindowUpdate(0,static_cast<uint32_t>(config_.initialWindowSize-connRecvWindow_));
+		connRecvWindow_=config_.initialWindowSize;
+	}
+	const char* data=payload;
+	uint32_t length=frame.length;
+	if(!stripPadding(frame,&data,&length)){
+		connectionError(Http2Frame::kProtocolError,"bad padding");
+		return;
+	}
+	Stream* stream=findStream(frame.streamId);
+	if(stream==nullptr){
+		//已经关闭的流：可能是我们RST_STREAM以后还在路上的数据，忽略
+		if(frame.streamId>lastStreamId_){
+			connectionError(Http2Frame::kProtocolError,"DATA on idle stream");
+		}
+		return;
+	}
+	if(stream->remoteClosed){
+		resetStream(stream,Http2Frame::kStreamClosed);
+		return;
+	}
+	stream->recvWindow-=frame.length;
+	if(stream->recvWindow<0){
+		resetStream(stream,Http2Frame::kFlowControlError);
+		return;
+	}
+	const bool endStream=(frame.flags&Http2Frame::kEndStream)!=0;
+	if(stream->responding){	//已经提前回复了错误，丢弃剩下的body
+		stream->remoteClosed=endStream;
+		return;
+	}
+	if(stream->request.body_.size()+length>config_.maxBodyBytes){
+		respondError(stream,413);
+		return;
+	}
+	stream->request.body_.append(data,length);
+	if(endStream){
+		stream->remoteClosed=true;
+		dispatch(stream);
+	}
+	else if(stream->recvWindow<config_.initialWindowSize/2){
+		writeWindowUpdate(stream->id,static_cast<uint32_t>(config_.initialWindowSize-stream->recvWindow));
+		stream->recvWindow=config_.initialWindowSize;
+	}
+}
+
+void Http2Session::handleHeaders(const Http2Frame& frame,const char* payload){
+	if(frame.streamId==0||frame.streamId%2==0){
+		connectionError(Http2Frame::kProtocolError,"bad stream id for HEADERS");
+		return;
+	}
+	const char* data=payload;
+	uint32_t length=frame.length;
+	if(!stripPadding(frame,&data,&length)){
+		connectionError(Http2Frame::kProtocolError,"bad padding");
+		return;
+	}
+	blockWeight_=kDefaultWeight;
+	blockSelfDependent_=false;
+	if(frame.flags&Http2Frame::kPriorityFlag){
+		if(length<5){
+			connectionError(Http2Frame::kFrameSizeError,"HEADERS priority too short");
+			return;
+		}
+		const uint32_t dependency=Http2Frame::readUint32(reinterpret_cast<const uint8_t*>(data))&0x7fffffff;
+		blockSelfDependent_=dependency==frame.streamId;
+		blockWeight_=static_cast<uint16_t>(static_cast<uint8_t>(data[4])+1);
+		data+=5;
+		length-=5;
+	}
+	blockNewStream_=false;
+	if(findStream(frame.streamId)==nullptr){
+		if(frame.streamId<=lastStreamId_){
+			connectionError(Http2Frame::kStreamClosed,"HEADERS on closed stream");
+			return;
+		}
+		lastStreamId_=frame.streamId;
+		blockNewStream_=true;
+	}
+	blockStream_=frame.streamId;
+	blockEndStream_=(frame.flags&Http2Frame::kEndStream)!=0;
+	headerBlock_.append(data,length);
+	if(frame.flags&Http2Frame::kEndHeaders){
+		finishHeaderBlock();
+	}
+}
+
+void Http2Session::handleContinuation(const Http2Frame& frame,const char* payload){
+	if(blockStream_==0){
+		connectionError(Http2Frame::kProtocolError,"unexpected CONTINUATION");
+		return;
+	}
+	//压缩后的头部块已经比解压后的上限还大，不必再等
+	if(headerBlock_.readableBytes()+frame.length>config_.maxHeaderListSize){
+		connectionError(Http2Frame::kEnhanceYourCalm,"header block too large");
+		return;
+	}
+	headerBlock_.append(payload,frame.length);
+	if(frame.flags&Http2Frame::kEndHeaders){
+		finishHeaderBlock();
+	}
+}
+
+void Http2Session::finishHeaderBlock(){
+	const uint32_t id=blockStream_;
+	blockStream_=0;
+	HpackHeaderList headers;
+	//被拒绝的流也要解码，动态表必须和对端保持一致
+	HpackDecoder::Result result=decoder_.decode(headerBlock_.peek(),headerBlock_.readableBytes(),&headers);
+	headerBlock_.retrieveAll();
+	if(result==HpackDecoder::kCompressionError){
+		connectionError(Http2Frame::kCompressionError,"HPACK decoding failed");
+		return;
+	}
+	Stream* stream=findStream(id);
+	if(blockNewStream_){
+		if(peerGoAway_||streams_.size()>=config_.maxConcurrentStreams){
+			writeRstStream(id,Http2Frame::kRefusedStream);
+			return;
+		}
+		std::unique_ptr<Stream> created(new Stream(id,peerInitialWindow_,config_.initialWindowSize));
+		stream=created.get();
+		streams_[id]=std::move(created);
+		stream->weight=blockWeight_;
+		stream->request.streamId_=id;
+		stream->remoteClosed=blockEndStream_;
+		if(blockSelfDependent_){
+			resetStream(stream,Http2Frame::kProtocolError);
+		}
+		else if(result==HpackDecoder::kHeaderListTooLarge){
+			respondError(stream,431);
+		}
+		else if(!setRequestHeaders(stream,headers)){
+			resetStream(stream,Http2Frame::kProtocolError);
+		}
+		else if(stream->remoteClosed){
+			dispatch(stream);
+		}
+		return;
+	}
+	if(stream==nullptr){	//解码期间流已经被重置
+		return;
+	}
+	if(stream->remoteClosed){
+		resetStream(stream,Http2Frame::kStreamClosed);
+		return;
+	}
+	//请求的trailer，必须带END_STREAM；内容不交给回调
+	if(!blockEndStream_){
+		resetStream(stream,Http2Frame::kProtocolError);
+		return;
+	}
+	stream->remoteClosed=true;
+	if(!stream->responding){
+		dispatch(stream);
+	}
+}
+
+bool Http2Session::setRequestHeaders(Stream* stream,HpackHeaderList& headers){
+	Http2Request& request=stream->request;
+	bool regularSeen=false;
+	for(std::pair<std::string,std::string>& field:headers){
+		const std::string& name=field.first;
+		if(name.empty()){
+			return false;
+		}
+		for(char c:name){
+			if(c>='A'&&c<='Z'){
+				return false;
+			}
+		}
+		if(name[0]==':'){
+			if(regularSeen){	//伪头部必须在普通头部之前
+				return false;
+			}
+			std::string* target=nullptr;
+			if(name==":method"){
+				target=&request.method_;
+			}
+			else if(name==":path"){
+				target=&request.path_;
+			}
+			else if(name==":scheme"){
+				target=&request.scheme_;
+			}
+			else if(name==":authority"){
+				target=&request.authority_;
+			}
+			if(target==nullptr||!target->empty()){
+				return false;
+			}
+			*target=std::move(field.second);
+			continue;
+		}
+		regularSeen=true;
+		if(connectionSpecific(name)||(name=="te"&&field.second!="trailers")){
+			return false;
+		}
+		if(name=="priority"){
+			stream->urgency=parseUrgency(field.second);
+		}
+		request.headers_.push_back(std::move(field));
+	}
+	if(request.method_.empty()){
+		return false;
+	}
+	return request.method_=="CONNECT"||(!request.path_.empty()&&!request.scheme_.empty());
+}
+
+void Http2Session::dispatch(Stream* stream){
+	Http2Response resp;
+	resp.resumer_=HttpStreamResumer(conn_->shared_from_this(),&Http2Session::resumeStream,stream->id);
+	(*callback_)(stream->request,&resp);
+	sendResponse(stream,resp);
+}
+
+void Http2Session::sendResponse(Stream* stream,Http2Response& resp){
+	const int status=resp.statusCode_;
+	const bool noBody=status==204||status==304||(status>=100&&status<200);
+	encodeBuffer_.retrieveAll();
+	encoder_.beginBlock(&encodeBuffer_);
+	char digits[24];
+	::snprintf(digits,sizeof digits,"%d",status);
+	encoder_.encode(":status",digits,&encodeBuffer_);
+	for(const Http2Response::Header& header:resp.headers_){
+		if(header.name.empty()||header.name[0]==':'||connectionSpecific(header.name)||header.name=="content-length"){
+			continue;
+		}
+		encoder_.encode(header.name,header.value,&encodeBuffer_,header.sensitive);
+	}
+	if(!noBody&&!resp.producer_){
+		::snprintf(digits,sizeof digits,"%zu",resp.body_.size());
+		encoder_.encode("content-length",digits,&encodeBuffer_);
+	}
+	const bool hasBody=!noBody&&stream->request.method_!="HEAD"&&(resp.producer_||!resp.body_.empty());
+	writeHeaders(stream->id,!hasBody);
+	//请求已经处理完，body可能很大，提前释放
+	std::string().swap(stream->request.body_);
+	if(!hasBody){
+		finishResponse(stream);
+		return;
+	}
+	stream->responding=true;
+	stream->body.swap(resp.body_);
+	stream->producer=std::move(resp.producer_);
+	stream->pass=virtualTime_;
+	sending_.push_back(stream);
+}
+
+//请求还没收完就回复错误，回复发完以后用RST_STREAM(NO_ERROR)让客户端停止发送body
+void Http2Session::respondError(Stream* stream,int status){
+	Http2Response resp;
+	resp.setStatus(status);
+	resp.setContentType("text/plain");
+	resp.setBody(HttpResponse::reasonPhrase(status));
+	sendResponse(stream,resp);
+}
+
+void Http2Session::flush(){
+	while(conn_->connected()&&!sending_.empty()){
+		if(conn_->outputBytes()+uncommitted_>=config_.highWaterMark){
+			break;	//等低水位回调
+		}
+		Stream* stream=pickStream();
+		if(stream==nullptr){
+			break;	//都在等WINDOW_UPDATE
+		}
+		if(stream->producer&&stream->pending.readableBytes()<peerMaxFrameSize_){
+			if(!stream->producer(&stream->pending)){
+				stream->producer=HttpBodyProducer();
+			}
+			else if(stream->available()==0){
+				//producer暂时没有数据：挂起这个流，继续调度其它流
+				stream->parked=true;
+				sending_.erase(std::find(sending_.begin(),sending_.end(),stream));
+				continue;
+			}
+		}
+		const size_t available=stream->available();
+		const bool last=!stream->producer;
+		size_t len=std::min<size_t>(available,peerMaxFrameSize_);
+		len=static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(len),std::min(stream->sendWindow,connSendWindow_)));
+		const bool endStream=last&&len==available;
+		Buffer* out=output(Http2Frame::kHeaderSize+len);
+		Http2Frame::appendHeader(out,static_cast<uint32_t>(len),Http2Frame::kData,endStream?Http2Frame::kEndStream:0,stream->id);
+		out->append(stream->data(),len);
+		stream->consume(len);
+		stream->sendWindow-=len;
+		connSendWindow_-=len;
+		virtualTime_=stream->pass;
+		stream->pass+=(len+1)*kStride/stream->weight;
+		if(endStream){
+			finishResponse(stream);
+		}
+	}
+	commit();
+}
+
+void Http2Session::resumeStream(TcpConnection& conn,uint64_t streamId){
+	Http2Session* session=conn.getContext<Http2Session>();
+	Stream* stream=session?session->findStream(static_cast<uint32_t>(streamId)):nullptr;
+	if(stream==nullptr||!stream->parked){
+		return;
+	}
+	stream->parked=false;
+	//挂起期间攒下的份额不能用来插队，和新加入的流一样从当前时间开始
+	stream->pass=std::max(stream->pass,session->virtualTime_);
+	session->sending_.push_back(stream);
+	session->onWritable();
+}
+
+bool Http2Session::ready(const Stream* stream)const{
+	if(stream->available()==0&&!stream->producer){	//只剩一个空的END_STREAM，不占窗口
+		return true;
+	}
+	return stream->sendWindow>0&&connSendWindow_>0;
+}
+
+//紧急度小的优先，同一紧急度里pass最小的优先
+Http2Session::Stream* Http2Session::pickStream(){
+	Stream* best=nullptr;
+	for(Stream* stream:sending_){
+		if(!ready(stream)){
+			continue;
+		}
+		if(best==nullptr||stream->urgency<best->urgency
+			||(stream->urgency==best->urgency&&stream->pass<best->pass)){
+			best=stream;
+		}
+	}
+	return best;
+}
+
+void Http2Session::finishResponse(Stream* stream){
+	if(!stream->remoteClosed){
+		writeRstStream(stream->id,Http2Frame::kNoError);
+	}
+	closeStream(stream);
+}
+
+void Http2Session::handlePriority(const Http2Frame& frame,const char* payload){
+	if(frame.streamId==0){
+		connectionError(Http2Frame::kProtocolError,"PRIORITY on stream 0");
+		return;
+	}
+	if(frame.length!=5){
+		writeRstStream(frame.streamId,Http2Frame::kFrameSizeError);
+		return;
+	}
+	const uint32_t dependency=Http2Frame::readUint32(reinterpret_cast<const uint8_t*>(payload))&0x7fffffff;
+	Stream* stream=findStream(frame.streamId);
+	if(dependency==frame.streamId){
+		if(stream){
+			resetStream(stream,Http2Frame::kProtocolError);
+		}
+		else{
+			writeRstStream(frame.streamId,Http2Frame::kProtocolError);
+		}
+		return;
+	}
+	if(stream){
+		stream->weight=static_cast<uint16_t>(static_cast<uint8_t>(payload[4])+1);
+	}
+}
+
+void Http2Session::handleRstStream(const Http2Frame& frame,const char*){
+	if(frame.streamId==0){
+		connectionError(Http2Frame::kProtocolError,"RST_STREAM on stream 0");
+		return;
+	}
+	if(frame.length!=4){
+		connectionError(Http2Frame::kFrameSizeError,"bad RST_STREAM length");
+		return;
+	}
+	Stream* stream=findStream(frame.streamId);
+	if(stream){
+		closeStream(stream);
+	}
+	else if(frame.streamId>lastStreamId_){
+		connectionError(Http2Frame::kProtocolError,"RST_STREAM on idle stream");
+	}
+}
+
+void Http2Session::handleSettings(const Http2Frame& frame,const char* payload){
+	if(frame.streamId!=0){
+		connectionError(Http2Frame::kProtocolError,"SETTINGS on a stream");
+		return;
+	}
+	if(frame.flags&Http2Frame::kAck){
+		if(frame.length!=0){
+			connectionError(Http2Frame::kFrameSizeError,"SETTINGS ack with payload");
+		}
+		return;
+	}
+	if(frame.length%6!=0){
+		connectionError(Http2Frame::kFrameSizeError,"bad SETTINGS length");
+		return;
+	}
+	const uint8_t* p=reinterpret_cast<const uint8_t*>(payload);
+	for(uint32_t i=0;i<frame.length;i+=6){
+		const uint16_t id=static_cast<uint16_t>((p[i]<<8)|p[i+1]);
+		const uint32_t value=Http2Frame::readUint32(p+i+2);
+		switch(id){
+		case Http2Frame::kHeaderTableSize:
+			encoder_.setMaxTableSize(value);
+			break;
+		case Http2Frame::kEnablePush:
+			if(value>1){
+				connectionError(Http2Frame::kProtocolError,"bad ENABLE_PUSH");
+				return;
+			}
+			break;
+		case Http2Frame::kInitialWindowSize:{
+			if(value>Http2Frame::kMaxWindowSize){
+				connectionError(Http2Frame::kFlowControlError,"INITIAL_WINDOW_SIZE too large");
+				return;
+			}
+			//已有流的发送窗口按差值调整，可能变成负数
+			const int64_t delta=static_cast<int64_t>(value)-peerInitialWindow_;
+			for(auto& entry:streams_){
+				entry.second->sendWindow+=delta;
+				if(entry.second->sendWindow>Http2Frame::kMaxWindowSize){
+					connectionError(Http2Frame::kFlowControlError,"stream window overflow");
+					return;
+				}
+			}
+			peerInitialWindow_=value;
+			break;
+		}
+		case Http2Frame::kMaxFrameSize:
+			if(value<Http2Frame::kDefaultMaxFrameSize||value>Http2Frame::kMaxAllowedFrameSize){
+				connectionError(Http2Frame::kProtocolError,"bad MAX_FRAME_SIZE");
+				return;
+			}
+			peerMaxFrameSize_=value;
+			break;
+		default:	//MAX_CONCURRENT_STREAMS只限制推送，其余未知的设置忽略
+			break;
+		}
+	}
+	settingsReceived_=true;
+	writeSettingsAck();
+}
+
+void Http2Session::handlePing(const Http2Frame& frame,const char* payload){
+	if(frame.streamId!=0){
+		connectionError(Http2Frame::kProtocolError,"PING on a stream");
+		return;
+	}
+	if(frame.length!=8){
+		connectionError(Http2Frame::kFrameSizeError,"bad PING length");
+		return;
+	}
+	if((frame.flags&Http2Frame::kAck)==0){
+		Buffer* out=output(Http2Frame::kHeaderSize+8);
+		Http2Frame::appendHeader(out,8,Http2Frame::kPing,Http2Frame::kAck,0);
+		out->append(payload,8);
+	}
+}
+
+void Http2Session::handleGoAway(const Http2Frame& frame){
+	if(frame.streamId!=0){
+		connectionError(Http2Frame::kProtocolError,"GOAWAY on a stream");
+		return;
+	}
+	if(frame.length<8){
+		connectionError(Http2Frame::kFrameSizeError,"bad GOAWAY length");
+		return;
+	}
+	peerGoAway_=true;
+	if(streams_.empty()){
+		commit();
+		conn_->shutdown();
+	}
+}
+
+void Http2Session::handleWindowUpdate(const Http2Frame& frame,const char* payload){
+	if(frame.length!=4){
+		connectionError(Http2Frame::kFrameSizeError,"bad WINDOW_UPDATE length");
+		return;
+	}
+	const uint32_t increment=Http2Frame::readUint32(reinterpret_cast<const uint8_t*>(payload))&0x7fffffff;
+	if(frame.streamId==0){
+		if(increment==0){
+			connectionError(Http2Frame::kProtocolError,"zero WINDOW_UPDATE");
+			return;
+		}
+		connSendWindow_+=increment;
+		if(connSendWindow_>Http2Frame::kMaxWindowSize){
+			connectionError(Http2Frame::kFlowControlError,"connection window overflow");
+		}
+		return;
+	}
+	Stream* stream=findStream(frame.streamId);
+	if(stream==nullptr){
+		if(frame.streamId>lastStreamId_){
+			connectionError(Http2Frame::kProtocolError,"WINDOW_UPDATE on idle stream");
+		}
+		return;
+	}
+	if(increment==0){
+		resetStream(stream,Http2Frame::kProtocolError);
+		return;
+	}
+	stream->sendWindow+=increment;
+	if(stream->sendWindow>Http2Frame::kMaxWindowSize){
+		resetStream(stream,Http2Frame::kFlowControlError);
+	}
+}
+
+Http2Session::Stream* Http2Session::findStream(uint32_t id){
+	auto it=streams_.find(id);
+	return it==streams_.end()?nullptr:it->second.get();
+}
+
+void Http2Session::closeStream(Stream* stream){
+	auto it=std::find(sending_.begin(),sending_.end(),stream);
+	if(it!=sending_.end()){
+		sending_.erase(it);
+	}
+	streams_.erase(stream->id);
+	if(peerGoAway_&&streams_.empty()){
+		commit();
+		conn_->shutdown();
+	}
+}
+
+void Http2Session::resetStream(Stream* stream,Http2Frame::ErrorCode code){
+	writeRstStream(stream->id,code);
+	closeStream(stream);
+}
+
+void Http2Session::connectionError(Http2Frame::ErrorCode code,const char* reason){
+	if(goingAway_){
+		return;
+	}
+	LOG_INFO("Http2Session [%s] connection error %d: %s\n",conn_->name().c_str(),static_cast<int>(code),reason);
+	goingAway_=true;
+	Buffer* out=output(Http2Frame::kHeaderSize+8);
+	Http2Frame::appendHeader(out,8,Http2Frame::kGoAway,0,0);
+	out->appendInt32(static_cast<int32_t>(lastStreamId_));
+	out->appendInt32(static_cast<int32_t>(code));
+	commit();
+	conn_->shutdown();
+}
+
+Buffer* Http2Session::output(size_t bytes){
+	uncommitted_+=bytes;
+	return conn_->outputTail();
+}
+
+void Http2Session::commit(){
+	if(uncommitted_>0){
+		uncommitted_=0;
+		conn_->commitOutput();
+	}
+}
+
+void Http2Session::writeSettingsAck(){
+	Http2Frame::appendHeader(output(Http2Frame::kHeaderSize),0,Http2Frame::kSettings,Http2Frame::kAck,0);
+}
+
+void Http2Session::writeRstStream(uint32_t id,Http2Frame::ErrorCode code){
+	Buffer* out=output(Http2Frame::kHeaderSize+4);
+	Http2Frame::appendHeader(out,4,Http2Frame::kRstStream,0,id);
+	out->appendInt32(static_cast<int32_t>(code));
+}
+
+void Http2Session::writeWindowUpdate(uint32_t id,uint32_t increment){
+	Buffer* out=output(Http2Frame::kHeaderSize+4);
+	Http2Frame::appendHeader(out,4,Http2Frame::kWindowUpdate,0,id);
+	out->appendInt32(static_cast<int32_t>(increment));
+}
+
+//encodeBuffer_里的头部块按对端的最大帧长度切成一个HEADERS和若干CONTINUATION
+void Http2Session::writeHeaders(uint32_t id,bool endStream){
+	const char* data=encodeBuffer_.peek();
+	size_t remaining=encodeBuffer_.readableBytes();
+	bool first=true;
+	do{
+		const size_t len=std::min<size_t>(remaining,peerMaxFrameSize_);
+		remaining-=len;
+		uint8_t flags=remaining==0?Http2Frame::kEndHeaders:0;
+		if(first&&endStream){
+			flags|=Http2Frame::kEndStream;
+		}
+		Buffer* out=output(Http2Frame::kHeaderSize+len);
+		Http2Frame::appendHeader(out,static_cast<uint32_t>(len),first?Http2Frame::kHeaders:Http2Frame::kContinuation,flags,id);
+		out->append(data,len);
+		data+=len;
+		first=false;
+	}while(remaining>0);
+	encodeBuffer_.retrieveAll();
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+#include "Callable.hpp"
+#include "Buffer.hpp"
+#include "Hpack.hpp"
+#include "Http2Frame.hpp"
+#include "Http2Request.hpp"
+#include "Http2Response.hpp"
+
+class TcpConnection;
+
+using Http2Callback=Callable<void(const Http2Request&,Http2Response*)>;
+
+/*
+一条HTTP/2连接的协议状态，放在连接的context里，所有函数都在连接的loop线程里调用
+- 收：直接在inputBuffer_上逐帧解析，HEADERS和CONTINUATION拼成完整的头部块以后HPACK解码，请求收完(END_STREAM)时同步调用Http2Callback
+- 发：控制帧和HEADERS立即追加到待发送数据末尾；DATA帧由写调度器产生：
+  按紧急度(RFC 9218 priority头部的u=0..7)严格优先，同一紧急度内按权重(PRIORITY帧或HEADERS里的weight)做stride调度，多个流交错发送
+  一次调度最多让待发送数据达到高水位，剩下的等连接降到低水位或者收到WINDOW_UPDATE再继续
+- 流量控制：发送受对端连接级和流级窗口限制；接收时窗口消耗过半就用WINDOW_UPDATE补满
+- 连接错误发GOAWAY后关闭连接，流错误发RST_STREAM只关闭这个流
+不支持服务器推送；PRIORITY的依赖关系不建树，只用权重
+*/
+class Http2Session:noncopyable{
+public:
+	struct Config{
+		Config()
+			:maxConcurrentStreams(100)
+			,initialWindowSize(1<<20)
+			,maxHeaderListSize(64*1024)
+			,maxBodyBytes(16*1024*1024)
+			,highWaterMark(64*1024){}
+		uint32_t maxConcurrentStreams;
+		int32_t initialWindowSize;	//我们的接收窗口，连接级和流级相同
+		size_t maxHeaderListSize;
+		size_t maxBodyBytes;
+		size_t highWaterMark;	//调度DATA帧时待发送数据的上限
+	};
+
+	Http2Session(TcpConnection* conn,const Http2Callback* callback,const Config& config);
+	~Http2Session();
+
+	//连接建立以后发送服务器的SETTINGS
+	void start();
+	void onMessage(Buffer* buf);
+	//连接的待发送数据降到了低水位
+	void onWritable();
+
+	size_t streamCount()const{return streams_.size();}
+
+private:
+	struct Stream;
+
+	void handleFrame(const Http2Frame& frame,const char* payload);
+	void handleData(const Http2Frame& frame,const char* payload);
+	void handleHeaders(const Http2Frame& frame,const char* payload);
+	void handleContinuation(const Http2Frame& frame,const char* payload);
+	void handlePriority(const Http2Frame& frame,const char* payload);
+	void handleRstStream(const Http2Frame& frame,const char* payload);
+	void handleSettings(const Http2Frame& frame,const char* payload);
+	void handlePing(const Http2Frame& frame,const char* payload);
+	void handleGoAway(const Http2Frame& frame);
+	void handleWindowUpdate(const Http2Frame& frame,const char* payload);
+
+	void finishHeaderBlock();
+	bool setRequestHeaders(Stream* stream,HpackHeaderList& headers);
+	void dispatch(Stream* stream);
+	void sendResponse(Stream* stream,Http2Response& resp);
+	void respondError(Stream* stream,int status);
+
+	//写调度
+	void flush();
+	Stream* pickStream();
+	//HttpStreamResumer::Action：挂起的流重新参加调度
+	static void resumeStream(TcpConnection& conn,uint64_t streamId);
+	bool ready(const Stream* stream)const;
+	void finishResponse(Stream* stream);
+
+	Stream* findStream(uint32_t id);
+	void closeStream(Stream* stream);
+	void resetStream(Stream* stream,Http2Frame::ErrorCode code);
+	void connectionError(Http2Frame::ErrorCode code,const char* reason);
+
+	//帧直接写进连接待发送数据的末尾，由commit统一提交
+	Buffer* output(size_t bytes);
+	void commit();
+	void writeSettingsAck();
+	void writeRstStream(uint32_t id,Http2Frame::ErrorCode code);
+	void writeWindowUpdate(uint32_t id,uint32_t increment);
+	void writeHeaders(uint32_t id,bool endStream);
+
+	TcpConnection* conn_;
+	const Http2Callback* callback_;
+	const Config config_;
+	HpackDecoder decoder_;
+	HpackEncoder encoder_;
+
+	std::unordered_map<uint32_t,std::unique_ptr<Stream>> streams_;
+	std::vector<Stream*> sending_;	//响应body还没发完的流，不包括producer暂时没有数据而挂起的流
+	uint64_t virtualTime_;	//stride调度的当前时间，新加入的流从这里开始，不能用攒下的份额插队
+
+	Buffer headerBlock_;	//正在拼接的头部块
+	uint32_t blockStream_;	//头部块所属的流，等待CONTINUATION时不为0
+	bool blockEndStream_;
+	bool blockNewStream_;
+	bool blockSelfDependent_;
+	uint16_t blockWeight_;
+	Buffer encodeBuffer_;	//编码响应头部块，按对端的最大帧长度切成HEADERS和CONTINUATION
+
+	uint32_t lastStreamId_;
+	int64_t connSendWindow_;
+	int64_t connRecvWindow_;
+	int64_t peerInitialWindow_;
+	uint32_t peerMaxFrameSize_;
+	size_t uncommitted_;	//已经追加但还没有commitOutput的字节数
+	bool prefaceReceived_;
+	bool settingsReceived_;
+	bool goingAway_;	//发出了GOAWAY，不再处理输入
+	bool peerGoAway_;	//对端发了GOAWAY，现有的流结束以后关闭连接
+};
@@ -0,0 +1,252 @@
+#include "HttpParser.hpp"
+#include "Buffer.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+namespace{
+struct MethodName{
+	const char* name;
+	size_t len;
+	HttpRequest::Method method;
+};
+const MethodName kMethods[]={
+	{"GET",3,HttpRequest::kGet},
+	{"HEAD",4,HttpRequest::kHead},
+	{"POST",4,HttpRequest::kPost},
+	{"PUT",3,HttpRequest::kPut},
+	{"DELETE",6,HttpRequest::kDelete},
+	{"OPTIONS",7,HttpRequest::kOptions},
+	{"PATCH",5,HttpRequest::kPatch},
+};
+
+bool isBlank(char c){
+	return c==' '||c=='\t';
+}
+
+//Connection头部是逗号分隔的token列表
+bool hasToken(StringPiece value,StringPiece token){
+	size_t pos=0;
+	while(pos<value.size()){
+		size_t comma=pos;
+		while(comma<value.size()&&value[comma]!=','){
+			++comma;
+		}
+		size_t b=pos,e=comma;
+		while(b<e&&isBlank(value[b])){
+			++b;
+		}
+		while(e>b&&isBlank(value[e-1])){
+			--e;
+		}
+		if(value.substr(b,e-b).caseEquals(token)){
+			return true;
+		}
+		pos=comma+1;
+	}
+	return false;
+}
+}
+
+HttpParser::HttpParser(size_t maxHeaderBytes,size_t maxBodyBytes)
+	:maxHeaderBytes_(maxHeaderBytes)
+	,maxBodyBytes_(std::min(maxBodyBytes,static_cast<size_t>(std::numeric_limits<uint32_t>::max())))
+{
+	reset();
+}
+
+void HttpParser::reset(){
+	state_=kRequestLine;
+	scanned_=0;
+	lineStart_=0;
+	requestBytes_=0;
+	errorStatus_=0;
+	hasContentLength_=false;
+	connectionClose_=false;
+	connectionKeepAlive_=false;
+	expectContinue_=false;
+	request_.reset();
+}
+
+HttpParser::Result HttpParser::parse(const Buffer* buf){
+	const char* begin=buf->peek();
+	const size_t readable=buf->readableBytes();
+	while(state_!=kBody){
+		const char* newline=static_cast<const char*>(::memchr(begin+scanned_,'\n',readable-scanned_));
+		if(newline==nullptr){
+			scanned_=readable;
+			return readable>maxHeaderBytes_?fail(431):kNeedMore;
+		}
+		scanned_=newline-begin+1;
+		if(scanned_>maxHeaderBytes_){
+			return fail(431);
+		}
+		const char* lineBegin=begin+lineStart_;
+		const char* lineEnd=(newline>lineBegin&&newline[-1]=='\r')?newline-1:newline;
+		lineStart_=scanned_;
+		if(state_==kRequestLine){
+			if(lineEnd==lineBegin){	//请求之前的空行忽略
+				continue;
+			}
+			if(!parseRequestLine(begin,lineBegin,lineEnd)){
+				return kError;
+			}
+			state_=kHeaders;
+		}
+		else if(lineEnd==lineBegin){	//空行，头部结束
+			finishHeaders();
+			request_.bodyOffset_=static_cast<uint32_t>(lineStart_);
+			state_=kBody;
+		}
+		else if(!parseHeader(begin,lineBegin,lineEnd)){
+			return kError;
+		}
+	}
+	const size_t total=static_cast<size_t>(request_.bodyOffset_)+request_.bodyLen_;
+	if(readable<total){
+		return kNeedMore;
+	}
+	request_.base_=begin;
+	requestBytes_=total;
+	return kComplete;
+}
+
+bool HttpParser::takeExpectContinue(){
+	if(expectContinue_&&state_==kBody){
+		expectContinue_=false;
+		return true;
+	}
+	return false;
+}
+
+//METHOD SP request-target SP HTTP-version
+bool HttpParser::parseRequestLine(const char* begin,const char* lineBegin,const char* lineEnd){
+	const char* sp1=static_cast<const char*>(::memchr(lineBegin,' ',lineEnd-lineBegin));
+	if(sp1==nullptr||sp1==lineBegin){
+		errorStatus_=400;
+		return false;
+	}
+	const char* target=sp1+1;
+	const char* sp2=static_cast<const char*>(::memchr(target,' ',lineEnd-target));
+	if(sp2==nullptr||sp2==target){
+		errorStatus_=400;
+		return false;
+	}
+
+	StringPiece method(lineBegin,sp1-lineBegin);
+	for(const MethodName& m:kMethods){
+		if(method.equals(StringPiece(m.name,m.len))){
+			request_.method_=m.method;
+			break;
+		}
+	}
+	if(request_.method_==HttpRequest::kInvalid){
+		errorStatus_=501;
+		return false;
+	}
+	request_.methodOffset_=static_cast<uint32_t>(lineBegin-begin);
+	request_.methodLen_=static_cast<uint32_t>(method.size());
+
+	StringPiece version(sp2+1,lineEnd-sp2-1);
+	if(version.equals("HTTP/1.1")){
+		request_.version_=HttpRequest::kHttp11;
+	}
+	else if(version.equals("HTTP/1.0")){
+		request_.version_=HttpRequest::kHttp10;
+	}
+	else{
+		errorStatus_=version.startsWith("HTTP/")?505:400;
+		return false;
+	}
+
+	const char* question=static_cast<const char*>(::memchr(target,'?',sp2-target));
+	const char* pathEnd=question?question:sp2;
+	request_.pathOffset_=static_cast<uint32_t>(target-begin);
+	request_.pathLen_=static_cast<uint32_t>(pathEnd-target);
+	if(question){
+		request_.queryOffset_=static_cast<uint32_t>(question+1-begin);
+		request_.queryLen_=static_cast<uint32_t>(sp2-question-1);
+	}
+	return true;
+}
+
+//field-name ":" OWS field-value OWS，不支持已经废弃的折行
+bool HttpParser::parseHeader(const char* begin,const char* lineBegin,const char* lineEnd){
+	const char* colon=static_cast<const char*>(::memchr(lineBegin,':',lineEnd-lineBegin));
+	if(colon==nullptr||colon==lineBegin||isBlank(lineBegin[0])||isBlank(colon[-1])){
+		errorStatus_=400;
+		return false;
+	}
+	const char* valueBegin=colon+1;
+	const char* valueEnd=lineEnd;
+	while(valueBegin<valueEnd&&isBlank(*valueBegin)){
+		++valueBegin;
+	}
+	while(valueEnd>valueBegin&&isBlank(valueEnd[-1])){
+		--valueEnd;
+	}
+	HttpRequest::Field field;
+	field.nameOffset=static_cast<uint32_t>(lineBegin-begin);
+	field.nameLen=static_cast<uint32_t>(colon-lineBegin);
+	field.valueOffset=static_cast<uint32_t>(valueBegin-begin);
+	field.valueLen=static_cast<uint32_t>(valueEnd-valueBegin);
+	request_.fields_.push_back(field);
+
+	//只关心决定消息边界和连接管理的几个头部
+	StringPiece name(lineBegin,colon-lineBegin);
+	StringPiece value(valueBegin,valueEnd-valueBegin);
+	if(name.caseEquals("Content-Length")){
+		if(value.empty()){
+			errorStatus_=400;
+			return false;
+		}
+		size_t length=0;
+		for(size_t i=0;i<value.size();++i){
+			if(value[i]<'0'||value[i]>'9'){
+				errorStatus_=400;
+				return false;
+			}
+			length=length*10+(value[i]-'0');
+			if(length>maxBodyBytes_){
+				errorStatus_=413;
+				return false;
+			}
+		}
+		//重复的Content-Length取值不同是请求走私的典型手法
+		if(hasContentLength_&&length!=request_.bodyLen_){
+			errorStatus_=400;
+			return false;
+		}
+		hasContentLength_=true;
+		request_.bodyLen_=static_cast<uint32_t>(length);
+	}
+	else if(name.caseEquals("Transfer-Encoding")){
+		errorStatus_=501;	//不支持chunked请求体
+		return false;
+	}
+	else if(name.caseEquals("Connection")){
+		connectionClose_=connectionClose_||hasToken(value,"close");
+		connectionKeepAlive_=connectionKeepAlive_||hasToken(value,"keep-alive");
+	}
+	else if(name.caseEquals("Expect")){
+		if(!value.caseEquals("100-continue")){
+			errorStatus_=417;
+			return false;
+		}
+		expectContinue_=true;
+	}
+	return true;
+}
+
+void HttpParser::finishHeaders(){
+	if(request_.version_==HttpRequest::kHttp11){
+		request_.keepAlive_=!connectionClose_;
+	}
+	else{
+		request_.keepAlive_=connectionKeepAlive_&&!connectionClose_;
+	}
+	if(request_.bodyLen_==0){
+		expectContinue_=false;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+
+#include "noncopyable.hpp"
+#include "HttpRequest.hpp"
+
+class Buffer;
+
+/*
+增量HTTP/1.x请求解析器，每条连接一个，保存在连接的context里
+每次从buf->peek()开始解析一个请求，数据不完整时记下已经扫描到的位置，下次读到数据以后从那里继续，不会重扫
+字段只记录偏移，不拷贝；请求处理完以后由调用方retrieve(requestBytes())并reset()，接着解析流水线里的下一个请求
+*/
+class HttpParser:noncopyable{
+public:
+	enum Result{kNeedMore,kComplete,kError};
+
+	static const size_t kDefaultMaxHeaderBytes=64*1024;
+	static const size_t kDefaultMaxBodyBytes=16*1024*1024;
+
+	explicit HttpParser(size_t maxHeaderBytes=kDefaultMaxHeaderBytes,size_t maxBodyBytes=kDefaultMaxBodyBytes);
+
+	Result parse(const Buffer* buf);
+	//kComplete以后有效，在buf被改动之前有效
+	const HttpRequest& request()const{return request_;}
+	size_t requestBytes()const{return requestBytes_;}
+	//kError时应该回复的状态码：400/413/417/431/501/505
+	int errorStatus()const{return errorStatus_;}
+	//头部已经收完、body还没收完而且客户端在等100 Continue，每个请求只返回一次true
+	bool takeExpectContinue();
+
+	void reset();
+
+private:
+	enum State{kRequestLine,kHeaders,kBody};
+
+	bool parseRequestLine(const char* begin,const char* lineBegin,const char* lineEnd);
+	bool parseHeader(const char* begin,const char* lineBegin,const char* lineEnd);
+	void finishHeaders();
+	Result fail(int status){errorStatus_=status;return kError;}
+
+	const size_t maxHeaderBytes_;
+	const size_t maxBodyBytes_;
+	State state_;
+	size_t scanned_;	//相对请求开头已经扫描过的字节数
+	size_t lineStart_;	//当前行的起点
+	size_t requestBytes_;
+	int errorStatus_;
+	bool hasContentLength_;
+	bool connectionClose_;
+	bool connectionKeepAlive_;
+	bool expectContinue_;
+	HttpRequest request_;
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+#include "StringPiece.hpp"
+
+/*
+HttpParser解析出的一个请求，所有字段都是相对请求起始位置的偏移，不拷贝进string
+base_在请求解析完成时指向inputBuffer_里的请求开头，返回的StringPiece只在HttpCallback执行期间有效
+*/
+class HttpRequest{
+public:
+	enum Method{kInvalid,kGet,kHead,kPost,kPut,kDelete,kOptions,kPatch};
+	enum Version{kUnknown,kHttp10,kHttp11};
+
+	HttpRequest(){reset();}
+
+	Method method()const{return method_;}
+	Version version()const{return version_;}
+	StringPiece methodString()const{return piece(methodOffset_,methodLen_);}
+	StringPiece path()const{return piece(pathOffset_,pathLen_);}
+	StringPiece query()const{return piece(queryOffset_,queryLen_);}	//不含'?'
+	StringPiece body()const{return piece(bodyOffset_,bodyLen_);}
+
+	size_t headerCount()const{return fields_.size();}
+	StringPiece headerName(size_t i)const{return piece(fields_[i].nameOffset,fields_[i].nameLen);}
+	StringPiece headerValue(size_t i)const{return piece(fields_[i].valueOffset,fields_[i].valueLen);}
+	//名字大小写不敏感，找不到返回空的StringPiece；同名头部只返回第一个
+	StringPiece header(StringPiece name)const{
+		for(const Field& field:fields_){
+			if(piece(field.nameOffset,field.nameLen).caseEquals(name)){
+				return piece(field.valueOffset,field.valueLen);
+			}
+		}
+		return StringPiece();
+	}
+
+	//HTTP/1.1默认保持连接，HTTP/1.0需要Connection: keep-alive
+	bool keepAlive()const{return keepAlive_;}
+	size_t contentLength()const{return bodyLen_;}
+
+private:
+	friend class HttpParser;
+
+	struct Field{
+		uint32_t nameOffset;
+		uint32_t nameLen;
+		uint32_t valueOffset;
+		uint32_t valueLen;
+	};
+
+	StringPiece piece(uint32_t offset,uint32_t len)const{return StringPiece(base_+offset,len);}
+	//fields_只清空不释放，连接上之后的请求复用它的内存
+	void reset(){
+		base_="";
+		method_=kInvalid;
+		version_=kUnknown;
+		methodOffset_=methodLen_=pathOffset_=pathLen_=queryOffset_=queryLen_=bodyOffset_=bodyLen_=0;
+		keepAlive_=false;
+		fields_.clear();
+	}
+
+	const char* base_;
+	Method method_;
+	Version version_;
+	uint32_t methodOffset_;	//请求行之前可以有空行
+	uint32_t methodLen_;
+	uint32_t pathOffset_;
+	uint32_t pathLen_;
+	uint32_t queryOffset_;
+	uint32_t queryLen_;
+	uint32_t bodyOffset_;
+	uint32_t bodyLen_;
+	bool keepAlive_;
+	std::vector<Field> fields_;
+};
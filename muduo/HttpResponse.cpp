@@ -0,0 +1,225 @@
+#include "HttpResponse.hpp"
+#include "TcpConnection.hpp"
+#include "EventLoop.hpp"
+#include "Buffer.hpp"
+
+namespace{
+//整数转十进制，返回写入的字节数，buf至少24字节
+size_t formatInt(char* buf,int64_t value){
+	char tmp[24];
+	size_t n=0;
+	uint64_t v=value<0?0-static_cast<uint64_t>(value):static_cast<uint64_t>(value);
+	do{
+		tmp[n++]=static_cast<char>('0'+v%10);
+		v/=10;
+	}while(v!=0);
+	size_t len=0;
+	if(value<0){
+		buf[len++]='-';
+	}
+	while(n>0){
+		buf[len++]=tmp[--n];
+	}
+	return len;
+}
+}
+
+void HttpStreamResumer::resume()const{
+	TcpConnectionPtr conn=conn_.lock();
+	if(!conn||action_==nullptr){
+		return;
+	}
+	std::weak_ptr<TcpConnection> weakConn(conn_);
+	Action action=action_;
+	uint64_t streamId=streamId_;
+	conn->getLoop()->queueInLoop([weakConn,action,streamId](){
+		TcpConnectionPtr c=weakConn.lock();
+		if(c&&c->connected()){
+			action(*c,streamId);
+		}
+	});
+}
+
+HttpResponse::HttpResponse(TcpConnection& conn,const HttpRequest& request)
+	:conn_(conn)
+	,version_(request.version())
+	,headRequest_(request.method()==HttpRequest::kHead)
+	,closeConnection_(!request.keepAlive())
+	,statusCode_(200)
+	,reason_(nullptr)
+	,statusWritten_(false)
+	,finished_(false)
+	,chunked_(false)
+	,resumeAction_(nullptr)
+	,streamId_(0)
+{
+}
+
+HttpResponse::HttpResponse(TcpConnection& conn,HttpRequest::Version version,bool closeConnection)
+	:conn_(conn)
+	,version_(version)
+	,headRequest_(false)
+	,closeConnection_(closeConnection)
+	,statusCode_(200)
+	,reason_(nullptr)
+	,statusWritten_(false)
+	,finished_(false)
+	,chunked_(false)
+	,resumeAction_(nullptr)
+	,streamId_(0)
+{
+}
+
+HttpResponse::~HttpResponse(){
+	if(!finished_){
+		if(headRequest_){	//HEAD的handler没有设置body时不知道GET的长度，不能写Content-Length: 0
+			finishHeaders(-1);
+		}
+		else{
+			setBody(StringPiece());
+		}
+	}
+}
+
+//每次都重新取，handler里sendFile之类的调用可能让待发送数据的末尾换成另一个Buffer
+Buffer* HttpResponse::output(){
+	return conn_.outputTail();
+}
+
+void HttpResponse::setStatus(int code,const char* reason){
+	statusCode_=code;
+	reason_=reason;
+}
+
+void HttpResponse::writeStatusLine(){
+	statusWritten_=true;
+	Buffer* buf=output();
+	char line[64];
+	size_t len=0;
+	::memcpy(line,"HTTP/1.1 ",9);
+	len+=9;
+	len+=formatInt(line+len,statusCode_);
+	line[len++]=' ';
+	buf->append(line,len);
+	const char* reason=reason_?reason_:reasonPhrase(statusCode_);
+	buf->append(reason,::strlen(reason));
+	buf->append("\r\n",2);
+}
+
+void HttpResponse::addHeader(StringPiece name,StringPiece value){
+	if(finished_){
+		return;
+	}
+	if(!statusWritten_){
+		writeStatusLine();
+	}
+	Buffer* buf=output();
+	buf->append(name.data(),name.size());
+	buf->append(": ",2);
+	buf->append(value.data(),value.size());
+	buf->append("\r\n",2);
+}
+
+void HttpResponse::addHeader(StringPiece name,int64_t value){
+	char digits[24];
+	addHeader(name,StringPiece(digits,formatInt(digits,value)));
+}
+
+//写出Content-Length、Connection和空行，返回是否还要写body
+bool HttpResponse::finishHeaders(int64_t contentLength){
+	const bool noBody=statusCode_==204||statusCode_==304||(statusCode_>=100&&statusCode_<200);
+	if(!noBody&&contentLength>=0){
+		addHeader("Content-Length",contentLength);
+	}
+	if(closeConnection_){
+		addHeader("Connection","close");
+	}
+	else if(version_==HttpRequest::kHttp10){
+		addHeader("Connection","keep-alive");
+	}
+	if(!statusWritten_){
+		writeStatusLine();
+	}
+	output()->append("\r\n",2);
+	finished_=true;
+	return !noBody&&!headRequest_;
+}
+
+void HttpResponse::setBody(StringPiece body){
+	if(finished_){
+		return;
+	}
+	if(finishHeaders(static_cast<int64_t>(body.size()))){
+		output()->append(body.data(),body.size());
+	}
+}
+
+void HttpResponse::setFileBody(int fd,off_t offset,size_t length,const std::shared_ptr<void>& owner){
+	if(finished_){
+		return;
+	}
+	if(finishHeaders(static_cast<int64_t>(length))&&length>0){
+		conn_.sendFile(fd,offset,length,owner);
+	}
+}
+
+void HttpResponse::setSharedBody(const std::shared_ptr<void>& owner,StringPiece body){
+	if(finished_){
+		return;
+	}
+	if(finishHeaders(static_cast<int64_t>(body.size()))&&!body.empty()){
+		conn_.sendShared(owner,body.data(),body.size());
+	}
+}
+
+void HttpResponse::setStreamBody(HttpBodyProducer producer){
+	if(finished_){
+		return;
+	}
+	const bool noBody=statusCode_==204||statusCode_==304||(statusCode_>=100&&statusCode_<200);
+	if(!noBody){
+		if(version_==HttpRequest::kHttp11){
+			addHeader("Transfer-Encoding","chunked");
+			chunked_=true;
+		}
+		else{	//没有长度也没有chunked，只能靠关闭连接标记body结束
+			closeConnection_=true;
+		}
+	}
+	if(finishHeaders(-1)){
+		producer_=std::move(producer);
+	}
+}
+
+HttpStreamResumer HttpResponse::streamResumer()const{
+	if(resumeAction_==nullptr){
+		return HttpStreamResumer();
+	}
+	return HttpStreamResumer(conn_.shared_from_this(),resumeAction_,streamId_);
+}
+
+const char* HttpResponse::reasonPhrase(int code){
+	switch(code){
+	case 100: return "Continue";
+	case 200: return "OK";
+	case 201: return "Created";
+	case 204: return "No Content";
+	case 206: return "Partial Content";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 413: return "Payload Too Large";
+	case 416: return "Range Not Satisfiable";
+	case 417: return "Expectation Failed";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 503: return "Service Unavailable";
+	case 505: return "HTTP Version Not Supported";
+	default: return "Unknown";
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+#include "Callable.hpp"
+#include "HttpRequest.hpp"
+
+class TcpConnection;
+class Buffer;
+
+//流式body的生产者：每次调用往buf末尾追加下一段数据，返回false表示已经结束(这一次追加的数据照常发送)
+//返回true但没有追加数据表示暂时没有数据：流被挂起，不再调用producer，直到数据源调用HttpStreamResumer::resume()
+using HttpBodyProducer=Callable<bool(Buffer*)>;
+
+/*
+挂起的流式响应的唤醒句柄，HTTP/1.1和HTTP/2共用，从HttpResponse/Http2Response::streamResumer()取得
+可以复制，可以在任意线程调用resume()；只持有连接的weak_ptr，连接断开或者流已经结束时resume()什么也不做
+*/
+class HttpStreamResumer{
+public:
+	//在连接的loop线程里唤醒编号为streamId的流
+	using Action=void(*)(TcpConnection& conn,uint64_t streamId);
+
+	HttpStreamResumer():action_(nullptr),streamId_(0){}
+	HttpStreamResumer(const std::shared_ptr<TcpConnection>& conn,Action action,uint64_t streamId)
+		:conn_(conn),action_(action),streamId_(streamId){}
+
+	//总是排队到loop里执行，producer里直接调用也不会重入
+	void resume()const;
+
+private:
+	std::weak_ptr<TcpConnection> conn_;
+	Action action_;
+	uint64_t streamId_;
+};
+
+/*
+响应构造器：按 状态行->头部->body 的顺序直接写进连接待发送数据的末尾(TcpConnection::outputTail)，不经过中间的string
+流水线上的多个响应连续追加，由HttpServer在处理完这一批请求以后统一commitOutput发送
+*/
+class HttpResponse:noncopyable{
+	friend class HttpServer;
+public:
+	HttpResponse(TcpConnection& conn,const HttpRequest& request);
+	//没有解析出请求时(例如回复解析错误)使用
+	HttpResponse(TcpConnection& conn,HttpRequest::Version version,bool closeConnection);
+	//没有调用setBody的响应在这里补上空的body；HEAD请求只结束头部，不写Content-Length
+	~HttpResponse();
+
+	//状态行在第一个头部之前写出，所以必须最先调用；默认200，reason为空时使用标准的描述
+	void setStatus(int code,const char* reason=nullptr);
+	//在setBody之前调用，决定写出的Connection头部以及HttpServer是否在响应后关闭连接
+	void setCloseConnection(bool on){closeConnection_=on;}
+	void addHeader(StringPiece name,StringPiece value);
+	void addHeader(StringPiece name,int64_t value);
+	void setContentType(StringPiece type){addHeader("Content-Type",type);}
+	//写出Content-Length、Connection和body，响应到此结束；HEAD请求只写头部
+	void setBody(StringPiece body);
+	//body是文件的[offset,offset+length)，用sendfile发送，owner保证发完以前fd不被关闭
+	void setFileBody(int fd,off_t offset,size_t length,const std::shared_ptr<void>& owner);
+	//body是owner持有的内存(例如mmap的文件)，不拷贝，和前面的头部一起writev
+	void setSharedBody(const std::shared_ptr<void>& owner,StringPiece body);
+	//只写出头部，body由HttpServer在连接的待发送数据降到低水位以下时反复调用producer取得，整个body不需要放在内存里
+	//HTTP/1.1使用chunked编码；HTTP/1.0不支持chunked，body写完以后关闭连接。HEAD请求不会调用producer
+	//producer在连接的loop线程里调用，不能引用HttpRequest里的数据；连接提前断开时producer随之析构
+	void setStreamBody(HttpBodyProducer producer);
+	//producer暂时没有数据时用来唤醒这个流，交给数据源保存；没有经过HttpServer的响应返回空句柄
+	HttpStreamResumer streamResumer()const;
+
+	int statusCode()const{return statusCode_;}
+	bool closeConnection()const{return closeConnection_;}
+	bool finished()const{return finished_;}
+	TcpConnection& connection()const{return conn_;}
+
+	static const char* reasonPhrase(int code);
+
+private:
+	Buffer* output();
+	void writeStatusLine();
+	//contentLength小于0表示流式body，不写Content-Length
+	bool finishHeaders(int64_t contentLength);
+
+	TcpConnection& conn_;
+	HttpRequest::Version version_;
+	bool headRequest_;
+	bool closeConnection_;
+	int statusCode_;
+	const char* reason_;
+	bool statusWritten_;
+	bool finished_;
+	bool chunked_;
+	HttpBodyProducer producer_;	//setStreamBody以后由HttpServer取走
+	HttpStreamResumer::Action resumeAction_;	//由HttpServer设置
+	uint64_t streamId_;
+};
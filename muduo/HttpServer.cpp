@@ -0,0 +1,170 @@
+#include "HttpServer.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+
+namespace{
+void defaultHttpCallback(const HttpRequest&,HttpResponse* resp){
+	resp->setStatus(404);
+	resp->setBody("Not Found");
+}
+}
+
+HttpServer::HttpServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& name,TcpServer::Option option)
+	:server_(loop,listenAddr,name,option)
+	,httpCallback_(defaultHttpCallback)
+	,maxHeaderBytes_(HttpParser::kDefaultMaxHeaderBytes)
+	,maxBodyBytes_(HttpParser::kDefaultMaxBodyBytes)
+	,streamLowWaterMark_(16*1024)
+	,streamHighWaterMark_(64*1024)
+{
+	server_.setConnectionCallback([this](const TcpConnectionPtr& conn){ onConnection(conn); });
+	server_.setBorrowedMessageCallback([this](TcpConnection& conn,Buffer* buf,Timestamp){
+		onMessage(conn,buf);
+	});
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn){
+	if(conn->connected()){
+		conn->setContext<Session>(this,maxHeaderBytes_,maxBodyBytes_);
+		//越过高水位只需要连接记下状态，降到低水位时继续拉取流式响应
+		conn->setHighWaterMarkCallback(HighWaterMarkCallback(),streamHighWaterMark_);
+		conn->setLowWaterMarkCallback([this](const TcpConnectionPtr& c,size_t){ resumeStream(*c); },streamLowWaterMark_);
+	}
+}
+
+void HttpServer::onMessage(TcpConnection& conn,Buffer* buf){
+	Session* session=conn.getContext<Session>();
+	if(session==nullptr||!conn.connected()){	//已经决定关闭的连接丢弃后面的请求
+		buf->retrieveAll();
+		return;
+	}
+	session->input=buf;
+	if(session->producer){
+		//前面的流式响应还没发完，请求先留在buf里；积压太多时停止读，让TCP把背压传给客户端
+		if(buf->readableBytes()>maxHeaderBytes_&&conn.isReading()){
+			conn.stopRead();
+			session->readPaused=true;
+		}
+		return;
+	}
+	processRequests(conn,session,false);
+}
+
+void HttpServer::processRequests(TcpConnection& conn,Session* session,bool close){
+	Buffer* buf=session->input;
+	HttpParser* parser=&session->parser;
+	while(!close&&buf->readableBytes()>0){
+		HttpParser::Result result=parser->parse(buf);
+		if(result==HttpParser::kNeedMore){
+			if(parser->takeExpectContinue()){
+				static const char kContinue[]="HTTP/1.1 100 Continue\r\n\r\n";
+				conn.outputTail()->append(kContinue,sizeof(kContinue)-1);
+			}
+			break;
+		}
+		if(result==HttpParser::kError){
+			LOG_INFO("HttpServer [%s] bad request, status %d\n",conn.name().c_str(),parser->errorStatus());
+			HttpResponse resp(conn,HttpRequest::kHttp11,true);
+			resp.setStatus(parser->errorStatus());
+			resp.setBody(HttpResponse::reasonPhrase(parser->errorStatus()));
+			buf->retrieveAll();
+			close=true;
+			break;
+		}
+		{
+			HttpResponse resp(conn,parser->request());
+			resp.resumeAction_=&HttpServer::resumeParked;
+			resp.streamId_=++session->streamId;
+			httpCallback_(parser->request(),&resp);
+			close=resp.closeConnection();
+			if(resp.producer_){
+				session->producer=std::move(resp.producer_);
+				session->chunked=resp.chunked_;
+			}
+		}
+		buf->retrieve(parser->requestBytes());
+		parser->reset();
+		if(session->producer&&!pumpStream(conn,session)){
+			session->closeAfter=close;	//等低水位回调继续，结束以后再处理后面的请求
+			return;
+		}
+	}
+	if(close){
+		buf->retrieveAll();
+	}
+	conn.commitOutput();
+	if(close){
+		conn.shutdown();	//响应发完以后半关闭
+	}
+	else if(session->readPaused){
+		session->readPaused=false;
+		conn.startRead();
+	}
+}
+
+//拉取流式响应直到待发送数据达到高水位，返回响应是否已经结束
+bool HttpServer::pumpStream(TcpConnection& conn,Session* session){
+	static const char kPlaceholder[]="00000000\r\n";	//chunk长度允许前导0，先占位，数据写完再回填
+	static const size_t kPlaceholderLen=sizeof(kPlaceholder)-1;
+	size_t produced=0;
+	while(conn.connected()){
+		if(conn.outputBytes()>=streamHighWaterMark_){
+			return false;
+		}
+		if(produced>=streamHighWaterMark_){
+			//数据一直能直接写出去时也要让出loop，避免一个大响应占住其它连接
+			TcpConnectionPtr self(conn.shared_from_this());
+			conn.getLoop()->queueInLoop([this,self](){ resumeStream(*self); });
+			return false;
+		}
+		Buffer* out=conn.outputTail();
+		if(session->chunked){
+			out->append(kPlaceholder,kPlaceholderLen);
+		}
+		const size_t start=out->readableBytes();
+		const bool more=session->producer(out);
+		const size_t len=out->readableBytes()-start;
+		if(session->chunked){
+			if(len==0){	//长度为0的chunk表示结束，这一次没有数据就撤掉占位
+				out->unwrite(kPlaceholderLen);
+			}
+			else{
+				char* size=out->beginWrite()-len-kPlaceholderLen;
+				static const char kHex[]="0123456789abcdef";
+				for(int i=7;i>=0;--i){
+					size[7-i]=kHex[(len>>(i*4))&0xf];
+				}
+				out->append("\r\n",2);
+			}
+			if(!more){
+				out->append("0\r\n\r\n",5);
+			}
+		}
+		produced+=len;
+		conn.commitOutput();
+		if(!more){
+			session->producer=HttpBodyProducer();
+			return true;
+		}
+		if(len==0){	//挂起，低水位回调也不再拉取，等resumeParked
+			session->parked=true;
+			return false;
+		}
+	}
+	return false;
+}
+
+void HttpServer::resumeStream(TcpConnection& conn){
+	Session* session=conn.getContext<Session>();
+	if(session&&session->producer&&!session->parked&&pumpStream(conn,session)){
+		processRequests(conn,session,session->closeAfter);
+	}
+}
+
+void HttpServer::resumeParked(TcpConnection& conn,uint64_t streamId){
+	Session* session=conn.getContext<Session>();
+	if(session&&session->parked&&session->streamId==streamId){
+		session->parked=false;
+		session->server->resumeStream(conn);
+	}
+}
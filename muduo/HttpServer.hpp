@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+
+#include "noncopyable.hpp"
+#include "Callable.hpp"
+#include "TcpServer.hpp"
+#include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include "HttpParser.hpp"
+
+/*
+TcpServer之上的HTTP/1.1服务器
+- 每条连接一个HttpParser放在连接的context里，请求跨多次读取时增量解析
+- 支持keep-alive和流水线：一次读事件里解析出的所有请求按顺序调用HttpCallback，响应按请求顺序追加，最后合并成一次写
+- HttpCallback同步填写HttpResponse，返回时没有setBody的响应补上空body
+- setStreamBody的响应按需拉取：待发送数据不到高水位时调用producer，到了以后等降到低水位再继续，每条连接占用的内存有上限
+  producer暂时没有数据时流被挂起，等HttpStreamResumer::resume()再继续，挂起期间不占用loop
+  流式响应发完以前，同一连接上流水线后面的请求留在输入缓冲里等待
+*/
+class HttpServer:noncopyable{
+public:
+	using HttpCallback=Callable<void(const HttpRequest&,HttpResponse*)>;
+
+	HttpServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& name,TcpServer::Option option=TcpServer::kNoReusePort);
+
+	void setHttpCallback(const HttpCallback& cb){httpCallback_=cb;}
+	void setThreadNum(int num){server_.setThreadNum(num);}
+	//对之后建立的连接生效
+	void setMaxHeaderBytes(size_t bytes){maxHeaderBytes_=bytes;}
+	void setMaxBodyBytes(size_t bytes){maxBodyBytes_=bytes;}
+	//流式响应的待发送数据达到high时暂停调用producer，降到low以下再继续
+	void setStreamWaterMarks(size_t low,size_t high){streamLowWaterMark_=low;streamHighWaterMark_=high;}
+	//TLS、慢消费者保护等TcpServer的设置
+	TcpServer& tcpServer(){return server_;}
+
+	void start(){server_.start();}
+
+private:
+	//每条连接的状态，放在连接的context里
+	struct Session{
+		Session(HttpServer* serverArg,size_t maxHeaderBytes,size_t maxBodyBytes)
+			:server(serverArg),parser(maxHeaderBytes,maxBodyBytes),input(nullptr),streamId(0),chunked(false),closeAfter(false),readPaused(false),parked(false){}
+		HttpServer* server;	//HttpStreamResumer只能拿到连接，从这里找回服务器
+		HttpParser parser;
+		HttpBodyProducer producer;	//正在发送的流式响应
+		uint64_t streamId;	//每个请求加一，过期的HttpStreamResumer不会唤醒后面的流
+		Buffer* input;	//连接的输入缓冲，流式响应结束以后从这里继续处理后面的请求
+		bool chunked;
+		bool closeAfter;	//流式响应结束以后关闭连接
+		bool readPaused;	//流式响应期间积压的请求太多，暂停了读
+		bool parked;	//producer暂时没有数据，等resume
+	};
+
+	void onConnection(const TcpConnectionPtr& conn);
+	void onMessage(TcpConnection& conn,Buffer* buf);
+	void processRequests(TcpConnection& conn,Session* session,bool close);
+	bool pumpStream(TcpConnection& conn,Session* session);
+	void resumeStream(TcpConnection& conn);
+	static void resumeParked(TcpConnection& conn,uint64_t streamId);
+
+	TcpServer server_;
+	HttpCallback httpCallback_;
+	size_t maxHeaderBytes_;
+	size_t maxBodyBytes_;
+	size_t streamLowWaterMark_;
+	size_t streamHighWaterMark_;
+};
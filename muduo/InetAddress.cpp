@@ -1,33 +1,92 @@
 #include "InetAddress.hpp"
+#include "Logger.hpp"
+
+#include <stddef.h>
+#include <algorithm>
 
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
     bzero(&addr_, sizeof(addr_));
-    addr_.sin_family = AF_INET;
-    addr_.sin_port = htons(port);
-    addr_.sin_addr.s_addr = inet_addr(ip.c_str());
+    addr_.in.sin_family = AF_INET;
+    addr_.in.sin_port = htons(port);
+    addr_.in.sin_addr.s_addr = inet_addr(ip.c_str());
+    len_ = sizeof(addr_.in);
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string &path)
+{
+    InetAddress addr;
+    bzero(&addr.addr_, sizeof(addr.addr_));
+    addr.addr_.un.sun_family = AF_UNIX;
+    if (path.size() > sizeof(addr.addr_.un.sun_path) - 1)
+    {
+        // 截断以后就成了另一个地址，直接拒绝
+        LOG_FATAL("InetAddress::fromUnixPath path too long (%zu > %zu): %s \n", path.size(), sizeof(addr.addr_.un.sun_path) - 1, path.c_str());
+    }
+    size_t len = path.size();
+    memcpy(addr.addr_.un.sun_path, path.data(), len);
+    if (len > 0 && path[0] == '@')
+    {
+        // 抽象命名空间：首字节为0，长度只算到路径末尾
+        addr.addr_.un.sun_path[0] = '\0';
+        addr.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len);
+    }
+    else
+    {
+        addr.len_ = sizeof(addr.addr_.un);
+    }
+    return addr;
+}
+
+void InetAddress::setSockAddr(const sockaddr *addr, socklen_t len)
+{
+    bzero(&addr_, sizeof(addr_));
+    len_ = std::min(len, static_cast<socklen_t>(sizeof(addr_)));
+    memcpy(&addr_, addr, len_);
+}
+
+std::string InetAddress::unixPath() const
+{
+    if (!isUnix() || len_ <= offsetof(sockaddr_un, sun_path))
+    {
+        return std::string();
+    }
+    if (addr_.un.sun_path[0] == '\0')
+    {
+        size_t len = len_ - offsetof(sockaddr_un, sun_path);
+        return len > 0 ? "@" + std::string(addr_.un.sun_path + 1, len - 1) : std::string();
+    }
+    return std::string(addr_.un.sun_path, strnlen(addr_.un.sun_path, sizeof(addr_.un.sun_path)));
 }
 
 std::string InetAddress::toIp() const
 {
+    if (isUnix())
+    {
+        return unixPath();
+    }
     char buf[64];
-    inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
+    inet_ntop(AF_INET, &addr_.in.sin_addr, buf, sizeof(buf));
     return buf;
 }
 
 std::string InetAddress::toIpPort() const
 {
+    if (isUnix())
+    {
+        return "unix:" + unixPath();
+    }
     char buf[64];
-    inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
+    inet_ntop(AF_INET, &addr_.in.sin_addr, buf, sizeof(buf));
     size_t end = strlen(buf);
-    uint16_t port = htons(addr_.sin_port);
+    uint16_t port = htons(addr_.in.sin_port);
     sprintf(buf + end, ":%u", port);
     return buf;
 }
 
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    return isUnix() ? 0 : ntohs(addr_.in.sin_port);
 }
 
 // int main(){
@@ -36,4 +95,4 @@ uint16_t InetAddress::toPort() const
 //     std::cout<<addr.toIp()<<std::endl;
 //     std::cout<<addr.toPort()<<std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
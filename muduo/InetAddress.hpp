@@ -1,20 +1,40 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <string>
 #include <strings.h>
 #include <string.h>
 #include <iostream>
+
+// 监听/连接的地址：IPv4或者AF_UNIX流式socket
 class InetAddress
 {
 public:
     explicit InetAddress(uint16_t port=0, std::string ip = "127.0.0.1");
-    explicit InetAddress(const sockaddr_in &addr) : addr_(addr) {}
+    explicit InetAddress(const sockaddr_in &addr) { setSockAddr(addr); }
+    // AF_UNIX地址，path以'@'开头时使用抽象命名空间，不在文件系统里创建文件；path超过sun_path的长度时LOG_FATAL，不截断
+    static InetAddress fromUnixPath(const std::string &path);
+
+    sa_family_t family() const { return addr_.in.sin_family; }
+    bool isUnix() const { return family() == AF_UNIX; }
     std::string toIp() const;
-    std::string toIpPort() const;
+    std::string toIpPort() const;   // AF_UNIX地址返回"unix:路径"
     uint16_t toPort() const;
-    const sockaddr_in *getSockAddr() const { return &addr_; }
-	void setSockAddr(const sockaddr_in& addr){addr_=addr;}
+    std::string unixPath() const;   // 抽象命名空间的路径以'@'开头
+
+    // 只对IPv4地址有意义
+    const sockaddr_in *getSockAddr() const { return &addr_.in; }
+    void setSockAddr(const sockaddr_in& addr){addr_.in=addr;len_=sizeof(addr);}
+    // 通用的地址和长度，用于bind/connect/accept
+    const sockaddr *sockAddr() const { return reinterpret_cast<const sockaddr *>(&addr_); }
+    socklen_t sockAddrLen() const { return len_; }
+    void setSockAddr(const sockaddr *addr, socklen_t len);
 private:
-    sockaddr_in addr_;
-};
\ No newline at end of file
+    union
+    {
+        sockaddr_in in;
+        sockaddr_un un;
+    } addr_;
+    socklen_t len_;
+};
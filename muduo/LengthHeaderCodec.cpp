@@ -0,0 +1,102 @@
+#include "LengthHeaderCodec.hpp"
+#include "TcpConnection.hpp"
+#include "Logger.hpp"
+
+#include <string.h>
+#include <endian.h>
+
+//每个loop线程一份，复用容量，解析消息时不再分配内存
+static thread_local std::vector<LengthHeaderCodec::Frame> t_frames;
+
+LengthHeaderCodec::LengthHeaderCodec(const FramesCallback &cb, size_t headerLen, size_t maxFrameSize)
+	:framesCallback_(cb)
+	,headerLen_(headerLen)
+	,maxFrameSize_(maxFrameSize)
+{
+	if(headerLen_!=1&&headerLen_!=2&&headerLen_!=4&&headerLen_!=8){
+		LOG_FATAL("%s:%s:%d invalid header length %zu \n",__FILE__,__FUNCTION__,__LINE__,headerLen_);
+	}
+	if(headerLen_>Buffer::kCheapPrepend){
+		LOG_FATAL("%s:%s:%d header length %zu exceeds cheap prepend \n",__FILE__,__FUNCTION__,__LINE__,headerLen_);
+	}
+}
+
+uint64_t LengthHeaderCodec::parseHeader(const char* data)const{
+	switch(headerLen_){
+		case 1:
+			return static_cast<uint8_t>(*data);
+		case 2:{
+			uint16_t be16=0;
+			::memcpy(&be16,data,sizeof(be16));
+			return be16toh(be16);
+		}
+		case 4:{
+			uint32_t be32=0;
+			::memcpy(&be32,data,sizeof(be32));
+			return be32toh(be32);
+		}
+		default:{
+			uint64_t be64=0;
+			::memcpy(&be64,data,sizeof(be64));
+			return be64toh(be64);
+		}
+	}
+}
+
+void LengthHeaderCodec::fillHeader(Buffer* buf,size_t len)const{
+	switch(headerLen_){
+		case 1:
+			buf->prependInt8(static_cast<int8_t>(len));
+			break;
+		case 2:
+			buf->prependInt16(static_cast<int16_t>(len));
+			break;
+		case 4:
+			buf->prependInt32(static_cast<int32_t>(len));
+			break;
+		default:
+			buf->prependInt64(static_cast<int64_t>(len));
+			break;
+	}
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime){
+	std::vector<Frame>& frames=t_frames;
+	frames.clear();
+	const char* base=buf->peek();
+	const size_t readable=buf->readableBytes();
+	size_t offset=0;
+	while(readable-offset>=headerLen_){
+		const uint64_t len=parseHeader(base+offset);
+		if(len>maxFrameSize_){
+			LOG_ERROR("LengthHeaderCodec::onMessage [%s] invalid length %llu \n",
+				conn->name().c_str(),static_cast<unsigned long long>(len));
+			frames.clear();
+			buf->retrieveAll();
+			conn->shutdown();
+			return;
+		}
+		if(readable-offset-headerLen_<len){	//消息体还没有收全
+			break;
+		}
+		Frame frame={base+offset+headerLen_,static_cast<size_t>(len)};
+		frames.push_back(frame);
+		offset+=headerLen_+len;
+	}
+	if(!frames.empty()){
+		framesCallback_(conn,frames.data(),frames.size(),receiveTime);
+		frames.clear();
+		buf->retrieve(offset);
+	}
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn,const void* data,size_t len){
+	if(len>maxFrameSize_||(headerLen_<sizeof(uint64_t)&&len>>(headerLen_*8)!=0)){
+		LOG_ERROR("LengthHeaderCodec::send [%s] message too long %zu \n",conn->name().c_str(),len);
+		return;
+	}
+	Buffer buf(len);
+	buf.append(data,len);
+	fillHeader(&buf,len);
+	conn->send(&buf);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+#include "noncopyable.hpp"
+#include "Callbacks.hpp"
+#include "Buffer.hpp"
+#include "Timestamp.hpp"
+
+/*
+长度头编解码器：位于TcpConnection和用户代码之间
+消息格式为 [N字节网络序长度][消息体]，N可以是1/2/4/8
+onMessage从inputBuffer_里切出所有完整的消息，以指针+长度的形式一次性交给用户回调，不做任何拷贝
+*/
+class LengthHeaderCodec:noncopyable{
+public:
+	//指向inputBuffer_内部的消息视图，只在回调执行期间有效
+	struct Frame{
+		const char* data;
+		size_t len;
+	};
+	//一次读事件里解析出的所有完整消息，合并成一次回调
+	using FramesCallback=std::function<void(const TcpConnectionPtr&,const Frame* frames,size_t count,Timestamp)>;
+
+	static const size_t kDefaultMaxFrameSize=64*1024*1024;
+
+	explicit LengthHeaderCodec(const FramesCallback& cb
+				,size_t headerLen=sizeof(int32_t)
+				,size_t maxFrameSize=kDefaultMaxFrameSize);
+
+	size_t headerLen()const{return headerLen_;}
+	size_t maxFrameSize()const{return maxFrameSize_;}
+
+	//设置给TcpServer/TcpConnection的MessageCallback
+	void onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime);
+
+	//消息体写进Buffer后在预留空间里补上长度头
+	void send(const TcpConnectionPtr& conn,const void* data,size_t len);
+private:
+	//读取buf中data位置的长度头
+	uint64_t parseHeader(const char* data)const;
+	void fillHeader(Buffer* buf,size_t len)const;
+
+	FramesCallback framesCallback_;
+	const size_t headerLen_;
+	const size_t maxFrameSize_;
+};
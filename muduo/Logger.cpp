@@ -9,7 +9,7 @@ void Logger::setLogLevel(int level){
     logLevel_=level;
 }
 // 写日志 
-void Logger::log(std::string msg){
+void Logger::log(const char* msg){
     switch(logLevel_){
         case INFO:
             std::cout<<"[INFO]";
@@ -26,6 +26,8 @@ void Logger::log(std::string msg){
         default:
             break;
     }
-    //打印时间和msg
-    std::cout<<Timestamp::now().tostring()<<"  :  "<<msg<<std::endl;
+    //打印时间和msg，时间格式化在栈上，不分配内存
+    char timebuf[64];
+    Timestamp::now().format(timebuf,sizeof(timebuf));
+    std::cout<<timebuf<<"  :  "<<msg<<std::endl;
 }
\ No newline at end of file
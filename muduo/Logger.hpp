@@ -59,7 +59,7 @@ public:
     static Logger& instance();
     //
     void setLogLevel(int level);
-    void log(std::string msg);
+    void log(const char* msg);
 private:
     int logLevel_;
     Logger(){}
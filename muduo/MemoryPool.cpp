@@ -0,0 +1,85 @@
+#include "MemoryPool.hpp"
+
+#include <new>
+
+MemoryPool::MemoryPool(){
+	for(FreeList& list:freeLists_){
+		list.head=nullptr;
+		list.count=0;
+	}
+	buffers_.reserve(kMaxCachedBuffers);	//之后push_back不会再分配
+}
+
+MemoryPool::~MemoryPool(){
+	for(FreeList& list:freeLists_){
+		while(list.head){
+			FreeBlock* block=list.head;
+			list.head=block->next;
+			::operator delete(block);
+		}
+	}
+}
+
+void* MemoryPool::allocate(size_t bytes){
+	if(bytes>kMaxBlockSize){
+		return ::operator new(bytes);
+	}
+	size_t index=classIndex(bytes);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		FreeList& list=freeLists_[index];
+		if(list.head){
+			FreeBlock* block=list.head;
+			list.head=block->next;
+			--list.count;
+			return block;
+		}
+	}
+	//同一级的块按该级的最大尺寸分配，才能给这一级的任何申请复用
+	return ::operator new((index+1)*kAlign);
+}
+
+void MemoryPool::deallocate(void* p,size_t bytes){
+	if(p==nullptr){
+		return;
+	}
+	if(bytes>kMaxBlockSize){
+		::operator delete(p);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		FreeList& list=freeLists_[classIndex(bytes)];
+		if(list.count<kMaxCachedBlocks){
+			FreeBlock* block=static_cast<FreeBlock*>(p);
+			block->next=list.head;
+			list.head=block;
+			++list.count;
+			return;
+		}
+	}
+	::operator delete(p);
+}
+
+Buffer MemoryPool::takeBuffer(){
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(!buffers_.empty()){
+			Buffer buf(std::move(buffers_.back()));
+			buffers_.pop_back();
+			return buf;
+		}
+	}
+	return Buffer();
+}
+
+void MemoryPool::recycleBuffer(Buffer& buf){
+	if(buf.internalCapacity()==0||buf.internalCapacity()>kMaxRecycledBufferSize){
+		return;
+	}
+	buf.retrieveAll();
+	std::lock_guard<std::mutex> lock(mutex_);
+	if(buffers_.size()<kMaxCachedBuffers){
+		buffers_.push_back(std::move(buf));
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "noncopyable.hpp"
+#include "Buffer.hpp"
+
+/*
+每个EventLoop一个的内存池，回收连接相关的对象，稳定状态下建立/关闭连接不再调用malloc
+1. 不超过kMaxBlockSize的内存块按16字节分级，释放时挂到对应的空闲链表上，下次同样大小的申请直接复用
+   TcpConnection(连同shared_ptr控制块)、Poller和TcpServer里map的节点都从这里分配
+2. 缓存连接关闭时留下的Buffer，新连接直接拿来用
+连接在baseloop里创建、在subloop里销毁，所以用互斥锁保护
+*/
+class MemoryPool:noncopyable{
+public:
+	static const size_t kAlign=16;
+	static const size_t kMaxBlockSize=4096;
+	static const size_t kMaxCachedBlocks=1024;	//每一级最多缓存的空闲块
+	static const size_t kMaxCachedBuffers=256;
+	static const size_t kMaxRecycledBufferSize=64*1024;	//更大的Buffer直接释放，避免长期占用内存
+
+	MemoryPool();
+	~MemoryPool();
+
+	void* allocate(size_t bytes);
+	void deallocate(void* p,size_t bytes);
+
+	//取一个空的Buffer，没有缓存时新建
+	Buffer takeBuffer();
+	//回收buf的存储空间，只在buf的持有者析构时调用，之后buf不能再使用
+	void recycleBuffer(Buffer& buf);
+
+private:
+	struct FreeBlock{
+		FreeBlock* next;
+	};
+	struct FreeList{
+		FreeBlock* head;
+		size_t count;
+	};
+	static size_t classIndex(size_t bytes){return bytes==0?0:(bytes-1)/kAlign;}
+
+	std::mutex mutex_;
+	FreeList freeLists_[kMaxBlockSize/kAlign];
+	std::vector<Buffer> buffers_;
+};
+
+//从MemoryPool分配内存的STL分配器，配合std::allocate_shared和容器使用
+//分配器持有内存池的shared_ptr，保证内存池比从它分配的对象活得久
+template<typename T>
+class PoolAllocator{
+public:
+	using value_type=T;
+
+	explicit PoolAllocator(const std::shared_ptr<MemoryPool>& pool):pool_(pool){}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other):pool_(other.pool()){}
+
+	T* allocate(size_t n){return static_cast<T*>(pool_->allocate(n*sizeof(T)));}
+	void deallocate(T* p,size_t n){pool_->deallocate(p,n*sizeof(T));}
+
+	const std::shared_ptr<MemoryPool>& pool()const{return pool_;}
+
+private:
+	std::shared_ptr<MemoryPool> pool_;
+};
+
+template<typename T,typename U>
+bool operator==(const PoolAllocator<T>& lhs,const PoolAllocator<U>& rhs){return lhs.pool()==rhs.pool();}
+template<typename T,typename U>
+bool operator!=(const PoolAllocator<T>& lhs,const PoolAllocator<U>& rhs){return lhs.pool()!=rhs.pool();}
@@ -0,0 +1,186 @@
+#include "Multiplexer.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+#include "TcpConnection.hpp"
+
+#include <algorithm>
+#include <string.h>
+#include <endian.h>
+
+//已完成请求留在堆里的条目超过这个数，并且超过未完成请求数的两倍时整理一次
+static const size_t kCompactThreshold=1024;
+
+MultiplexerPtr Multiplexer::create(const TcpConnectionPtr& conn,size_t maxFrameSize){
+	return std::make_shared<Multiplexer>(conn,maxFrameSize);
+}
+
+Multiplexer::Multiplexer(const TcpConnectionPtr& conn,size_t maxFrameSize)
+	:loop_(conn->getLoop())
+	,conn_(conn)
+	,codec_([this](const TcpConnectionPtr& c,const LengthHeaderCodec::Frame* frames,size_t count,Timestamp){
+			onFrames(c,frames,count);
+		},sizeof(int32_t),maxFrameSize)
+	,nextId_(1)
+	,pending_(PoolAllocator<std::pair<const uint64_t,Pending>>(loop_->memoryPool()))
+{
+	if(!loop_->isInLoopThread()){
+		LOG_FATAL("%s:%s:%d multiplexer must be created in the connection loop \n",__FILE__,__FUNCTION__,__LINE__);
+	}
+}
+
+Multiplexer::~Multiplexer(){
+	if(timerExpiration_.valid()){
+		loop_->cancel(timer_);
+	}
+	if(!pending_.empty()){
+		LOG_ERROR("Multiplexer::dtor drop %zu pending requests \n",pending_.size());
+	}
+}
+
+void Multiplexer::call(const void* data,size_t len,double timeoutSeconds,ResponseCallback cb){
+	EventLoop* callerLoop=EventLoop::loopOfCurrentThread();
+	if(loop_->isInLoopThread()){
+		callInLoop(static_cast<const char*>(data),len,timeoutSeconds,cb,callerLoop);
+	}
+	else{
+		//C++11的lambda不能移动捕获，用bind把cb移动进去
+		loop_->queueInLoop(std::bind([timeoutSeconds,callerLoop](const MultiplexerPtr& self,const std::string& request,ResponseCallback& callback){
+			self->callInLoop(request.data(),request.size(),timeoutSeconds,callback,callerLoop);
+		},shared_from_this(),std::string(static_cast<const char*>(data),len),std::move(cb)));
+	}
+}
+
+void Multiplexer::callInLoop(const char* data,size_t len,double timeoutSeconds,ResponseCallback& cb,EventLoop* callerLoop){
+	if(!conn_||!conn_->connected()||len+sizeof(int64_t)>codec_.maxFrameSize()){
+		LOG_ERROR("Multiplexer::call rejected, request size %zu \n",len);
+		//不在call里重入用户回调
+		EventLoop* target=callerLoop?callerLoop:loop_;
+		target->queueInLoop(std::bind([](ResponseCallback& callback){ callback(kRejected,nullptr,0); },std::move(cb)));
+		return;
+	}
+	const uint64_t id=nextId_++;
+	char header[kHeaderLen];
+	uint32_t be32=htobe32(static_cast<uint32_t>(len+sizeof(int64_t)));
+	uint64_t be64=htobe64(id);
+	::memcpy(header,&be32,sizeof(be32));
+	::memcpy(header+sizeof(be32),&be64,sizeof(be64));
+	//帧头和消息体一起追加再提交，只有一次写
+	Buffer* out=conn_->outputTail();
+	out->append(header,kHeaderLen);
+	out->append(data,len);
+	conn_->commitOutput();
+
+	Pending pending={std::move(cb),callerLoop};
+	pending_.emplace(id,std::move(pending));
+
+	if(deadlines_.size()>kCompactThreshold&&deadlines_.size()>2*pending_.size()){
+		deadlines_.erase(std::remove_if(deadlines_.begin(),deadlines_.end(),[this](const Deadline& d){
+			return pending_.find(d.id)==pending_.end();
+		}),deadlines_.end());
+		std::make_heap(deadlines_.begin(),deadlines_.end());
+	}
+	Deadline deadline={addTime(Timestamp::now(),timeoutSeconds),id};
+	deadlines_.push_back(deadline);
+	std::push_heap(deadlines_.begin(),deadlines_.end());
+	armTimer();
+}
+
+void Multiplexer::onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime){
+	codec_.onMessage(conn,buf,receiveTime);
+}
+
+void Multiplexer::onFrames(const TcpConnectionPtr& conn,const LengthHeaderCodec::Frame* frames,size_t count){
+	for(size_t i=0;i<count;++i){
+		const LengthHeaderCodec::Frame& frame=frames[i];
+		if(frame.len<sizeof(int64_t)){
+			LOG_ERROR("Multiplexer::onFrames [%llu] frame too short %zu \n",static_cast<unsigned long long>(conn->id()),frame.len);
+			conn->shutdown();
+			return;
+		}
+		uint64_t be64=0;
+		::memcpy(&be64,frame.data,sizeof(be64));
+		PendingMap::iterator it=pending_.find(be64toh(be64));
+		if(it==pending_.end()){
+			LOG_DEBUG("Multiplexer::onFrames late or unknown response \n");
+			continue;
+		}
+		//先从表里摘掉，回调里可以再发请求
+		Pending pending(std::move(it->second));
+		pending_.erase(it);
+		complete(pending,kOk,frame.data+sizeof(int64_t),frame.len-sizeof(int64_t));
+	}
+}
+
+void Multiplexer::onDisconnected(){
+	//用swap而不是move，move以后pending_的分配器会变成空的
+	PendingMap pending(PoolAllocator<std::pair<const uint64_t,Pending>>(loop_->memoryPool()));
+	pending.swap(pending_);
+	deadlines_.clear();
+	if(timerExpiration_.valid()){
+		loop_->cancel(timer_);
+		timerExpiration_=Timestamp();
+	}
+	conn_.reset();	//连接的回调里通常持有MultiplexerPtr，这里打破循环引用
+	for(auto& entry:pending){
+		complete(entry.second,kDisconnected,nullptr,0);
+	}
+}
+
+void Multiplexer::complete(Pending& pending,Status status,const char* data,size_t len){
+	if(pending.callerLoop==nullptr||pending.callerLoop==loop_){
+		pending.cb(status,data,len);
+	}
+	else{
+		std::string response=data?std::string(data,len):std::string();
+		pending.callerLoop->queueInLoop(std::bind([status](ResponseCallback& callback,const std::string& response){
+			callback(status,response.data(),response.size());
+		},std::move(pending.cb),std::move(response)));
+	}
+}
+
+void Multiplexer::armTimer(){
+	if(deadlines_.empty()){
+		return;
+	}
+	const Timestamp earliest=deadlines_.front().when;
+	if(timerExpiration_.valid()){
+		if(!(earliest<timerExpiration_)){
+			return;
+		}
+		loop_->cancel(timer_);
+	}
+	std::weak_ptr<Multiplexer> weakSelf(shared_from_this());
+	timer_=loop_->runAt(earliest,[weakSelf](){
+		MultiplexerPtr self=weakSelf.lock();
+		if(self){
+			self->handleTimeout();
+		}
+	});
+	timerExpiration_=earliest;
+}
+
+void Multiplexer::handleTimeout(){
+	timerExpiration_=Timestamp();
+	const Timestamp now=Timestamp::now();
+	while(!deadlines_.empty()&&!(now<deadlines_.front().when)){
+		const uint64_t id=deadlines_.front().id;
+		std::pop_heap(deadlines_.begin(),deadlines_.end());
+		deadlines_.pop_back();
+		PendingMap::iterator it=pending_.find(id);
+		if(it!=pending_.end()){
+			Pending pending(std::move(it->second));
+			pending_.erase(it);
+			complete(pending,kTimeout,nullptr,0);
+		}
+	}
+	armTimer();
+}
+
+void Multiplexer::respond(const TcpConnectionPtr& conn,uint64_t id,const void* data,size_t len){
+	//拼成一个Buffer发送，跨线程调用时也不会和其它响应交错
+	Buffer buf(sizeof(int64_t)+len);
+	buf.appendInt64(static_cast<int64_t>(id));
+	buf.append(data,len);
+	buf.prependInt32(static_cast<int32_t>(sizeof(int64_t)+len));
+	conn->send(&buf);
+}
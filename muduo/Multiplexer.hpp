@@ -0,0 +1,95 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+#include "Callbacks.hpp"
+#include "Timestamp.hpp"
+#include "TimerId.hpp"
+#include "MemoryPool.hpp"
+#include "LengthHeaderCodec.hpp"
+
+class EventLoop;
+class Multiplexer;
+using MultiplexerPtr=std::shared_ptr<Multiplexer>;
+
+/*
+多路复用的请求/响应客户端：一条TcpConnection上同时有大量未完成的请求
+帧格式 [4字节网络序长度][8字节网络序请求id][消息体]，长度包含请求id，服务端可以用LengthHeaderCodec解析
+- 请求在连接的loop里按顺序写出，帧头和消息体一起提交；连接开启了autoCork时同一轮里的请求合并成一次写
+  Multiplexer不修改连接的设置，需要合并时由调用方在create之前调用conn->setAutoCork(true)
+- 响应可以乱序返回，按请求id匹配；超时以后才到的响应直接丢弃
+- 所有截止时间共用一个定时器，定时器总是对准最早的截止时间
+- 回调在调用call的线程所属的loop里执行，调用线程没有loop时在连接的loop里执行
+用法：连接建立以后用create绑定，把连接的MessageCallback交给onMessage，连接断开时调用onDisconnected
+*/
+class Multiplexer:noncopyable,public std::enable_shared_from_this<Multiplexer>{
+public:
+	enum Status{
+		kOk,
+		kTimeout,
+		kDisconnected,
+		kRejected,	//没有发出：连接已经断开或者消息过长
+	};
+	//data只在回调期间有效，status不是kOk时为空；回调只会被移动，可以捕获只能移动的对象
+	using ResponseCallback=MoveOnlyCallable<void(Status status,const char* data,size_t len)>;
+
+	static const size_t kHeaderLen=sizeof(int32_t)+sizeof(int64_t);
+
+	//需要在连接的loop线程里调用
+	static MultiplexerPtr create(const TcpConnectionPtr& conn,size_t maxFrameSize=LengthHeaderCodec::kDefaultMaxFrameSize);
+	~Multiplexer();
+
+	//发出一个请求，timeoutSeconds以后还没有响应就以kTimeout完成，线程安全
+	void call(const void* data,size_t len,double timeoutSeconds,ResponseCallback cb);
+	void call(const std::string& request,double timeoutSeconds,ResponseCallback cb){
+		call(request.data(),request.size(),timeoutSeconds,std::move(cb));
+	}
+
+	//设置给连接的MessageCallback
+	void onMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime);
+	//连接断开，所有未完成的请求以kDisconnected完成
+	void onDisconnected();
+
+	//服务端使用：按请求id回复一条响应
+	static void respond(const TcpConnectionPtr& conn,uint64_t id,const void* data,size_t len);
+
+	//未完成的请求数，只能在连接的loop线程里调用
+	size_t pending()const{return pending_.size();}
+	const TcpConnectionPtr& connection()const{return conn_;}
+
+	//create使用，外部不要直接构造
+	Multiplexer(const TcpConnectionPtr& conn,size_t maxFrameSize);
+
+private:
+	struct Pending{
+		ResponseCallback cb;
+		EventLoop* callerLoop;
+	};
+	struct Deadline{
+		Timestamp when;
+		uint64_t id;
+		//std::push_heap默认是大根堆，反过来比较得到最早的截止时间在堆顶
+		bool operator<(const Deadline& rhs)const{return rhs.when<when;}
+	};
+	using PendingMap=std::unordered_map<uint64_t,Pending,std::hash<uint64_t>,std::equal_to<uint64_t>,
+		PoolAllocator<std::pair<const uint64_t,Pending>>>;
+
+	void callInLoop(const char* data,size_t len,double timeoutSeconds,ResponseCallback& cb,EventLoop* callerLoop);
+	void onFrames(const TcpConnectionPtr& conn,const LengthHeaderCodec::Frame* frames,size_t count);
+	void complete(Pending& pending,Status status,const char* data,size_t len);
+	void armTimer();
+	void handleTimeout();
+
+	EventLoop* loop_;
+	TcpConnectionPtr conn_;
+	LengthHeaderCodec codec_;
+	uint64_t nextId_;
+	PendingMap pending_;
+	std::vector<Deadline> deadlines_;	//小根堆，已经完成的请求留在堆里，到期时跳过
+	TimerId timer_;
+	Timestamp timerExpiration_;	//无效表示没有定时器
+};
@@ -0,0 +1,40 @@
+#include "OutputGuard.hpp"
+
+OutputGuard::OutputGuard()
+	:budget_(0)
+	,used_(0)
+	,evicting_(false)
+{
+	for(int i=0;i<kNumReasons;++i){
+		evictions_[i]=0;
+	}
+}
+
+void OutputGuard::adjust(size_t oldBytes,size_t newBytes){
+	size_t used=0;
+	if(newBytes>=oldBytes){
+		used=used_.fetch_add(newBytes-oldBytes,std::memory_order_relaxed)+(newBytes-oldBytes);
+	}
+	else{
+		used=used_.fetch_sub(oldBytes-newBytes,std::memory_order_relaxed)-(oldBytes-newBytes);
+	}
+	const size_t budget=budget_;
+	if(budget>0&&used>budget&&newBytes>oldBytes&&!evicting_.exchange(true)){
+		OverBudgetCallback cb;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cb=overBudgetCallback_;
+		}
+		if(cb){
+			cb();
+		}
+		else{
+			evicting_=false;
+		}
+	}
+}
+
+void OutputGuard::setOverBudgetCallback(const OverBudgetCallback& cb){
+	std::unique_lock<std::mutex> lock(mutex_);
+	overBudgetCallback_=cb;
+}
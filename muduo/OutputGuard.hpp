@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+
+/*
+慢消费者保护：TcpServer和它的所有连接共享一个OutputGuard
+记录所有连接待发送数据的总字节数，超过预算时通知TcpServer驱逐积压最多的连接，并统计各种原因的驱逐次数
+*/
+class OutputGuard:noncopyable{
+public:
+	enum Reason{
+		kMaxOutputBytes,	//单个连接待发送数据超过上限
+		kWriteTimeout,	//长时间没有写出任何数据
+		kOverBudget,	//所有连接的总预算超限
+		kNumReasons
+	};
+	using OverBudgetCallback=std::function<void()>;
+
+	OutputGuard();
+
+	//0表示不限制
+	void setBudget(size_t bytes){budget_=bytes;}
+	size_t budget()const{return budget_;}
+	size_t used()const{return used_.load(std::memory_order_relaxed);}
+
+	//连接待发送数据从oldBytes变为newBytes，超过预算时通知驱逐
+	void adjust(size_t oldBytes,size_t newBytes);
+
+	void setOverBudgetCallback(const OverBudgetCallback& cb);
+	//驱逐结束以后调用，允许再次通知
+	void evictionDone(){evicting_=false;}
+
+	void recordEviction(Reason reason){evictions_[reason].fetch_add(1,std::memory_order_relaxed);}
+	uint64_t evictions(Reason reason)const{return evictions_[reason].load(std::memory_order_relaxed);}
+private:
+	std::atomic<size_t> budget_;
+	std::atomic<size_t> used_;
+	std::atomic_bool evicting_;	//已经通知了驱逐还没有完成
+	std::atomic<uint64_t> evictions_[kNumReasons];
+
+	std::mutex mutex_;	//保护overBudgetCallback_，TcpServer析构时会清空它
+	OverBudgetCallback overBudgetCallback_;
+};
@@ -1,7 +1,12 @@
 #include "Poller.hpp"
 #include "Channel.hpp"
+#include "EventLoop.hpp"
 
-Poller::Poller(EventLoop* loop):ownerLoop_(loop){}
+Poller::Poller(EventLoop* loop)
+    :channels_(0,std::hash<int>(),std::equal_to<int>(),PoolAllocator<std::pair<const int,Channel*>>(loop->memoryPool()))
+    ,ownerLoop_(loop){}
+
+Poller::~Poller(){}
 
 bool Poller::hasChannel(Channel* channel) const{
     auto it=channels_.find(channel->fd());
@@ -1,6 +1,7 @@
 #pragma once
 #include "noncopyable.hpp"
 #include "Timestamp.hpp"
+#include "MemoryPool.hpp"
 
 #include <vector>
 #include <unordered_map>
@@ -27,7 +28,9 @@ public:
     static Poller* newDefaultPoller(EventLoop* loop);
 protected:
     
-    using ChannelMap=std::unordered_map<int,Channel*>;
+    //节点从所属loop的内存池分配
+    using ChannelMap=std::unordered_map<int,Channel*,std::hash<int>,std::equal_to<int>,
+        PoolAllocator<std::pair<const int,Channel*>>>;
     ChannelMap channels_;
 private:
     EventLoop* ownerLoop_;
@@ -0,0 +1,63 @@
+#include "ShmClient.hpp"
+#include "Logger.hpp"
+#include "TcpConnection.hpp"
+
+#include <unistd.h>
+
+ShmClient::ShmClient(EventLoop* loop,const InetAddress& serverAddr,const std::string& nameArg)
+	:client_(loop,serverAddr,nameArg)
+	,busyPollMicros_(0)
+	,connectionCallback_([](const ShmConnectionPtr&){})
+	,messageCallback_([](const ShmConnectionPtr&,Buffer* buf,Timestamp){ buf->retrieveAll(); })
+{
+	client_.setConnectionCallback([this](const TcpConnectionPtr& conn){ onControlConnection(conn); });
+	client_.setMessageCallback([this](const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime){
+		onControlMessage(conn,buf,receiveTime);
+	});
+}
+
+void ShmClient::onControlConnection(const TcpConnectionPtr& conn){
+	if(conn->connected()){
+		conn->setReceiveFds(true);
+		return;
+	}
+	ShmConnectionPtr* shm=conn->getContext<ShmConnectionPtr>();
+	if(shm){
+		(*shm)->connectDestroyed();
+		conn->clearContext();
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	connection_.reset();
+}
+
+//握手只有一条消息：memfd和服务端的门铃fd
+void ShmClient::onControlMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp){
+	buf->retrieveAll();
+	std::vector<int> fds=conn->takeReceivedFds();
+	if(fds.size()!=2||conn->getContext<ShmConnectionPtr>()!=nullptr){
+		for(int fd:fds){
+			::close(fd);
+		}
+		LOG_ERROR("ShmClient::onControlMessage [%s] unexpected control message \n",conn->name().c_str());
+		return;
+	}
+	ShmConnectionPtr shm=std::make_shared<ShmConnection>(conn->getLoop(),conn->name(),fds[0],false,conn);
+	::close(fds[0]);
+	if(!shm->valid()){
+		::close(fds[1]);
+		conn->forceClose();
+		return;
+	}
+	shm->setPeerDoorbell(fds[1]);
+	shm->setConnectionCallback(connectionCallback_);
+	shm->setMessageCallback(messageCallback_);
+	shm->setBusyPoll(busyPollMicros_);
+	int doorbell=shm->doorbellFd();
+	conn->sendFds(&doorbell,1,"C",1);
+	conn->setContext<ShmConnectionPtr>(shm);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		connection_=shm;
+	}
+	shm->connectEstablished();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <mutex>
+
+#include "noncopyable.hpp"
+#include "TcpClient.hpp"
+#include "ShmConnection.hpp"
+
+/*
+共享内存传输的客户端：通过AF_UNIX控制连接从ShmServer拿到memfd和门铃fd，回送自己的门铃fd以后连接建立
+*/
+class ShmClient:noncopyable{
+public:
+	ShmClient(EventLoop* loop,const InetAddress& serverAddr,const std::string& nameArg);
+
+	void connect(){client_.connect();}
+	void disconnect(){client_.disconnect();}
+	void stop(){client_.stop();}
+	void enableRetry(){client_.enableRetry();}
+
+	ShmConnectionPtr connection()const{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return connection_;
+	}
+
+	//非线程安全，需要在connect之前设置
+	void setConnectionCallback(const ShmConnectionCallback& cb){connectionCallback_=cb;}
+	void setMessageCallback(const ShmMessageCallback& cb){messageCallback_=cb;}
+	void setBusyPoll(int micros){busyPollMicros_=micros;}
+
+private:
+	void onControlConnection(const TcpConnectionPtr& conn);
+	void onControlMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime);
+
+	TcpClient client_;
+	int busyPollMicros_;
+	ShmConnectionCallback connectionCallback_;
+	ShmMessageCallback messageCallback_;
+	mutable std::mutex mutex_;
+	ShmConnectionPtr connection_;	//由mutex_保护
+};
@@ -0,0 +1,307 @@
+#include "ShmConnection.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+#include "TcpConnection.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+namespace{
+//段头之后是两个环的控制块，数据区从页边界开始：[服务端->客户端][客户端->服务端]
+struct SegmentHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t ringSize;
+};
+const uint32_t kShmMagic=0x4d53484d;
+const uint32_t kShmVersion=1;
+const size_t kControlOffset=64;
+const size_t kDataOffset=4096;
+static_assert(kControlOffset+2*sizeof(ShmRingControl)<=kDataOffset,"ring controls overflow the first page");
+
+//一次门铃最多处理这么多轮，对端一直在写时也要把loop让给其它channel
+const int kMaxDrainRounds=16;
+
+size_t roundUpPowerOfTwo(size_t n){
+	size_t size=4096;
+	while(size<n){
+		size<<=1;
+	}
+	return size;
+}
+
+int createEventfd(){
+	int fd=::eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+	if(fd<0){
+		LOG_FATAL("%s:%s:%d eventfd error:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);
+	}
+	return fd;
+}
+}
+
+size_t ShmConnection::segmentSize(size_t ringSize){
+	return kDataOffset+2*roundUpPowerOfTwo(ringSize);
+}
+
+void ShmConnection::initSegment(void* base,size_t ringSize){
+	SegmentHeader* header=static_cast<SegmentHeader*>(base);
+	header->magic=kShmMagic;
+	header->version=kShmVersion;
+	header->ringSize=roundUpPowerOfTwo(ringSize);
+	ShmRingControl* controls=reinterpret_cast<ShmRingControl*>(static_cast<char*>(base)+kControlOffset);
+	controls[0].init();
+	controls[1].init();
+}
+
+bool ShmConnection::sealSegment(int memfd){
+	return ::fcntl(memfd,F_ADD_SEALS,F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL)==0;
+}
+
+ShmConnection::ShmConnection(EventLoop* loop,const std::string& nameArg,int memfd,bool isServer,const TcpConnectionPtr& control)
+	:loop_(loop)
+	,name_(nameArg)
+	,state_(kConnecting)
+	,base_(nullptr)
+	,mappedSize_(0)
+	,doorbellFd_(createEventfd())
+	,channel_(loop,doorbellFd_)
+	,peerDoorbellFd_(-1)
+	,control_(control)
+	,busyPollMicros_(0)
+	,messageCallback_([](const ShmConnectionPtr&,Buffer* buf,Timestamp){ buf->retrieveAll(); })
+{
+	channel_.setReadCallback([this](Timestamp receiveTime){ handleDoorbell(receiveTime); });
+
+	const int seals=::fcntl(memfd,F_GET_SEALS);
+	if(seals<0||(seals&(F_SEAL_SHRINK|F_SEAL_GROW))!=(F_SEAL_SHRINK|F_SEAL_GROW)){
+		LOG_ERROR("ShmConnection::ctor [%s] memfd %d is not sealed \n",name_.c_str(),memfd);
+		return;
+	}
+	struct stat st;
+	if(::fstat(memfd,&st)<0||static_cast<size_t>(st.st_size)<kDataOffset){
+		LOG_ERROR("ShmConnection::ctor [%s] bad memfd %d \n",name_.c_str(),memfd);
+		return;
+	}
+	void* base=::mmap(nullptr,st.st_size,PROT_READ|PROT_WRITE,MAP_SHARED,memfd,0);
+	if(base==MAP_FAILED){
+		LOG_ERROR("ShmConnection::ctor [%s] mmap error:%d \n",name_.c_str(),errno);
+		return;
+	}
+	const SegmentHeader* header=static_cast<const SegmentHeader*>(base);
+	const size_t ringSize=header->ringSize;
+	if(header->magic!=kShmMagic||header->version!=kShmVersion
+		||roundUpPowerOfTwo(ringSize)!=ringSize||segmentSize(ringSize)!=static_cast<size_t>(st.st_size)){
+		LOG_ERROR("ShmConnection::ctor [%s] bad segment header \n",name_.c_str());
+		::munmap(base,st.st_size);
+		return;
+	}
+	base_=base;
+	mappedSize_=st.st_size;
+	ShmRingControl* controls=reinterpret_cast<ShmRingControl*>(static_cast<char*>(base)+kControlOffset);
+	char* data=static_cast<char*>(base)+kDataOffset;
+	ShmRing serverToClient(&controls[0],data,ringSize);
+	ShmRing clientToServer(&controls[1],data+ringSize,ringSize);
+	tx_=isServer?serverToClient:clientToServer;
+	rx_=isServer?clientToServer:serverToClient;
+}
+
+ShmConnection::~ShmConnection(){
+	if(base_){
+		::munmap(base_,mappedSize_);
+	}
+	::close(doorbellFd_);
+	if(peerDoorbellFd_>=0){
+		::close(peerDoorbellFd_);
+	}
+}
+
+void ShmConnection::setPeerDoorbell(int fd){
+	if(peerDoorbellFd_>=0){
+		::close(peerDoorbellFd_);
+	}
+	peerDoorbellFd_=fd;
+}
+
+void ShmConnection::send(const void* data,size_t len){
+	if(state_!=kConnected){
+		return;
+	}
+	if(loop_->isInLoopThread()){
+		sendInLoop(static_cast<const char*>(data),len);
+	}
+	else{
+		std::string copy(static_cast<const char*>(data),len);
+		ShmConnectionPtr self(shared_from_this());
+		loop_->runInLoop([self,copy](){ self->sendInLoop(copy.data(),copy.size()); });
+	}
+}
+
+void ShmConnection::send(Buffer* buf){
+	if(state_!=kConnected){
+		return;
+	}
+	if(loop_->isInLoopThread()){
+		sendInLoop(buf->peek(),buf->readableBytes());
+		buf->retrieveAll();
+	}
+	else{
+		std::string copy(buf->retrieveAllAsString());
+		ShmConnectionPtr self(shared_from_this());
+		loop_->runInLoop([self,copy](){ self->sendInLoop(copy.data(),copy.size()); });
+	}
+}
+
+void ShmConnection::sendInLoop(const char* data,size_t len){
+	if(state_!=kConnected){
+		LOG_ERROR("ShmConnection [%s] disconnected, give up writing \n",name_.c_str());
+		return;
+	}
+	size_t written=0;
+	//前面还有积压的数据时不能插队
+	if(outputBuffer_.readableBytes()==0){
+		written=tx_.write(data,len);
+		if(written==ShmRing::kCorrupted){
+			protocolError("tx");
+			return;
+		}
+		if(written>0){
+			notifyData();
+		}
+	}
+	if(written<len){
+		outputBuffer_.append(data+written,len-written);
+		//先宣布在等空间再重试，对端在这之间腾出的空间不会错过
+		tx_.control()->producerWaiting.store(1,std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		flushOutput();
+	}
+}
+
+void ShmConnection::flushOutput(){
+	while(outputBuffer_.readableBytes()>0){
+		size_t n=tx_.write(outputBuffer_.peek(),outputBuffer_.readableBytes());
+		if(n==ShmRing::kCorrupted){
+			protocolError("tx");
+			return;
+		}
+		if(n==0){	//环还是满的，producerWaiting保持为1，等对端的门铃
+			return;
+		}
+		outputBuffer_.retrieve(n);
+		notifyData();
+	}
+	tx_.control()->producerWaiting.store(0,std::memory_order_relaxed);
+}
+
+void ShmConnection::ringPeer(){
+	if(peerDoorbellFd_>=0){
+		uint64_t one=1;
+		ssize_t n=::write(peerDoorbellFd_,&one,sizeof(one));
+		if(n!=sizeof(one)){
+			LOG_ERROR("ShmConnection::ringPeer [%s] writes %zd bytes instead of 8 \n",name_.c_str(),n);
+		}
+	}
+}
+
+//head的写入和读取对端标志之间要有全屏障，和对端“先置标志再检查环”配对，不会两边都错过
+void ShmConnection::notifyData(){
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::atomic<uint32_t>& waiting=tx_.control()->consumerWaiting;
+	if(waiting.load(std::memory_order_relaxed)&&waiting.exchange(0)){
+		ringPeer();
+	}
+}
+
+void ShmConnection::notifySpace(){
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::atomic<uint32_t>& waiting=rx_.control()->producerWaiting;
+	if(waiting.load(std::memory_order_relaxed)&&waiting.exchange(0)){
+		ringPeer();
+	}
+}
+
+void ShmConnection::handleDoorbell(Timestamp receiveTime){
+	uint64_t count=0;
+	ssize_t n=::read(doorbellFd_,&count,sizeof(count));
+	if(n!=sizeof(count)&&errno!=EAGAIN){
+		LOG_ERROR("ShmConnection::handleDoorbell [%s] reads %zd bytes instead of 8 \n",name_.c_str(),n);
+	}
+	drain(receiveTime);
+	if(outputBuffer_.readableBytes()>0){
+		flushOutput();
+	}
+}
+
+void ShmConnection::drain(Timestamp receiveTime){
+	std::atomic<uint32_t>& waiting=rx_.control()->consumerWaiting;
+	for(int round=0;state_==kConnected;++round){
+		if(round==kMaxDrainRounds){
+			//对端一直在写，给自己敲一次门铃，下一轮事件循环接着读
+			waiting.store(0,std::memory_order_relaxed);
+			uint64_t one=1;
+			::write(doorbellFd_,&one,sizeof(one));
+			return;
+		}
+		waiting.store(0,std::memory_order_relaxed);	//处理期间对端不用敲门铃
+		const size_t n=rx_.readInto(&inputBuffer_);
+		if(n==ShmRing::kCorrupted){
+			protocolError("rx");
+			return;
+		}
+		if(n>0){
+			notifySpace();
+			messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+			continue;
+		}
+		if(busyPollMicros_>0){
+			const Timestamp deadline=addTime(Timestamp::now(),busyPollMicros_/1000000.0);
+			while(rx_.empty()&&Timestamp::now()<deadline){
+			}
+			if(!rx_.empty()){
+				continue;
+			}
+		}
+		//宣布要睡眠以后再检查一次环，对端在这之间写入的数据不会错过
+		waiting.store(1,std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(rx_.empty()){
+			return;
+		}
+	}
+}
+
+void ShmConnection::protocolError(const char* what){
+	LOG_ERROR("ShmConnection [%s] corrupted %s ring, head/tail out of range \n",name_.c_str(),what);
+	outputBuffer_.retrieveAll();
+	forceClose();
+}
+
+void ShmConnection::forceClose(){
+	TcpConnectionPtr control=control_.lock();
+	if(control){
+		control->forceClose();
+	}
+}
+
+void ShmConnection::connectEstablished(){
+	state_=kConnected;
+	channel_.tie(shared_from_this());
+	channel_.enableReading();
+	connectionCallback_(shared_from_this());
+	//对端可能在本端建立之前就已经写入了数据
+	drain(Timestamp::now());
+}
+
+void ShmConnection::connectDestroyed(){
+	if(state_==kConnected){
+		state_=kDisconnected;
+		channel_.disableAll();
+		channel_.remove();
+		connectionCallback_(shared_from_this());
+	}
+	state_=kDisconnected;
+}
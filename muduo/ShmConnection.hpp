@@ -0,0 +1,97 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <atomic>
+
+#include "noncopyable.hpp"
+#include "Callable.hpp"
+#include "Callbacks.hpp"
+#include "Buffer.hpp"
+#include "Timestamp.hpp"
+#include "Channel.hpp"
+#include "ShmRing.hpp"
+
+class EventLoop;
+class ShmConnection;
+
+using ShmConnectionPtr=std::shared_ptr<ShmConnection>;
+using ShmConnectionCallback=Callable<void(const ShmConnectionPtr&)>;
+using ShmMessageCallback=Callable<void(const ShmConnectionPtr&,Buffer*,Timestamp)>;
+
+/*
+同机进程之间通过共享内存交换数据的连接，读写接口和TcpConnection一致
+- memfd里放两个单生产者单消费者的环形缓冲区，每个方向一个
+- 每端有一个注册在EventLoop上的eventfd作为门铃，对端写入数据或者腾出空间以后按需敲门铃
+- 消费者正在处理(没有宣布要睡眠)时生产者不敲门铃，开启busy poll以后消费者在睡眠前先自旋等待一会儿
+- 握手和fd交换走一条AF_UNIX连接(控制连接)，控制连接断开即共享内存连接断开，见ShmServer/ShmClient
+*/
+class ShmConnection:noncopyable,public std::enable_shared_from_this<ShmConnection>{
+public:
+	static const size_t kDefaultRingSize=1024*1024;
+
+	//共享内存段的大小，ringSize向上取整到2的幂
+	static size_t segmentSize(size_t ringSize);
+	//服务端创建memfd以后初始化段头和两个环的控制块
+	static void initSegment(void* base,size_t ringSize);
+	//初始化以后、发给对端以前封住memfd的大小，对端ftruncate缩小以后访问映射会SIGBUS
+	static bool sealSegment(int memfd);
+
+	//映射memfd，memfd仍由调用方关闭；大小没有被封住的memfd不映射，valid()为false；isServer决定使用哪个方向的环，control是握手用的控制连接
+	ShmConnection(EventLoop* loop,const std::string& name,int memfd,bool isServer,const TcpConnectionPtr& control);
+	~ShmConnection();
+
+	EventLoop* getLoop()const{return loop_;}
+	const std::string& name()const{return name_;}
+	bool connected()const{return state_==kConnected;}
+	//映射失败或者段头不对时为false，这样的连接不能使用
+	bool valid()const{return base_!=nullptr;}
+
+	//跨线程调用时拷贝一次数据，在loop线程里直接写进环
+	void send(const void* data,size_t len);
+	void send(const std::string& buf){send(buf.data(),buf.size());}
+	void send(Buffer* buf);	//发送buf里所有可读数据，调用后buf被清空
+	void forceClose();	//关闭控制连接，两端都会收到断开
+
+	void setConnectionCallback(const ShmConnectionCallback& cb){connectionCallback_=cb;}
+	void setMessageCallback(const ShmMessageCallback& cb){messageCallback_=cb;}
+	//收完数据以后最多自旋micros微秒等待新数据再去睡眠，期间对端不需要敲门铃；会占用loop线程，默认0
+	void setBusyPoll(int micros){busyPollMicros_=micros;}
+
+	//握手用：自己的门铃fd发给对端，对端的门铃fd由setPeerDoorbell接管
+	int doorbellFd()const{return doorbellFd_;}
+	void setPeerDoorbell(int fd);
+
+	//在loop线程里调用
+	void connectEstablished();
+	void connectDestroyed();
+
+private:
+	enum StateE{kConnecting,kConnected,kDisconnected};
+
+	void sendInLoop(const char* data,size_t len);
+	void handleDoorbell(Timestamp receiveTime);
+	void drain(Timestamp receiveTime);	//读走对端写入的数据
+	void flushOutput();	//把积压在outputBuffer_里的数据写进环
+	void ringPeer();
+	void notifyData();	//写入数据以后，对端准备睡眠时敲门铃
+	void notifySpace();	//读走数据以后，对端在等空间时敲门铃
+	void protocolError(const char* what);	//环的控制块被对端写坏，关闭控制连接
+
+	EventLoop* loop_;
+	const std::string name_;
+	std::atomic_int state_;
+	void* base_;
+	size_t mappedSize_;
+	ShmRing tx_;	//本端生产
+	ShmRing rx_;	//本端消费
+	int doorbellFd_;
+	Channel channel_;
+	int peerDoorbellFd_;
+	std::weak_ptr<TcpConnection> control_;
+	int busyPollMicros_;
+
+	Buffer inputBuffer_;
+	Buffer outputBuffer_;	//环写满时暂存，等对端腾出空间
+	ShmConnectionCallback connectionCallback_;
+	ShmMessageCallback messageCallback_;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Buffer.hpp"
+
+//跨进程共享的原子变量必须是无锁的
+static_assert(ATOMIC_LLONG_LOCK_FREE==2,"shared memory ring needs lock-free 64-bit atomics");
+
+/*
+放在共享内存里的单生产者单消费者环形字节缓冲区的控制块
+head只由生产者写，tail只由消费者写，各占一个cache line避免伪共享
+*/
+struct ShmRingControl{
+	alignas(64) std::atomic<uint64_t> head;	//已经写入的总字节数
+	alignas(64) std::atomic<uint64_t> tail;	//已经读走的总字节数
+	alignas(64) std::atomic<uint32_t> consumerWaiting;	//消费者准备睡眠，生产者写入以后要敲门铃
+	std::atomic<uint32_t> producerWaiting;	//生产者在等空间，消费者读走数据以后要敲门铃
+
+	void init(){
+		head.store(0,std::memory_order_relaxed);
+		tail.store(0,std::memory_order_relaxed);
+		consumerWaiting.store(0,std::memory_order_relaxed);
+		producerWaiting.store(0,std::memory_order_relaxed);
+	}
+};
+
+//不拥有内存，只是控制块和数据区的视图；capacity必须是2的幂
+//head和tail在对端可以写的内存里，不能信任：head-tail超过capacity说明对端出错或者恶意，返回kCorrupted
+class ShmRing{
+public:
+	static const size_t kCorrupted=static_cast<size_t>(-1);
+
+	ShmRing():control_(nullptr),data_(nullptr),capacity_(0){}
+	ShmRing(ShmRingControl* control,char* data,size_t capacity)
+		:control_(control),data_(data),capacity_(capacity){}
+
+	ShmRingControl* control()const{return control_;}
+	size_t capacity()const{return capacity_;}
+
+	//生产者：尽量写入len字节，返回实际写入的字节数
+	size_t write(const char* data,size_t len){
+		const uint64_t head=control_->head.load(std::memory_order_relaxed);
+		const uint64_t tail=control_->tail.load(std::memory_order_acquire);
+		if(head-tail>capacity_){
+			return kCorrupted;
+		}
+		const size_t n=std::min(len,static_cast<size_t>(capacity_-(head-tail)));
+		if(n>0){
+			copyIn(head,data,n);
+			control_->head.store(head+n,std::memory_order_release);
+		}
+		return n;
+	}
+
+	//消费者：把所有可读数据追加到buf，返回读到的字节数
+	size_t readInto(Buffer* buf){
+		const uint64_t tail=control_->tail.load(std::memory_order_relaxed);
+		const uint64_t head=control_->head.load(std::memory_order_acquire);
+		if(head-tail>capacity_){
+			return kCorrupted;
+		}
+		const size_t n=static_cast<size_t>(head-tail);
+		if(n>0){
+			buf->ensureWritableBytes(n);
+			copyOut(tail,buf->beginWrite(),n);
+			buf->hasWritten(n);
+			control_->tail.store(tail+n,std::memory_order_release);
+		}
+		return n;
+	}
+
+	bool empty()const{
+		return control_->head.load(std::memory_order_acquire)==control_->tail.load(std::memory_order_relaxed);
+	}
+
+private:
+	//按位置取模以后可能绕回数据区开头，最多拷贝两段
+	void copyIn(uint64_t pos,const char* src,size_t len){
+		const size_t offset=static_cast<size_t>(pos&(capacity_-1));
+		const size_t first=std::min(len,capacity_-offset);
+		::memcpy(data_+offset,src,first);
+		::memcpy(data_,src+first,len-first);
+	}
+	void copyOut(uint64_t pos,char* dst,size_t len)const{
+		const size_t offset=static_cast<size_t>(pos&(capacity_-1));
+		const size_t first=std::min(len,capacity_-offset);
+		::memcpy(dst,data_+offset,first);
+		::memcpy(dst+first,data_,len-first);
+	}
+
+	ShmRingControl* control_;
+	char* data_;
+	size_t capacity_;
+};
@@ -0,0 +1,76 @@
+#include "ShmServer.hpp"
+#include "Logger.hpp"
+#include "TcpConnection.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+ShmServer::ShmServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& nameArg,size_t ringSize)
+	:server_(loop,listenAddr,nameArg)
+	,ringSize_(ringSize)
+	,busyPollMicros_(0)
+	,connectionCallback_([](const ShmConnectionPtr&){})
+	,messageCallback_([](const ShmConnectionPtr&,Buffer* buf,Timestamp){ buf->retrieveAll(); })
+{
+	server_.setConnectionCallback([this](const TcpConnectionPtr& conn){ onControlConnection(conn); });
+	server_.setMessageCallback([this](const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime){
+		onControlMessage(conn,buf,receiveTime);
+	});
+}
+
+void ShmServer::onControlConnection(const TcpConnectionPtr& conn){
+	if(!conn->connected()){
+		ShmConnectionPtr* shm=conn->getContext<ShmConnectionPtr>();
+		if(shm){
+			(*shm)->connectDestroyed();
+			conn->clearContext();
+		}
+		return;
+	}
+	conn->setReceiveFds(true);
+	const size_t size=ShmConnection::segmentSize(ringSize_);
+	int memfd=::memfd_create(conn->name().c_str(),MFD_CLOEXEC|MFD_ALLOW_SEALING);
+	if(memfd<0||::ftruncate(memfd,size)<0||!ShmConnection::sealSegment(memfd)){
+		LOG_ERROR("ShmServer::onControlConnection [%s] memfd error:%d \n",conn->name().c_str(),errno);
+		if(memfd>=0){
+			::close(memfd);
+		}
+		conn->forceClose();
+		return;
+	}
+	void* base=::mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,memfd,0);
+	if(base!=MAP_FAILED){
+		ShmConnection::initSegment(base,ringSize_);
+		::munmap(base,size);
+	}
+	ShmConnectionPtr shm=std::make_shared<ShmConnection>(conn->getLoop(),conn->name(),memfd,true,conn);
+	if(!shm->valid()){
+		::close(memfd);
+		conn->forceClose();
+		return;
+	}
+	shm->setConnectionCallback(connectionCallback_);
+	shm->setMessageCallback(messageCallback_);
+	shm->setBusyPoll(busyPollMicros_);
+	int fds[2]={memfd,shm->doorbellFd()};
+	conn->sendFds(fds,2,"S",1);
+	::close(memfd);
+	conn->setContext<ShmConnectionPtr>(shm);
+}
+
+//握手只有一条消息：客户端的门铃fd
+void ShmServer::onControlMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp){
+	buf->retrieveAll();
+	std::vector<int> fds=conn->takeReceivedFds();
+	ShmConnectionPtr* shm=conn->getContext<ShmConnectionPtr>();
+	if(shm&&!(*shm)->connected()&&fds.size()==1){
+		(*shm)->setPeerDoorbell(fds[0]);
+		(*shm)->connectEstablished();
+		return;
+	}
+	for(int fd:fds){
+		::close(fd);
+	}
+	LOG_ERROR("ShmServer::onControlMessage [%s] unexpected control message \n",conn->name().c_str());
+}
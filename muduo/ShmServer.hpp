@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+
+#include "noncopyable.hpp"
+#include "TcpServer.hpp"
+#include "ShmConnection.hpp"
+
+/*
+共享内存传输的服务端：在AF_UNIX地址上监听控制连接
+控制连接建立以后创建memfd，把memfd和自己的门铃fd发给客户端；收到客户端的门铃fd以后连接建立
+共享内存连接和它的控制连接在同一个loop里，控制连接断开时共享内存连接随之断开
+*/
+class ShmServer:noncopyable{
+public:
+	ShmServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& nameArg,size_t ringSize=ShmConnection::kDefaultRingSize);
+
+	//以下设置都需要在start之前调用
+	void setThreadNum(int num){server_.setThreadNum(num);}
+	void setConnectionCallback(const ShmConnectionCallback& cb){connectionCallback_=cb;}
+	void setMessageCallback(const ShmMessageCallback& cb){messageCallback_=cb;}
+	void setBusyPoll(int micros){busyPollMicros_=micros;}
+
+	void start(){server_.start();}
+
+private:
+	void onControlConnection(const TcpConnectionPtr& conn);
+	void onControlMessage(const TcpConnectionPtr& conn,Buffer* buf,Timestamp receiveTime);
+
+	TcpServer server_;
+	const size_t ringSize_;
+	int busyPollMicros_;
+	ShmConnectionCallback connectionCallback_;
+	ShmMessageCallback messageCallback_;
+};
@@ -7,13 +7,17 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
 Socket::~Socket(){
 	::close(sockfd_);
 }
 
 void Socket::bindAddress(const InetAddress &localaddr){
-	if(0!=::bind(sockfd_,(struct sockaddr*)localaddr.getSockAddr(),sizeof(sockaddr_in))){
-		LOG_FATAL("bind sockfd:%d fail \n",sockfd_);
+	if(0!=::bind(sockfd_,localaddr.sockAddr(),localaddr.sockAddrLen())){
+		LOG_FATAL("bind sockfd:%d %s fail \n",sockfd_,localaddr.toIpPort().c_str());
 	}
 }
 
@@ -24,12 +28,12 @@ void Socket::listen(){
 }
 
 int Socket::accept(InetAddress *peeraddr){
-	sockaddr_in addr;
+	sockaddr_storage addr;	//IPv4和AF_UNIX地址都放得下
 	socklen_t len=sizeof(addr);
 	bzero(&addr,sizeof(addr));
 	int connfd=::accept4(sockfd_,(struct sockaddr*)&addr,&len,SOCK_NONBLOCK|SOCK_CLOEXEC);
 	if(connfd>=0){
-		peeraddr->setSockAddr(addr);
+		peeraddr->setSockAddr((struct sockaddr*)&addr,len);
 	}
 	return connfd;
 }
@@ -58,4 +62,9 @@ void Socket::setReusePort(bool on){
 void Socket::setKeepAlive(bool on){
 	int opt=on?1:0;
 	::setsockopt(sockfd_,SOL_SOCKET,SO_KEEPALIVE,&opt,sizeof(opt));
-}
\ No newline at end of file
+}
+
+bool Socket::setZeroCopy(bool on){
+	int opt=on?1:0;
+	return ::setsockopt(sockfd_,SOL_SOCKET,SO_ZEROCOPY,&opt,sizeof(opt))==0;
+}
@@ -17,6 +17,7 @@ public:
 	void setReuseAddr(bool on);
 	void setReusePort(bool on);
 	void setKeepAlive(bool on);
+	bool setZeroCopy(bool on);	//SO_ZEROCOPY，内核不支持时返回false
 private:
 	const int sockfd_;
 };
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "SpliceRelay.hpp"
+#include "TcpConnection.hpp"
+#include "Channel.hpp"
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+std::shared_ptr<SpliceRelay> SpliceRelay::start(const TcpConnectionPtr& a,const TcpConnectionPtr& b,size_t pipeSize){
+	if(a->getLoop()!=b->getLoop()){
+		LOG_FATAL("%s:%s:%d relay connections belong to different loops \n",__FILE__,__FUNCTION__,__LINE__);
+	}
+	//splice直接搬运socket里的字节，只有明文或者两个方向都由kTLS处理的连接才行
+	if(a->tlsHandshaking_||a->tlsUserTx_||a->tlsUserRx_||b->tlsHandshaking_||b->tlsUserTx_||b->tlsUserRx_){
+		LOG_FATAL("%s:%s:%d relay connections use user-space TLS \n",__FILE__,__FUNCTION__,__LINE__);
+	}
+	std::shared_ptr<SpliceRelay> relay=std::make_shared<SpliceRelay>(a.get(),b.get(),pipeSize);
+	//已经读进用户态的数据先按普通方式转发
+	if(a->inputBuffer_.readableBytes()>0){
+		b->send(&a->inputBuffer_);
+	}
+	if(b->inputBuffer_.readableBytes()>0){
+		a->send(&b->inputBuffer_);
+	}
+	a->relay_=relay;
+	b->relay_=relay;
+	relay->transfer(relay->dirs_[0]);
+	relay->transfer(relay->dirs_[1]);
+	return relay;
+}
+
+SpliceRelay::SpliceRelay(TcpConnection* a,TcpConnection* b,size_t pipeSize)
+	:closed_(false)
+{
+	TcpConnection* ends[2]={a,b};
+	for(int i=0;i<2;++i){
+		Direction& dir=dirs_[i];
+		dir.from=ends[i];
+		dir.to=ends[1-i];
+		if(::pipe2(dir.pipefd,O_NONBLOCK|O_CLOEXEC)<0){
+			LOG_FATAL("%s:%s:%d pipe2 err:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);
+		}
+		int size=::fcntl(dir.pipefd[1],F_SETPIPE_SZ,static_cast<int>(pipeSize));
+		if(size<0){
+			size=::fcntl(dir.pipefd[1],F_GETPIPE_SZ);
+		}
+		dir.capacity=static_cast<size_t>(size);
+		dir.inPipe=0;
+		dir.eof=false;
+		dir.shut=false;
+		dir.bytes=0;
+	}
+}
+
+SpliceRelay::~SpliceRelay(){
+	for(int i=0;i<2;++i){
+		::close(dirs_[i].pipefd[0]);
+		::close(dirs_[i].pipefd[1]);
+	}
+}
+
+void SpliceRelay::handleRead(TcpConnection* conn){
+	if(!closed_){
+		transfer(dirs_[conn==dirs_[0].from?0:1]);
+	}
+}
+
+void SpliceRelay::handleWrite(TcpConnection* conn){
+	if(!closed_){
+		transfer(dirs_[conn==dirs_[0].to?0:1]);
+	}
+}
+
+//任意一端关闭，另一端也关闭
+void SpliceRelay::handleClose(TcpConnection* conn){
+	if(!closed_){
+		LOG_INFO("SpliceRelay::handleClose fd=%d \n",conn->channel_.fd());
+		closeAll();
+	}
+}
+
+void SpliceRelay::transfer(Direction& dir){
+	const int fromFd=dir.from->channel_.fd();
+	const int toFd=dir.to->channel_.fd();
+	bool progress=true;
+	while(progress&&!closed_){
+		progress=false;
+		//socket=>pipe
+		if(!dir.eof&&dir.inPipe<dir.capacity){
+			ssize_t n=::splice(fromFd,nullptr,dir.pipefd[1],nullptr,dir.capacity-dir.inPipe,SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+			if(n>0){
+				dir.inPipe+=n;
+				progress=true;
+			}
+			else if(n==0){
+				dir.eof=true;
+			}
+			else if(errno!=EAGAIN){
+				LOG_ERROR("SpliceRelay::transfer splice from fd=%d err:%d \n",fromFd,errno);
+				closeAll();
+				return;
+			}
+		}
+		//pipe=>socket，对端outputBuffer_里还有普通数据时要等它先发完
+		if(dir.inPipe>0&&dir.to->bufferedBytes()==0&&dir.to->pendingChunks_.empty()){
+			ssize_t n=::splice(dir.pipefd[0],nullptr,toFd,nullptr,dir.inPipe,SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+			if(n>0){
+				dir.inPipe-=n;
+				dir.bytes+=n;
+				progress=true;
+			}
+			else if(n<0&&errno!=EAGAIN){
+				LOG_ERROR("SpliceRelay::transfer splice to fd=%d err:%d \n",toFd,errno);
+				closeAll();
+				return;
+			}
+		}
+	}
+	if(!closed_){
+		updateChannels(dir);
+	}
+}
+
+//根据pipe的水位调整两端关注的事件
+void SpliceRelay::updateChannels(Direction& dir){
+	Channel* from=&dir.from->channel_;
+	Channel* to=&dir.to->channel_;
+	if(dir.eof||dir.inPipe>=dir.capacity){	//pipe满了就先不读，数据留在内核的socket缓冲区里
+		if(from->isReading()){
+			from->disableReading();
+		}
+	}
+	else if(!from->isReading()){
+		from->enableReading();
+	}
+	const bool toBuffered=dir.to->bufferedBytes()>0||!dir.to->pendingChunks_.empty();
+	if(dir.inPipe>0||toBuffered){
+		if(!to->isWriting()){
+			to->enableWriting();
+		}
+	}
+	else if(to->isWriting()){
+		to->disableWriting();
+	}
+	//源端EOF并且数据都转发完，把EOF传给对端
+	if(dir.eof&&dir.inPipe==0&&!toBuffered&&!dir.shut){
+		dir.shut=true;
+		dir.to->shutdown();
+	}
+	if(dirs_[0].shut&&dirs_[1].shut){
+		closeAll();
+	}
+}
+
+void SpliceRelay::closeAll(){
+	closed_=true;
+	for(int i=0;i<2;++i){
+		dirs_[i].from->forceClose();
+	}
+}
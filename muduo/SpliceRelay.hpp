@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+#include "Callbacks.hpp"
+
+/*
+两个TcpConnection之间的零拷贝中继：每个方向一个内核pipe，用splice(2)把数据从一个socket搬到另一个socket
+数据不进入用户态的Buffer；pipe写满时停止读源端(背压)，一端读到EOF后把数据发完再shutdown另一端的写，
+两个方向都结束或者任一端出错时关闭两个连接
+*/
+class SpliceRelay:noncopyable,public std::enable_shared_from_this<SpliceRelay>{
+public:
+	static const size_t kDefaultPipeSize=64*1024;
+
+	//在连接所属的loop线程里调用，a和b必须属于同一个loop且都已经建立
+	//调用之前inputBuffer_里已经读到的数据会先转发给对端；之后两个连接的MessageCallback不再被调用
+	static std::shared_ptr<SpliceRelay> start(const TcpConnectionPtr& a,const TcpConnectionPtr& b,size_t pipeSize=kDefaultPipeSize);
+
+	SpliceRelay(TcpConnection* a,TcpConnection* b,size_t pipeSize);
+	~SpliceRelay();
+
+	uint64_t bytesAtoB()const{return dirs_[0].bytes;}
+	uint64_t bytesBtoA()const{return dirs_[1].bytes;}
+	bool closed()const{return closed_;}
+private:
+	friend class TcpConnection;
+
+	struct Direction{
+		TcpConnection* from;
+		TcpConnection* to;
+		int pipefd[2];
+		size_t capacity;	//pipe的容量
+		size_t inPipe;	//pipe里还没有写给to的字节数
+		bool eof;	//from已经读到EOF
+		bool shut;	//已经shutdown了to的写端
+		uint64_t bytes;
+	};
+
+	//由TcpConnection在中继模式下调用
+	void handleRead(TcpConnection* conn);
+	void handleWrite(TcpConnection* conn);
+	void handleClose(TcpConnection* conn);
+
+	void transfer(Direction& dir);
+	void updateChannels(Direction& dir);
+	void closeAll();
+
+	Direction dirs_[2];	//dirs_[0]是a到b，dirs_[1]是b到a
+	bool closed_;
+};
@@ -0,0 +1,442 @@
+#include "StaticFileHandler.hpp"
+#include "HttpResponse.hpp"
+#include "Logger.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace{
+struct MimeType{
+	const char* extension;
+	const char* type;
+};
+
+const MimeType kMimeTypes[]={
+	{"html","text/html; charset=utf-8"},
+	{"htm","text/html; charset=utf-8"},
+	{"css","text/css"},
+	{"js","application/javascript"},
+	{"json","application/json"},
+	{"txt","text/plain; charset=utf-8"},
+	{"xml","application/xml"},
+	{"svg","image/svg+xml"},
+	{"png","image/png"},
+	{"jpg","image/jpeg"},
+	{"jpeg","image/jpeg"},
+	{"gif","image/gif"},
+	{"ico","image/x-icon"},
+	{"webp","image/webp"},
+	{"woff","font/woff"},
+	{"woff2","font/woff2"},
+	{"wasm","application/wasm"},
+	{"pdf","application/pdf"},
+	{"mp4","video/mp4"},
+};
+
+const char* contentTypeOf(const std::string& path){
+	const size_t dot=path.rfind('.');
+	if(dot!=std::string::npos&&path.find('/',dot)==std::string::npos){
+		StringPiece ext(path.data()+dot+1,path.size()-dot-1);
+		for(const MimeType& mime:kMimeTypes){
+			if(ext.caseEquals(mime.extension)){
+				return mime.type;
+			}
+		}
+	}
+	return "application/octet-stream";
+}
+
+int hexValue(char c){
+	if(c>='0'&&c<='9') return c-'0';
+	if(c>='a'&&c<='f') return c-'a'+10;
+	if(c>='A'&&c<='F') return c-'A'+10;
+	return -1;
+}
+
+//URL路径解码并规范化成相对root的路径，根目录是"."；有".."、NUL或者编码错误时返回false
+bool normalizePath(StringPiece path,std::string* out){
+	if(path.empty()||path[0]!='/'){
+		return false;
+	}
+	out->clear();
+	std::string segment;
+	for(size_t i=1;i<=path.size();++i){
+		if(i==path.size()||path[i]=='/'){
+			if(segment==".."){
+				return false;
+			}
+			if(!segment.empty()&&segment!="."){
+				if(!out->empty()){
+					out->push_back('/');
+				}
+				out->append(segment);
+			}
+			segment.clear();
+			continue;
+		}
+		char c=path[i];
+		if(c=='%'){
+			if(i+2>=path.size()){
+				return false;
+			}
+			const int hi=hexValue(path[i+1]);
+			const int lo=hexValue(path[i+2]);
+			if(hi<0||lo<0){
+				return false;
+			}
+			c=static_cast<char>(hi*16+lo);
+			i+=2;
+		}
+		if(c=='\0'||c=='/'){	//编码过的'/'也拒绝，避免绕过".."检查
+			return false;
+		}
+		segment.push_back(c);
+	}
+	if(out->empty()){
+		out->assign(".");
+	}
+	return true;
+}
+
+//If-None-Match里的实体标签列表，弱比较
+bool etagMatches(StringPiece header,const std::string& etag){
+	size_t i=0;
+	while(i<header.size()){
+		while(i<header.size()&&(header[i]==' '||header[i]==','||header[i]=='\t')){
+			++i;
+		}
+		size_t end=i;
+		while(end<header.size()&&header[end]!=','){
+			++end;
+		}
+		StringPiece tag(header.data()+i,end-i);
+		while(!tag.empty()&&(tag[tag.size()-1]==' '||tag[tag.size()-1]=='\t')){
+			tag=StringPiece(tag.data(),tag.size()-1);
+		}
+		if(tag.equals("*")){
+			return true;
+		}
+		if(tag.startsWith("W/")){
+			tag=tag.substr(2);
+		}
+		if(tag.equals(etag)){
+			return true;
+		}
+		i=end;
+	}
+	return false;
+}
+
+bool parseNumber(StringPiece s,int64_t* value){
+	if(s.empty()||s.size()>18){
+		return false;
+	}
+	int64_t v=0;
+	for(size_t i=0;i<s.size();++i){
+		if(s[i]<'0'||s[i]>'9'){
+			return false;
+		}
+		v=v*10+(s[i]-'0');
+	}
+	*value=v;
+	return true;
+}
+
+enum RangeResult{kRangeIgnored,kRangeOk,kRangeUnsatisfiable};
+
+//只支持单个区间，多区间和无法识别的写法按没有Range处理
+RangeResult parseRange(StringPiece header,int64_t size,int64_t* first,int64_t* last){
+	if(!header.startsWith("bytes=")){
+		return kRangeIgnored;
+	}
+	StringPiece spec=header.substr(6);
+	while(!spec.empty()&&spec[0]==' '){
+		spec=spec.substr(1);
+	}
+	while(!spec.empty()&&spec[spec.size()-1]==' '){
+		spec=StringPiece(spec.data(),spec.size()-1);
+	}
+	const char* dash=static_cast<const char*>(::memchr(spec.data(),'-',spec.size()));
+	if(dash==nullptr||::memchr(spec.data(),',',spec.size())!=nullptr){
+		return kRangeIgnored;
+	}
+	StringPiece from(spec.data(),dash-spec.data());
+	StringPiece to(dash+1,spec.end()-dash-1);
+	int64_t a=0;
+	int64_t b=0;
+	if(from.empty()){	//"-n"表示最后n个字节
+		if(!parseNumber(to,&b)){
+			return kRangeIgnored;
+		}
+		if(b==0||size==0){
+			return kRangeUnsatisfiable;
+		}
+		*first=b<size?size-b:0;
+		*last=size-1;
+		return kRangeOk;
+	}
+	if(!parseNumber(from,&a)){
+		return kRangeIgnored;
+	}
+	if(to.empty()){
+		b=size-1;
+	}
+	else if(!parseNumber(to,&b)||b<a){
+		return kRangeIgnored;
+	}
+	if(a>=size){
+		return kRangeUnsatisfiable;
+	}
+	*first=a;
+	*last=b<size?b:size-1;
+	return kRangeOk;
+}
+
+void simpleResponse(HttpResponse* resp,int status){
+	resp->setStatus(status);
+	resp->setContentType("text/plain");
+	resp->setBody(HttpResponse::reasonPhrase(status));
+}
+}
+
+StaticFileHandler::CachedFile::~CachedFile(){
+	if(map!=nullptr){
+		::munmap(const_cast<char*>(map),static_cast<size_t>(size));
+	}
+	if(fd>=0){
+		::close(fd);
+	}
+}
+
+StaticFileHandler::StaticFileHandler(const std::string& root)
+	:root_(root)
+	,rootFd_(::open(root.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC))
+	,maxEntries_(1024)
+	,mmapThreshold_(64*1024)
+	,revalidateInterval_(1.0)
+	,hits_(0)
+	,misses_(0)
+	,evictions_(0)
+	,notFound_(0)
+{
+	if(rootFd_<0){
+		LOG_FATAL("StaticFileHandler open root %s err:%d\n",root.c_str(),errno);
+	}
+}
+
+StaticFileHandler::~StaticFileHandler(){
+	::close(rootFd_);
+}
+
+StaticFileHandler::Stats StaticFileHandler::stats()const{
+	Stats stats;
+	stats.hits=hits_.load(std::memory_order_relaxed);
+	stats.misses=misses_.load(std::memory_order_relaxed);
+	stats.evictions=evictions_.load(std::memory_order_relaxed);
+	stats.notFound=notFound_.load(std::memory_order_relaxed);
+	return stats;
+}
+
+size_t StaticFileHandler::cachedFiles()const{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return lru_.size();
+}
+
+//打开并读取元数据，目录换成其中的index.html；失败返回空
+StaticFileHandler::CachedFilePtr StaticFileHandler::load(const std::string& relPath){
+	std::string path=relPath;
+	int fd=::openat(rootFd_,path.c_str(),O_RDONLY|O_CLOEXEC);
+	struct stat st;
+	if(fd>=0&&::fstat(fd,&st)!=0){
+		::close(fd);
+		fd=-1;
+	}
+	if(fd>=0&&S_ISDIR(st.st_mode)){
+		int indexFd=::openat(fd,"index.html",O_RDONLY|O_CLOEXEC);
+		::close(fd);
+		fd=indexFd;
+		path=relPath=="."?"index.html":relPath+"/index.html";
+		if(fd>=0&&::fstat(fd,&st)!=0){
+			::close(fd);
+			fd=-1;
+		}
+	}
+	if(fd<0){
+		return CachedFilePtr();
+	}
+	if(!S_ISREG(st.st_mode)){
+		::close(fd);
+		return CachedFilePtr();
+	}
+	CachedFilePtr file=std::make_shared<CachedFile>();
+	file->fd=fd;
+	file->size=st.st_size;
+	file->inode=st.st_ino;
+	file->mtime=st.st_mtim;
+	file->path=path;
+	file->contentType=contentTypeOf(path);
+	char buf[64];
+	::snprintf(buf,sizeof buf,"\"%lx-%llx-%llx\"",static_cast<unsigned long>(st.st_ino),
+		static_cast<unsigned long long>(st.st_size),
+		static_cast<unsigned long long>(st.st_mtim.tv_sec)*1000000000ULL+st.st_mtim.tv_nsec);
+	file->etag=buf;
+	struct tm tm;
+	::gmtime_r(&st.st_mtim.tv_sec,&tm);
+	file->lastModified.assign(buf,::strftime(buf,sizeof buf,"%a, %d %b %Y %H:%M:%S GMT",&tm));
+	if(file->size>0&&static_cast<size_t>(file->size)<=mmapThreshold_){
+		void* addr=::mmap(nullptr,static_cast<size_t>(file->size),PROT_READ,MAP_PRIVATE|MAP_POPULATE,fd,0);
+		if(addr!=MAP_FAILED){
+			file->map=static_cast<const char*>(addr);
+		}
+	}
+	file->checkedAt=Timestamp::now();
+	return file;
+}
+
+//文件被替换或修改过就返回false，mmap过的文件被截断再访问会SIGBUS，所以大小变化也要重新加载
+bool StaticFileHandler::unchanged(const CachedFile& file){
+	struct stat st;
+	return ::fstatat(rootFd_,file.path.c_str(),&st,0)==0
+		&&st.st_ino==file.inode
+		&&st.st_size==file.size
+		&&st.st_mtim.tv_sec==file.mtime.tv_sec
+		&&st.st_mtim.tv_nsec==file.mtime.tv_nsec;
+}
+
+StaticFileHandler::CachedFilePtr StaticFileHandler::lookup(const std::string& key){
+	CachedFilePtr file;
+	const Timestamp now=Timestamp::now();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it=index_.find(key);
+		if(it!=index_.end()){
+			lru_.splice(lru_.begin(),lru_,it->second);
+			file=it->second->second;
+			if(timeDifference(now,file->checkedAt)<revalidateInterval_){
+				hits_.fetch_add(1,std::memory_order_relaxed);
+				return file;
+			}
+		}
+	}
+	if(file){
+		if(unchanged(*file)){
+			std::lock_guard<std::mutex> lock(mutex_);
+			file->checkedAt=now;
+			hits_.fetch_add(1,std::memory_order_relaxed);
+			return file;
+		}
+		erase(key,file.get());
+	}
+	misses_.fetch_add(1,std::memory_order_relaxed);
+	file=load(key);
+	if(file){
+		insert(key,file);
+	}
+	return file;
+}
+
+void StaticFileHandler::insert(const std::string& key,const CachedFilePtr& file){
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it=index_.find(key);
+	if(it!=index_.end()){	//其他线程同时加载了同一个文件，用新的替换
+		it->second->second=file;
+		lru_.splice(lru_.begin(),lru_,it->second);
+		return;
+	}
+	lru_.emplace_front(key,file);
+	index_[key]=lru_.begin();
+	while(lru_.size()>maxEntries_){
+		//还在发送的响应持有shared_ptr，发完以后才真正关闭
+		index_.erase(lru_.back().first);
+		lru_.pop_back();
+		evictions_.fetch_add(1,std::memory_order_relaxed);
+	}
+}
+
+void StaticFileHandler::erase(const std::string& key,const CachedFile* file){
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it=index_.find(key);
+	if(it!=index_.end()&&it->second->second.get()==file){
+		lru_.erase(it->second);
+		index_.erase(it);
+	}
+}
+
+void StaticFileHandler::handle(const HttpRequest& request,HttpResponse* resp){
+	if(request.method()!=HttpRequest::kGet&&request.method()!=HttpRequest::kHead){
+		resp->setStatus(405);
+		resp->addHeader("Allow","GET, HEAD");
+		resp->setBody(HttpResponse::reasonPhrase(405));
+		return;
+	}
+	std::string key;
+	if(!normalizePath(request.path(),&key)){
+		simpleResponse(resp,400);
+		return;
+	}
+	CachedFilePtr file=lookup(key);
+	if(!file){
+		notFound_.fetch_add(1,std::memory_order_relaxed);
+		simpleResponse(resp,404);
+		return;
+	}
+
+	StringPiece ifNoneMatch=request.header("If-None-Match");
+	if(!ifNoneMatch.empty()&&etagMatches(ifNoneMatch,file->etag)){
+		resp->setStatus(304);
+		resp->addHeader("ETag",file->etag);
+		resp->setBody(StringPiece());
+		return;
+	}
+
+	int64_t first=0;
+	int64_t last=file->size-1;
+	int status=200;
+	StringPiece range=request.header("Range");
+	if(!range.empty()){
+		//If-Range的验证器和当前文件不一致时忽略Range，返回整个文件
+		StringPiece ifRange=request.header("If-Range");
+		if(ifRange.empty()||ifRange.equals(file->etag)||ifRange.equals(file->lastModified)){
+			RangeResult result=parseRange(range,file->size,&first,&last);
+			if(result==kRangeUnsatisfiable){
+				char contentRange[48];
+				::snprintf(contentRange,sizeof contentRange,"bytes */%lld",static_cast<long long>(file->size));
+				resp->setStatus(416);
+				resp->addHeader("Content-Range",contentRange);
+				resp->setBody(StringPiece());
+				return;
+			}
+			if(result==kRangeOk){
+				status=206;
+			}
+			else{
+				first=0;
+				last=file->size-1;
+			}
+		}
+	}
+
+	resp->setStatus(status);
+	resp->setContentType(file->contentType);
+	resp->addHeader("ETag",file->etag);
+	resp->addHeader("Last-Modified",file->lastModified);
+	resp->addHeader("Accept-Ranges","bytes");
+	if(status==206){
+		char contentRange[80];
+		::snprintf(contentRange,sizeof contentRange,"bytes %lld-%lld/%lld",static_cast<long long>(first),
+			static_cast<long long>(last),static_cast<long long>(file->size));
+		resp->addHeader("Content-Range",contentRange);
+	}
+	const size_t length=static_cast<size_t>(last-first+1);
+	if(file->map!=nullptr){
+		resp->setSharedBody(file,StringPiece(file->map+first,length));
+	}
+	else{
+		resp->setFileBody(file->fd,static_cast<off_t>(first),length,file);
+	}
+}
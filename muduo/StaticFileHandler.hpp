@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "noncopyable.hpp"
+#include "Timestamp.hpp"
+#include "HttpRequest.hpp"
+
+class HttpResponse;
+
+/*
+把root目录下的文件作为静态资源返回，只支持GET和HEAD
+- 打开的fd和stat信息放在LRU缓存里，命中时不再open/stat；超过revalidateInterval才重新fstatat检查文件是否变化
+- 不超过mmapThreshold的文件额外mmap，body和响应头一起writev发出；大文件用sendfile，都不经过用户态拷贝
+- 支持单个区间的Range(206/416)、If-Range、ETag/If-None-Match(304)
+- 路径里的".."和NUL直接拒绝；root里的符号链接按普通文件对待，不检查是否指向root之外
+可以被多个IO线程同时调用，缓存由一把锁保护，锁内不做系统调用
+*/
+class StaticFileHandler:noncopyable{
+public:
+	struct Stats{
+		int64_t hits;
+		int64_t misses;
+		int64_t evictions;
+		int64_t notFound;
+		double hitRate()const{return hits+misses>0?static_cast<double>(hits)/(hits+misses):0.0;}
+	};
+
+	explicit StaticFileHandler(const std::string& root);
+	~StaticFileHandler();
+
+	//以下设置在开始处理请求之前调用
+	void setMaxEntries(size_t n){maxEntries_=n;}
+	void setMmapThreshold(size_t bytes){mmapThreshold_=bytes;}
+	void setRevalidateInterval(double seconds){revalidateInterval_=seconds;}
+
+	//作为HttpServer的HttpCallback使用
+	void handle(const HttpRequest& request,HttpResponse* resp);
+
+	Stats stats()const;
+	size_t cachedFiles()const;
+
+private:
+	//缓存项：最后一个引用(缓存本身或者还没发完的响应)释放时关闭fd、解除映射
+	struct CachedFile:noncopyable{
+		CachedFile():fd(-1),size(0),inode(0),map(nullptr){}
+		~CachedFile();
+
+		int fd;
+		int64_t size;
+		ino_t inode;
+		struct timespec mtime;
+		std::string path;	//相对root的实际文件路径，目录对应其中的index.html
+		std::string etag;
+		std::string lastModified;
+		const char* contentType;
+		const char* map;
+		Timestamp checkedAt;	//上一次确认文件没有变化的时间，只在锁内读写
+	};
+	using CachedFilePtr=std::shared_ptr<CachedFile>;
+	using LruList=std::list<std::pair<std::string,CachedFilePtr>>;
+
+	CachedFilePtr lookup(const std::string& key);
+	CachedFilePtr load(const std::string& relPath);
+	bool unchanged(const CachedFile& file);
+	void insert(const std::string& key,const CachedFilePtr& file);
+	void erase(const std::string& key,const CachedFile* file);
+
+	const std::string root_;
+	int rootFd_;
+	size_t maxEntries_;
+	size_t mmapThreshold_;
+	double revalidateInterval_;
+
+	mutable std::mutex mutex_;
+	LruList lru_;	//表头是最近使用的
+	std::unordered_map<std::string,LruList::iterator> index_;
+
+	std::atomic<int64_t> hits_;
+	std::atomic<int64_t> misses_;
+	std::atomic<int64_t> evictions_;
+	std::atomic<int64_t> notFound_;
+};
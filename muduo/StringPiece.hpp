@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+
+//指向别人内存的只读字符串视图，不拥有数据，例如HTTP解析出的字段指向inputBuffer_
+class StringPiece{
+public:
+	StringPiece():data_(""),size_(0){}
+	StringPiece(const char* data,size_t size):data_(data),size_(size){}
+	StringPiece(const char* str):data_(str),size_(::strlen(str)){}
+	StringPiece(const std::string& str):data_(str.data()),size_(str.size()){}
+
+	const char* data()const{return data_;}
+	size_t size()const{return size_;}
+	bool empty()const{return size_==0;}
+	const char* begin()const{return data_;}
+	const char* end()const{return data_+size_;}
+	char operator[](size_t i)const{return data_[i];}
+
+	std::string asString()const{return std::string(data_,size_);}
+	bool equals(StringPiece rhs)const{
+		return size_==rhs.size_&&::memcmp(data_,rhs.data_,size_)==0;
+	}
+	//ASCII大小写不敏感比较，HTTP头部名字和一些取值用
+	bool caseEquals(StringPiece rhs)const{
+		return size_==rhs.size_&&::strncasecmp(data_,rhs.data_,size_)==0;
+	}
+	bool startsWith(StringPiece prefix)const{
+		return size_>=prefix.size_&&::memcmp(data_,prefix.data_,prefix.size_)==0;
+	}
+	StringPiece substr(size_t pos,size_t len=std::string::npos)const{
+		if(pos>size_){
+			pos=size_;
+		}
+		if(len>size_-pos){
+			len=size_-pos;
+		}
+		return StringPiece(data_+pos,len);
+	}
+
+private:
+	const char* data_;
+	size_t size_;
+};
+
+inline bool operator==(StringPiece lhs,StringPiece rhs){return lhs.equals(rhs);}
+inline bool operator!=(StringPiece lhs,StringPiece rhs){return !lhs.equals(rhs);}
@@ -0,0 +1,119 @@
+#include "TcpClient.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+#include "TcpConnection.hpp"
+#include "MemoryPool.hpp"
+
+#include <sys/socket.h>
+#include <strings.h>
+
+static EventLoop* CheckNotNull(EventLoop* loop){
+	if(loop==nullptr){
+		LOG_FATAL("%s:%s:%d client loop is null \n",__FILE__,__FUNCTION__,__LINE__);
+	}
+	return loop;
+}
+
+TcpClient::TcpClient(EventLoop* loop,const InetAddress& serverAddr,const std::string& nameArg)
+	:loop_(CheckNotNull(loop))
+	,connector_(new Connector(loop,serverAddr))
+	,name_(nameArg)
+	,connNamePrefix_(std::make_shared<const std::string>(nameArg+"-"+serverAddr.toIpPort()))
+	,connectionCallback_(defaultConnectionCallback)
+	,messageCallback_(defaultMessageCallback)
+	,retry_(false)
+	,connect_(false)
+	,nextConnId_(1)
+{
+	connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection,this,std::placeholders::_1));
+}
+
+TcpClient::~TcpClient(){
+	TcpConnectionPtr conn;
+	bool unique=false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		unique=connection_.unique();
+		conn=connection_;
+	}
+	if(conn){
+		//连接可能比TcpClient活得久，关闭时不能再回调到已经析构的TcpClient，只销毁连接
+		EventLoop* loop=loop_;
+		loop_->runInLoop([conn,loop](){
+			conn->setCloseCallback([loop](const TcpConnectionPtr& c){
+				loop->queueInLoop([c](){ c->connectDestoryed(); });
+			});
+		});
+		if(unique){
+			conn->forceClose();
+		}
+	}
+	else{
+		connector_->stop();
+	}
+}
+
+void TcpClient::connect(){
+	LOG_INFO("TcpClient::connect [%s] - connecting to %s\n",name_.c_str(),connector_->serverAddress().toIpPort().c_str());
+	connect_=true;
+	connector_->start();
+}
+
+void TcpClient::disconnect(){
+	connect_=false;
+	std::lock_guard<std::mutex> lock(mutex_);
+	if(connection_){
+		connection_->shutdown();
+	}
+}
+
+void TcpClient::stop(){
+	connect_=false;
+	connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd){
+	struct sockaddr_storage local,peer;
+	socklen_t localLen=sizeof(local);
+	socklen_t peerLen=sizeof(peer);
+	::bzero(&local,sizeof(local));
+	::bzero(&peer,sizeof(peer));
+	if(::getsockname(sockfd,(sockaddr*)&local,&localLen)<0){
+		LOG_ERROR("sockets::getlocalAddr\n");
+	}
+	if(::getpeername(sockfd,(sockaddr*)&peer,&peerLen)<0){
+		LOG_ERROR("sockets::getpeerAddr\n");
+	}
+	InetAddress localAddr,peerAddr;
+	localAddr.setSockAddr((sockaddr*)&local,localLen);
+	peerAddr.setSockAddr((sockaddr*)&peer,peerLen);
+
+	TcpConnectionPtr conn=std::allocate_shared<TcpConnection>(PoolAllocator<TcpConnection>(loop_->memoryPool()),
+		loop_,nextConnId_++,connNamePrefix_,sockfd,localAddr,peerAddr);
+	conn->setConnectionCallback(connectionCallback_);
+	conn->setMessageCallback(messageCallback_);
+	conn->setBorrowedMessageCallback(borrowedMessageCallback_);
+	conn->setWriteCompleteCallback(writeCompleteCallback_);
+	conn->setCloseCallback([this](const TcpConnectionPtr& connPtr){ removeConnection(connPtr); });
+	if(tlsContext_&&!conn->startTls(tlsContext_,tlsServerName_)){
+		LOG_ERROR("TcpClient::newConnection [%s] start TLS failed\n",name_.c_str());
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		connection_=conn;
+	}
+	conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn){
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		connection_.reset();
+	}
+	loop_->queueInLoop(std::bind(&TcpConnection::connectDestoryed,conn));
+	if(retry_&&connect_){
+		LOG_INFO("TcpClient::removeConnection [%s] - reconnecting to %s\n",name_.c_str(),connector_->serverAddress().toIpPort().c_str());
+		connector_->restart();
+	}
+}
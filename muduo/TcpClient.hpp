@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "noncopyable.hpp"
+#include "InetAddress.hpp"
+#include "Callbacks.hpp"
+#include "Connector.hpp"
+#include "TlsContext.hpp"
+
+class EventLoop;
+
+/*
+主动连接一个服务器，连接建立以后和TcpServer一样交给TcpConnection处理读写
+和TcpServer共用EventLoop，出站和入站的连接在同一个reactor里
+*/
+class TcpClient:noncopyable{
+public:
+	TcpClient(EventLoop* loop,const InetAddress& serverAddr,const std::string& nameArg);
+	~TcpClient();
+
+	void connect();
+	void disconnect();	//半关闭已经建立的连接
+	void stop();	//停止正在进行的连接/重试
+
+	//连接断开以后是否自动重连
+	bool retry()const{return retry_;}
+	void enableRetry(){retry_=true;}
+	//见Connector::setRetryDelay
+	void setRetryDelay(int initMs,int maxMs){connector_->setRetryDelay(initMs,maxMs);}
+
+	TcpConnectionPtr connection()const{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return connection_;
+	}
+	EventLoop* getLoop()const{return loop_;}
+	const std::string& name()const{return name_;}
+
+	//非线程安全，需要在connect之前设置
+	void setConnectionCallback(const ConnectionCallback& cb){connectionCallback_=cb;}
+	void setMessageCallback(const MessageCallback& cb){messageCallback_=cb;}
+	void setBorrowedMessageCallback(const BorrowedMessageCallback& cb){borrowedMessageCallback_=cb;}
+	void setWriteCompleteCallback(const WriteCompleteCallback& cb){writeCompleteCallback_=cb;}
+	//每次连接尝试失败时在loop线程里回调，参数是errno；连接建立以后的断开仍然走ConnectionCallback
+	void setConnectErrorCallback(const Connector::ConnectErrorCallback& cb){connector_->setConnectErrorCallback(cb);}
+	//每次连上以后先做TLS握手，serverName用于SNI和证书主机名校验
+	void setTlsContext(const std::shared_ptr<TlsContext>& context,const std::string& serverName=std::string()){
+		tlsContext_=context;
+		tlsServerName_=serverName;
+	}
+
+private:
+	void newConnection(int sockfd);	//在loop线程里调用
+	void removeConnection(const TcpConnectionPtr& conn);
+
+	EventLoop* loop_;
+	ConnectorPtr connector_;
+	const std::string name_;
+	std::shared_ptr<const std::string> connNamePrefix_;
+	ConnectionCallback connectionCallback_;
+	MessageCallback messageCallback_;
+	BorrowedMessageCallback borrowedMessageCallback_;
+	WriteCompleteCallback writeCompleteCallback_;
+	std::shared_ptr<TlsContext> tlsContext_;
+	std::string tlsServerName_;
+	std::atomic_bool retry_;
+	std::atomic_bool connect_;
+	uint64_t nextConnId_;	//只在loop线程访问
+	mutable std::mutex mutex_;
+	TcpConnectionPtr connection_;	//由mutex_保护
+};
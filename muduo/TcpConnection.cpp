@@ -3,13 +3,68 @@
 #include "Socket.hpp"
 #include "Channel.hpp"
 #include "EventLoop.hpp"
+#include "SpliceRelay.hpp"
+#include "TlsContext.hpp"
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <strings.h>
+#include <string.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
 #include <functional>
+#include <algorithm>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+static void closeFds(std::vector<int>& fds)
+{
+	for (int fd : fds)
+	{
+		::close(fd);
+	}
+	fds.clear();
+}
+
+//fds不为空时把它们作为SCM_RIGHTS附在这段数据上
+static ssize_t sendWithFds(int sockfd, const char *data, size_t len, const std::vector<int> &fds)
+{
+	struct iovec iov;
+	iov.iov_base = const_cast<char *>(data);
+	iov.iov_len = len;
+	struct msghdr msg;
+	::bzero(&msg, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	char control[CMSG_SPACE(sizeof(int) * TcpConnection::kMaxFds)];
+	if (!fds.empty())
+	{
+		const size_t fdBytes = sizeof(int) * fds.size();
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(fdBytes);
+		::bzero(control, msg.msg_controllen);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(fdBytes);
+		::memcpy(CMSG_DATA(cmsg), fds.data(), fdBytes);
+	}
+	return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+}
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -20,39 +75,143 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
 	return loop;
 }
 
+void defaultConnectionCallback(const TcpConnectionPtr&)
+{
+}
+
+void defaultMessageCallback(const TcpConnectionPtr&, Buffer* buffer, Timestamp)
+{
+	buffer->retrieveAll();
+}
+
 TcpConnection::TcpConnection(EventLoop *loop, const std::string &nameArg, int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr)
-	: loop_(CheckLoopNotNull(loop)), name_(nameArg), state_(kConnecting), reading_(true), socket_(new Socket(sockfd)), channel_(new Channel(loop, sockfd)), localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024)
+	: TcpConnection(loop, 0, nullptr, sockfd, localAddr, peerAddr)
+{
+	name_ = nameArg;
+}
+
+TcpConnection::TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix, int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr)
+	: loop_(CheckLoopNotNull(loop)), id_(id), namePrefix_(namePrefix), state_(kConnecting), reading_(true), socket_(sockfd), channel_(loop, sockfd), localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024), lowWaterMark_(0), aboveHighWaterMark_(false), maxOutputBytes_(0), writeTimeoutMs_(0), writeTimerArmed_(false), outputBytes_(0), memoryPool_(loop->memoryPool()), inputBuffer_(memoryPool_->takeBuffer()), outputBuffer_(memoryPool_->takeBuffer()), pendingChunks_(PoolAllocator<PendingChunk>(loop->memoryPool())), zeroCopy_(false), zeroCopyThreshold_(kDefaultZeroCopyThreshold), zeroCopyNextId_(0), zeroCopyCompleted_(0), zeroCopyInflight_(PoolAllocator<ZeroCopyBlock>(loop->memoryPool())), autoCork_(false), corkPending_(false), receiveFds_(false), tlsHandshaking_(false), tlsUserTx_(false), tlsUserRx_(false)
 {
 	// 下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生以后，channel会执行相应的回调
-	channel_->setReadCallback(
-		std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-	channel_->setWriteCallback(
-		std::bind(&TcpConnection::handleWrite, this));
-	channel_->setCloseCallback(
-		std::bind(&TcpConnection::handleClose, this));
-	channel_->setERRORCallback(
-		std::bind(&TcpConnection::handleError, this));
-	LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
-	socket_->setKeepAlive(true);
+	// 只捕获this的lambda能放进std::function内部的存储，不需要堆分配
+	channel_.setReadCallback(
+		[this](Timestamp receiveTime){ handleRead(receiveTime); });
+	channel_.setWriteCallback(
+		[this](){ handleWrite(); });
+	channel_.setCloseCallback(
+		[this](){ handleClose(); });
+	channel_.setERRORCallback(
+		[this](){ handleError(); });
+	LOG_INFO("TcpConnection::ctor[#%llu] at fd=%d\n", static_cast<unsigned long long>(id_), sockfd);
+	socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-	LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", name_.c_str(), channel_->fd(), (int)state_);
+	LOG_INFO("TcpConnection::dtor[#%llu] at fd=%d state=%d \n", static_cast<unsigned long long>(id_), channel_.fd(), (int)state_);
+	// Buffer的存储还给loop的内存池，给之后的连接使用
+	memoryPool_->recycleBuffer(inputBuffer_);
+	memoryPool_->recycleBuffer(outputBuffer_);
+	closeFds(receivedFds_);
+	for (PendingChunk &chunk : pendingChunks_)
+	{
+		closeFds(chunk.fds);
+	}
+}
+
+const std::string& TcpConnection::name()const{
+	std::call_once(nameOnce_,[this](){
+		if(name_.empty()&&namePrefix_){
+			char buf[32];
+			snprintf(buf,sizeof(buf),"#%llu",static_cast<unsigned long long>(id_));
+			name_=*namePrefix_+buf;
+		}
+	});
+	return name_;
 }
 
 void TcpConnection::send(const std::string& buf){
 	if(state_==kConnected){
 		if(loop_->isInLoopThread()){
-			sendInLoop(buf.c_str(),buf.size());
+			sendInLoop(buf.data(),buf.size());
+		}
+		else{
+			//调用方的string随时可能被释放，跨线程时必须拷贝一份交给loop
+			loop_->runInLoop(std::bind(
+				&TcpConnection::sendStringInLoop,shared_from_this(),buf));
+		}
+	}
+}
+
+void TcpConnection::send(std::string&& buf){
+	if(state_==kConnected){
+		if(loop_->isInLoopThread()){
+			sendStringInLoop(buf);
 		}
 		else{
 			loop_->runInLoop(std::bind(
-				&TcpConnection::sendInLoop,this,buf.c_str(),buf.size()));
+				&TcpConnection::sendStringInLoop,shared_from_this(),std::move(buf)));
 		}
 	}
 }
 
+void TcpConnection::send(const void* data,size_t len){
+	if(state_==kConnected){
+		if(loop_->isInLoopThread()){
+			sendInLoop(data,len);
+		}
+		else{
+			loop_->runInLoop(std::bind(
+				&TcpConnection::sendStringInLoop,shared_from_this(),
+				std::string(static_cast<const char*>(data),len)));
+		}
+	}
+}
+
+void TcpConnection::send(Buffer* buf){
+	if(state_==kConnected){
+		if(loop_->isInLoopThread()){
+			sendBufferInLoop(*buf);
+		}
+		else{
+			//交换出buf的内存交给loop，不拷贝数据
+			Buffer message(0);
+			message.swap(*buf);
+			loop_->runInLoop(std::bind(
+				&TcpConnection::sendBufferInLoop,shared_from_this(),std::move(message)));
+		}
+	}
+}
+
+void TcpConnection::send(Buffer&& buf){
+	send(&buf);
+}
+
+void TcpConnection::sendStringInLoop(std::string& buf){
+	if(useZeroCopy(buf.size())){
+		//数据交给连接持有，直到内核通知MSG_ZEROCOPY完成
+		std::shared_ptr<std::string> owner=std::make_shared<std::string>();
+		owner->swap(buf);
+		sendOwnedInLoop(owner,owner->data(),owner->size(),true);
+	}
+	else{
+		sendInLoop(buf.data(),buf.size());
+	}
+}
+
+void TcpConnection::sendBufferInLoop(Buffer& buf){
+	if(useZeroCopy(buf.readableBytes())){
+		std::shared_ptr<Buffer> owner=std::make_shared<Buffer>(0);
+		owner->swap(buf);
+		sendOwnedInLoop(owner,owner->peek(),owner->readableBytes(),true);
+	}
+	else{
+		sendInLoop(buf.peek(),buf.readableBytes());
+		buf.retrieveAll();
+	}
+}
+
 void TcpConnection::sendInLoop(const void* data,size_t len){
 	ssize_t nwrote=0;
 	size_t remaining=len;
@@ -62,13 +221,16 @@ void TcpConnection::sendInLoop(const void* data,size_t len){
 		LOG_ERROR("disconnected ,give up writing!\n");
 		return;
 	}
-	//表示channel第一次开始写数据而且缓冲区没有待发送数据
-	if(!channel_->isWriting()&&outputBuffer_.readableBytes()==0){
-		nwrote=::write(channel_->fd(),data,len);
+	//表示channel第一次开始写数据而且缓冲区没有待发送数据；auto-cork时先攒着，本轮结束再写
+	if(!autoCork_&&!tlsHandshaking_&&!channel_.isWriting()&&outputBuffer_.readableBytes()==0){
+		nwrote=writeRaw(data,len);
 		if(nwrote>=0){
+			if(nwrote>0){
+				lastWriteProgress_=loop_->pollReturnTime();
+			}
 			remaining=len-nwrote;
 			if(remaining==0&&writeCompleteCallback_){
-				loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+				queueWriteComplete();
 			}
 		}
 		else{
@@ -86,15 +248,463 @@ void TcpConnection::sendInLoop(const void* data,size_t len){
 	//也就是调用TcpConnection::handleWrite方法，把发送缓冲区的数据全部发送完成
 	if(!faultError&&remaining>0){
 		//目前发送缓冲区剩余的待发送数据的长度
-		size_t oldLen=outputBuffer_.readableBytes();
-		if(oldLen+remaining>=highWaterMark_&&oldLen<highWaterMark_&&highWaterMarkCallback_){
-			loop_->queueInLoop(std::bind(highWaterMarkCallback_,shared_from_this(),oldLen+remaining));
+		if(!onOutputQueued(bufferedBytes(),remaining)){
+			return;
+		}
+		//有文件在排队时，数据要跟在文件后面发送
+		tailBuffer()->append((char*)data+nwrote,remaining);
+		updateOutputBytes();
+		if(!channel_.isWriting()){
+			if(autoCork_){
+				if(!corkPending_){
+					corkPending_=true;
+					loop_->runAtIterationEnd(std::bind(&TcpConnection::flushCorked,shared_from_this()));
+				}
+			}
+			else{
+				channel_.enableWriting();  //一定要注册channel的写事件
+			}
+		}
+	}
+}
+
+void TcpConnection::sendFile(int fd,off_t offset,size_t length){
+	sendFile(fd,offset,length,nullptr);
+}
+
+void TcpConnection::sendFile(int fd,off_t offset,size_t length,const std::shared_ptr<void>& owner){
+	if(state_==kConnected){
+		if(loop_->isInLoopThread()){
+			sendFileInLoop(fd,offset,length,owner);
+		}
+		else{
+			loop_->runInLoop(std::bind(
+				&TcpConnection::sendFileInLoop,shared_from_this(),fd,offset,length,owner));
+		}
+	}
+}
+
+void TcpConnection::sendShared(const std::shared_ptr<void>& owner,const char* data,size_t len){
+	if(state_==kConnected){
+		sendOwnedInLoop(owner,data,len,false);
+	}
+}
+
+void TcpConnection::sendFileInLoop(int fd,off_t offset,size_t length,const std::shared_ptr<void>& owner){
+	size_t remaining=length;
+	bool faultError=false;
+	if(state_==kDisconnected){
+		LOG_ERROR("disconnected ,give up sending file!\n");
+		return;
+	}
+	//前面没有排队的数据，直接sendfile；用户态TLS要先读出来加密，交给writeChunk
+	if(directWrite()&&!channel_.isWriting()&&outputBuffer_.readableBytes()==0){
+		ssize_t n=::sendfile(channel_.fd(),fd,&offset,remaining);
+		if(n>0){
+			lastWriteProgress_=loop_->pollReturnTime();
+			remaining-=n;
+			if(remaining==0&&writeCompleteCallback_){
+				queueWriteComplete();
+			}
+		}
+		else if(n==0&&remaining>0){
+			LOG_ERROR("TcpConnection::sendFileInLoop fd=%d reach EOF before %zu bytes\n",fd,length);
+			return;
+		}
+		else if(n<0&&errno!=EWOULDBLOCK){
+			LOG_ERROR("TcpConnection::sendFileInLoop\n");
+			if(errno==EPIPE||errno==ECONNRESET){
+				faultError=true;
+			}
+		}
+	}
+	if(!faultError&&remaining>0){
+		if(!onOutputQueued(bufferedBytes(),0)){
+			return;
+		}
+		pendingChunks_.emplace_back(fd,offset,remaining,owner);
+		enableWritingUnlessDeferred();
+	}
+}
+
+void TcpConnection::sendOwnedInLoop(const std::shared_ptr<void>& owner,const char* data,size_t len,bool zeroCopy){
+	bool faultError=false;
+	if(state_==kDisconnected){
+		LOG_ERROR("disconnected ,give up writing!\n");
+		return;
+	}
+	PendingChunk chunk(zeroCopy?PendingChunk::kZeroCopy:PendingChunk::kMemory,owner,data,len);
+	if(directWrite()&&!channel_.isWriting()&&outputBuffer_.readableBytes()==0){
+		ssize_t n=writeChunk(chunk);
+		if(n>=0){
+			if(n>0){
+				lastWriteProgress_=loop_->pollReturnTime();
+			}
+			if(chunk.remaining==0&&writeCompleteCallback_){
+				queueWriteComplete();
+			}
+		}
+		else if(errno!=EWOULDBLOCK){
+			LOG_ERROR("TcpConnection::sendOwnedInLoop\n");
+			if(errno==EPIPE||errno==ECONNRESET){
+				faultError=true;
+			}
+		}
+	}
+	if(chunk.remaining==0||faultError){
+		finishChunk(chunk);
+	}
+	else{
+		if(!onOutputQueued(bufferedBytes(),chunk.remaining)){
+			finishChunk(chunk);
+			return;
+		}
+		pendingChunks_.push_back(std::move(chunk));
+		updateOutputBytes();
+		enableWritingUnlessDeferred();
+	}
+}
+
+void TcpConnection::sendFds(const int* fds,size_t count,const void* data,size_t len){
+	if(state_!=kConnected){
+		return;
+	}
+	if(len==0||count>kMaxFds||tls_){
+		LOG_ERROR("TcpConnection::sendFds [#%llu] invalid %zu fds with %zu bytes\n",static_cast<unsigned long long>(id_),count,len);
+		return;
+	}
+	//先dup，调用返回以后调用方就可以关闭自己的fd
+	std::vector<int> dupFds;
+	dupFds.reserve(count);
+	for(size_t i=0;i<count;++i){
+		int fd=::fcntl(fds[i],F_DUPFD_CLOEXEC,0);
+		if(fd<0){
+			LOG_ERROR("TcpConnection::sendFds dup fd=%d err:%d\n",fds[i],errno);
+			closeFds(dupFds);
+			return;
+		}
+		dupFds.push_back(fd);
+	}
+	std::shared_ptr<std::string> payload=std::make_shared<std::string>(static_cast<const char*>(data),len);
+	if(loop_->isInLoopThread()){
+		sendFdsInLoop(payload,dupFds);
+	}
+	else{
+		TcpConnectionPtr self(shared_from_this());
+		loop_->runInLoop([self,payload,dupFds]()mutable{ self->sendFdsInLoop(payload,dupFds); });
+	}
+}
+
+void TcpConnection::sendFdsInLoop(const std::shared_ptr<std::string>& payload,std::vector<int>& fds){
+	bool faultError=false;
+	if(state_==kDisconnected){
+		LOG_ERROR("disconnected ,give up sending fds!\n");
+		closeFds(fds);
+		return;
+	}
+	PendingChunk chunk(payload,payload->data(),payload->size(),std::move(fds));
+	if(!channel_.isWriting()&&outputBuffer_.readableBytes()==0){
+		ssize_t n=writeChunk(chunk);
+		if(n>=0){
+			if(n>0){
+				lastWriteProgress_=loop_->pollReturnTime();
+			}
+			if(chunk.remaining==0&&writeCompleteCallback_){
+				queueWriteComplete();
+			}
+		}
+		else if(errno!=EWOULDBLOCK){
+			LOG_ERROR("TcpConnection::sendFdsInLoop\n");
+			if(errno==EPIPE||errno==ECONNRESET){
+				faultError=true;
+			}
+		}
+	}
+	if(chunk.remaining==0||faultError){
+		finishChunk(chunk);
+	}
+	else{
+		if(!onOutputQueued(bufferedBytes(),chunk.remaining)){
+			finishChunk(chunk);
+			return;
+		}
+		pendingChunks_.push_back(std::move(chunk));
+		updateOutputBytes();
+		if(!channel_.isWriting()){
+			channel_.enableWriting();
+		}
+	}
+}
+
+bool TcpConnection::setZeroCopy(bool on,size_t threshold){
+	if(on&&tls_){	//kTLS的发送路径不接受MSG_ZEROCOPY
+		LOG_ERROR("TcpConnection::setZeroCopy [%s] unsupported on TLS connection\n",name().c_str());
+		return false;
+	}
+	if(on&&!socket_.setZeroCopy(true)){
+		LOG_ERROR("TcpConnection::setZeroCopy [%s] SO_ZEROCOPY unsupported\n",name().c_str());
+		return false;
+	}
+	zeroCopy_=on;
+	zeroCopyThreshold_=threshold;
+	return true;
+}
+
+//发送一个分片的一部分，返回值和write一致
+ssize_t TcpConnection::writeChunk(PendingChunk& chunk){
+	ssize_t n=0;
+	if(tlsUserTx_){
+		//没有kTLS时文件数据先读到用户态再加密；WANT_WRITE以后重试的是同一个offset，数据和长度都不变
+		if(chunk.kind==PendingChunk::kFile){
+			char buf[16*1024];
+			n=::pread(chunk.fd,buf,std::min(chunk.remaining,sizeof(buf)),chunk.offset);
+			if(n>0){
+				n=tls_->write(buf,n);
+			}
+			if(n>0){
+				chunk.offset+=n;
+			}
+		}
+		else{
+			n=tls_->write(chunk.data,chunk.remaining);
+			if(n>0){
+				chunk.data+=n;
+			}
+		}
+	}
+	else if(chunk.kind==PendingChunk::kFile){
+		n=::sendfile(channel_.fd(),chunk.fd,&chunk.offset,chunk.remaining);
+	}
+	else if(chunk.kind==PendingChunk::kFds){
+		n=sendWithFds(channel_.fd(),chunk.data,chunk.remaining,chunk.fds);
+		if(n>0){	//fd已经随第一段数据交给内核，剩下的数据不再附带
+			closeFds(chunk.fds);
+			chunk.data+=n;
+		}
+	}
+	else if(chunk.kind==PendingChunk::kMemory){
+		n=::write(channel_.fd(),chunk.data,chunk.remaining);
+		if(n>0){
+			chunk.data+=n;
+		}
+	}
+	else{
+		n=::send(channel_.fd(),chunk.data,chunk.remaining,MSG_ZEROCOPY);
+		if(n<0&&errno==ENOBUFS){	//完成通知积压超过optmem限制，这一次退回普通拷贝发送
+			n=::send(channel_.fd(),chunk.data,chunk.remaining,0);
+		}
+		else if(n>0){	//每次成功的MSG_ZEROCOPY发送占用一个序号
+			chunk.zeroCopied=true;
+			chunk.lastId=zeroCopyNextId_++;
+		}
+		if(n>0){
+			chunk.data+=n;
+		}
+	}
+	if(n>0){
+		chunk.remaining-=n;
+	}
+	return n;
+}
+
+//分片发送结束，MSG_ZEROCOPY的数据要等内核通知完成以后才能释放
+void TcpConnection::finishChunk(PendingChunk& chunk){
+	if(chunk.kind==PendingChunk::kZeroCopy&&chunk.zeroCopied){
+		ZeroCopyBlock block;
+		block.lastId=chunk.lastId;
+		block.owner=std::move(chunk.owner);
+		zeroCopyInflight_.push_back(std::move(block));
+	}
+	chunk.owner.reset();
+	closeFds(chunk.fds);	//没有发出去的fd
+}
+
+bool TcpConnection::handleZeroCopyCompletion(){
+	bool got=false;
+	char control[128];
+	while(true){
+		struct msghdr msg;
+		::bzero(&msg,sizeof(msg));
+		msg.msg_control=control;
+		msg.msg_controllen=sizeof(control);
+		if(::recvmsg(channel_.fd(),&msg,MSG_ERRQUEUE)<0){	//EAGAIN说明错误队列已经读空
+			break;
 		}
-		outputBuffer_.append((char*)data+nwrote,remaining);
-		if(!channel_->isWriting()){
-			channel_->enableWriting();  //一定要注册channel的写事件
+		for(struct cmsghdr* cm=CMSG_FIRSTHDR(&msg);cm!=nullptr;cm=CMSG_NXTHDR(&msg,cm)){
+			if(!(cm->cmsg_level==SOL_IP&&cm->cmsg_type==IP_RECVERR)
+				&&!(cm->cmsg_level==SOL_IPV6&&cm->cmsg_type==IPV6_RECVERR)){
+				continue;
+			}
+			const struct sock_extended_err* serr=reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+			if(serr->ee_errno!=0||serr->ee_origin!=SO_EE_ORIGIN_ZEROCOPY){
+				continue;
+			}
+			got=true;
+			if(serr->ee_code&SO_EE_CODE_ZEROCOPY_COPIED&&zeroCopy_){
+				//内核仍然做了拷贝(比如回环网卡)，MSG_ZEROCOPY只会带来额外开销，关闭它
+				LOG_INFO("TcpConnection::handleZeroCopyCompletion [%s] kernel copied, disable zerocopy\n",name().c_str());
+				zeroCopy_=false;
+			}
+			completeZeroCopy(serr->ee_info,serr->ee_data);
 		}
 	}
+	return got;
+}
+
+//序号区间[lo,hi]已经完成，释放所有序号都已完成的数据块
+void TcpConnection::completeZeroCopy(uint32_t lo,uint32_t hi){
+	if(lo!=zeroCopyCompleted_){
+		zeroCopyRanges_.push_back(std::make_pair(lo,hi));
+		return;
+	}
+	zeroCopyCompleted_=hi+1;
+	bool merged=true;
+	while(merged){
+		merged=false;
+		for(size_t i=0;i<zeroCopyRanges_.size();++i){
+			if(zeroCopyRanges_[i].first==zeroCopyCompleted_){
+				zeroCopyCompleted_=zeroCopyRanges_[i].second+1;
+				zeroCopyRanges_.erase(zeroCopyRanges_.begin()+i);
+				merged=true;
+				break;
+			}
+		}
+	}
+	while(!zeroCopyInflight_.empty()
+		&&static_cast<int32_t>(zeroCopyCompleted_-zeroCopyInflight_.front().lastId)>0){
+		zeroCopyInflight_.pop_front();
+	}
+}
+
+bool TcpConnection::onOutputQueued(size_t oldLen,size_t added){
+	if(maxOutputBytes_>0&&oldLen+added>maxOutputBytes_){
+		evict(OutputGuard::kMaxOutputBytes);
+		return false;
+	}
+	if(writeTimeoutMs_>0){
+		//从这里开始积压；上一次积压留下的定时器可能还没到期，不管有没有定时器都要重新计时
+		if(oldLen==0&&pendingChunks_.empty()){
+			lastWriteProgress_=Timestamp::now();
+		}
+		if(!writeTimerArmed_){
+			armWriteTimer(writeTimeoutMs_/1000.0);
+		}
+	}
+	if(oldLen+added>=highWaterMark_&&oldLen<highWaterMark_){
+		aboveHighWaterMark_=true;
+		if(highWaterMarkCallback_){
+			TcpConnectionPtr self(shared_from_this());
+			const size_t len=oldLen+added;
+			loop_->queueInLoop([self,len](){ self->highWaterMarkCallback_(self,len); });
+		}
+	}
+	return true;
+}
+
+void TcpConnection::evict(OutputGuard::Reason reason){
+	LOG_INFO("TcpConnection::evict [%s] reason=%d outputBytes=%zu \n",name().c_str(),(int)reason,outputBytes());
+	if(guard_){
+		guard_->recordEviction(reason);
+	}
+	forceClose();
+}
+
+void TcpConnection::updateOutputBytes(){
+	const size_t bytes=(state_==kDisconnected)?0:bufferedBytes();
+	const size_t old=outputBytes_.load(std::memory_order_relaxed);
+	if(bytes!=old){
+		outputBytes_.store(bytes,std::memory_order_relaxed);
+		if(guard_){
+			guard_->adjust(old,bytes);
+		}
+	}
+}
+
+void TcpConnection::armWriteTimer(double seconds){
+	writeTimerArmed_=true;
+	std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+	loop_->runAfter(seconds,[weakConn](){
+		TcpConnectionPtr conn=weakConn.lock();
+		if(conn){
+			conn->checkWriteTimeout();
+		}
+	});
+}
+
+void TcpConnection::checkWriteTimeout(){
+	writeTimerArmed_=false;
+	if(state_==kDisconnected||writeTimeoutMs_<=0){
+		return;
+	}
+	if(bufferedBytes()==0&&pendingChunks_.empty()){	//积压已经清空
+		return;
+	}
+	const double timeout=writeTimeoutMs_/1000.0;
+	const double idle=timeDifference(Timestamp::now(),lastWriteProgress_);
+	if(idle>=timeout){
+		evict(OutputGuard::kWriteTimeout);
+	}
+	else{
+		armWriteTimer(timeout-idle);
+	}
+}
+
+//只捕获shared_ptr，不拷贝回调对象，Functor能内部存放
+void TcpConnection::queueWriteComplete(){
+	TcpConnectionPtr self(shared_from_this());
+	loop_->queueInLoop([self](){ self->writeCompleteCallback_(self); });
+}
+
+void TcpConnection::checkLowWaterMark(){
+	if(aboveHighWaterMark_){
+		size_t bytes=bufferedBytes();
+		if(bytes<=lowWaterMark_){
+			aboveHighWaterMark_=false;
+			if(lowWaterMarkCallback_){
+				TcpConnectionPtr self(shared_from_this());
+				loop_->queueInLoop([self,bytes](){ self->lowWaterMarkCallback_(self,bytes); });
+			}
+		}
+	}
+}
+
+size_t TcpConnection::bufferedBytes()const{
+	size_t bytes=outputBuffer_.readableBytes();
+	for(const PendingChunk& chunk:pendingChunks_){
+		bytes+=chunk.trailer.readableBytes();
+		if(chunk.kind!=PendingChunk::kFile){
+			bytes+=chunk.remaining;
+		}
+	}
+	return bytes;
+}
+
+void TcpConnection::startRead(){
+	loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop,shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop(){
+	if(state_==kDisconnected){
+		return;
+	}
+	if(!reading_||!channel_.isReading()){
+		channel_.enableReading();
+		reading_=true;
+	}
+}
+
+void TcpConnection::stopRead(){
+	loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop,shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop(){
+	if(state_==kDisconnected){
+		return;
+	}
+	if(reading_||channel_.isReading()){
+		channel_.disableReading();
+		reading_=false;
+	}
 }
 
 void TcpConnection::shutdown(){
@@ -104,91 +714,398 @@ void TcpConnection::shutdown(){
 	}
 }
 
+void TcpConnection::setTcpNoDelay(bool on){
+	socket_.setTcpNoDelay(on);
+}
+
+void TcpConnection::forceClose(){
+	if(state_==kConnected||state_==kDisconnecting){
+		setState(kDisconnecting);
+		loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop,shared_from_this()));
+	}
+}
+
+void TcpConnection::forceCloseInLoop(){
+	if(state_==kConnected||state_==kDisconnecting){
+		handleClose();
+	}
+}
+
 void TcpConnection::shutdownInLoop(){
-	if(!channel_->isWriting()){	//说明outputBuffer中的数据已经全部发送完成
-		socket_->shutdownWrite();
+	if(!channel_.isWriting()&&!corkPending_){	//说明outputBuffer中的数据已经全部发送完成
+		if(tls_){
+			tls_->shutdown();
+		}
+		socket_.shutdownWrite();
 	}
 }
 
 //连接建立
 void TcpConnection::connectEstablished(){
 	setState(kConnected);
-	channel_->tie(shared_from_this());
-	channel_->enableReading();
+	channel_.tie(shared_from_this());
+	channel_.enableReading();
 
+	if(tlsHandshaking_){	//握手完成以后再回调
+		continueHandshake();
+		return;
+	}
+	connectionCallback_(shared_from_this());
+}
+
+bool TcpConnection::startTls(const std::shared_ptr<TlsContext>& context,const std::string& serverName){
+	if(!context||state_!=kConnecting||tls_){
+		LOG_ERROR("TcpConnection::startTls [%s] must be called once before established\n",name().c_str());
+		return false;
+	}
+	//客户端没有给主机名时按对端IP校验证书，不能什么都不校验
+	const bool byPeerIp=serverName.empty()&&!context->isServer()&&!peerAddr_.isUnix();
+	std::unique_ptr<TlsStream> tls(new TlsStream());
+	if(!tls->init(*context,channel_.fd(),byPeerIp?peerAddr_.toIp():serverName)){
+		return false;
+	}
+	tls_.swap(tls);
+	tlsHandshaking_=true;
+	tlsUserTx_=true;
+	tlsUserRx_=true;
+	zeroCopy_=false;
+	return true;
+}
+
+void TcpConnection::continueHandshake(){
+	TlsStream::Result result=tls_->handshake();
+	if(result==TlsStream::kError){
+		LOG_ERROR("TcpConnection::continueHandshake [%s] TLS handshake failed\n",name().c_str());
+		handleClose();
+		return;
+	}
+	if(result!=TlsStream::kDone){	//只在OpenSSL要写的时候关注写事件，否则等读事件
+		if(result==TlsStream::kWantWrite&&!channel_.isWriting()){
+			channel_.enableWriting();
+		}
+		else if(result==TlsStream::kWantRead&&channel_.isWriting()){
+			channel_.disableWriting();
+		}
+		return;
+	}
+	tlsHandshaking_=false;
+	tlsUserTx_=!tls_->kernelTx();
+	tlsUserRx_=!tls_->kernelRx();
+	LOG_INFO("TcpConnection::continueHandshake [%s] TLS established kernelTx=%d kernelRx=%d\n",
+		name().c_str(),(int)tls_->kernelTx(),(int)tls_->kernelRx());
 	connectionCallback_(shared_from_this());
+	if(state_==kDisconnected){
+		return;
+	}
+	//握手期间send的数据还在outputBuffer_里
+	const bool queued=outputBuffer_.readableBytes()>0||!pendingChunks_.empty();
+	if(queued&&!channel_.isWriting()){
+		channel_.enableWriting();
+	}
+	else if(!queued&&channel_.isWriting()){
+		channel_.disableWriting();
+	}
+	//握手的最后一个记录后面可能紧跟着应用数据，已经被OpenSSL读走，socket不会再有读事件
+	if(tls_->hasPending()){
+		handleRead(Timestamp::now());
+	}
 }
 
 //连接销毁
 void TcpConnection::connectDestoryed(){
+	if(relay_){
+		relay_->handleClose(this);
+		relay_.reset();
+	}
 	if(state_==kConnected){
 		setState(kDisconnected);
-		channel_->disableAll();  //把channel所有感兴趣的事件，从poller中删除
-		connectionCallback_(shared_from_this());
+		channel_.disableAll();  //把channel所有感兴趣的事件，从poller中删除
+		if(!tlsHandshaking_){	//TLS握手没完成时用户没见过这条连接
+			connectionCallback_(shared_from_this());
+		}
 	}
-	channel_->remove();//把channel从poller删除
+	updateOutputBytes();
+	channel_.remove();//把channel从poller删除
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime){
+	if(hasZeroCopyInflight()){
+		handleZeroCopyCompletion();
+	}
+	if(relay_){
+		relay_->handleRead(this);
+		return;
+	}
+	if(tlsHandshaking_){
+		continueHandshake();
+		return;
+	}
 	int saveErrno=0;
-	ssize_t n=inputBuffer_.readFd(channel_->fd(),&saveErrno);
+	ssize_t n=0;
+	if(tls_){
+		//kTLS接收方向也走SSL_read：内核遇到会话票据、KeyUpdate、alert这些非应用数据记录时read会返回EIO，
+		//OpenSSL用recvmsg取出记录类型自己处理，应用数据仍然由内核解密
+		n=tls_->readInto(&inputBuffer_,&saveErrno);
+	}
+	else{
+		n=receiveFds_?readWithFds(&saveErrno):inputBuffer_.readFd(channel_.fd(),&saveErrno);
+	}
 	if(n>0){
-		messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+		if(borrowedMessageCallback_){
+			borrowedMessageCallback_(*this,&inputBuffer_,receiveTime);
+		}
+		else{
+			messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+		}
 	}
 	else if(n==0){
 		handleClose();
 	}
+	else if(saveErrno==EWOULDBLOCK&&tls_){
+		//只收到半个TLS记录或者握手后的会话票据，没有应用数据
+	}
 	else{
 		errno=saveErrno;
 		LOG_ERROR("TcpConnection::handleRead\n");
 		handleError();
+		if(tls_){	//TLS出错以后连接不能再用
+			handleClose();
+		}
 	}
 }
 
-void TcpConnection::handleWrite(){
-	if(channel_->isWriting()){
-		int savedErrno=0;
-		ssize_t n=outputBuffer_.writeFd(channel_->fd(),&savedErrno);
-		if(n>0){
-			outputBuffer_.retrieve(n);
-			if(outputBuffer_.readableBytes()==0){
-				channel_->disableWriting();
-				if(writeCompleteCallback_){
-					loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+//和readFd一样读进inputBuffer_，同时收下SCM_RIGHTS传来的fd
+ssize_t TcpConnection::readWithFds(int* savedErrno){
+	static const size_t kReadSize=16*1024;
+	inputBuffer_.ensureWritableBytes(kReadSize);
+	struct iovec iov;
+	iov.iov_base=inputBuffer_.beginWrite();
+	iov.iov_len=inputBuffer_.wirtableBytes();
+	char control[CMSG_SPACE(sizeof(int)*kMaxFds)];
+	struct msghdr msg;
+	::bzero(&msg,sizeof(msg));
+	msg.msg_iov=&iov;
+	msg.msg_iovlen=1;
+	msg.msg_control=control;
+	msg.msg_controllen=sizeof(control);
+	ssize_t n=::recvmsg(channel_.fd(),&msg,MSG_CMSG_CLOEXEC);
+	if(n<0){
+		*savedErrno=errno;
+		return n;
+	}
+	if(msg.msg_flags&MSG_CTRUNC){
+		LOG_ERROR("TcpConnection::readWithFds [#%llu] control data truncated, fds lost\n",static_cast<unsigned long long>(id_));
+	}
+	for(struct cmsghdr* cmsg=CMSG_FIRSTHDR(&msg);cmsg!=nullptr;cmsg=CMSG_NXTHDR(&msg,cmsg)){
+		if(cmsg->cmsg_level==SOL_SOCKET&&cmsg->cmsg_type==SCM_RIGHTS){
+			const size_t count=(cmsg->cmsg_len-CMSG_LEN(0))/sizeof(int);
+			const size_t old=receivedFds_.size();
+			receivedFds_.resize(old+count);
+			::memcpy(&receivedFds_[old],CMSG_DATA(cmsg),count*sizeof(int));
+		}
+	}
+	inputBuffer_.hasWritten(n);
+	return n;
+}
+
+//outputBuffer_和后面的内存分片合并成一次writev，写出的字节先从outputBuffer_里扣
+ssize_t TcpConnection::writeGather(PendingChunk& chunk){
+	struct iovec iov[2];
+	iov[0].iov_base=const_cast<char*>(outputBuffer_.peek());
+	iov[0].iov_len=outputBuffer_.readableBytes();
+	iov[1].iov_base=const_cast<char*>(chunk.data);
+	iov[1].iov_len=chunk.remaining;
+	ssize_t n=::writev(channel_.fd(),iov,2);
+	if(n>0){
+		const size_t head=std::min(static_cast<size_t>(n),iov[0].iov_len);
+		outputBuffer_.retrieve(head);
+		chunk.data+=n-head;
+		chunk.remaining-=n-head;
+	}
+	return n;
+}
+
+bool TcpConnection::drainOutput(){
+	//按顺序发送outputBuffer_和排队的分片，直到全部发完或者内核发送缓冲区写满
+	while(true){
+		if(outputBuffer_.readableBytes()>0){
+			//后面紧跟着普通内存分片时一起writev，例如HTTP响应头和mmap的文件内容
+			const bool gather=!tlsUserTx_&&!pendingChunks_.empty()&&pendingChunks_.front().kind==PendingChunk::kMemory;
+			ssize_t n=gather?writeGather(pendingChunks_.front()):writeRaw(outputBuffer_.peek(),outputBuffer_.readableBytes());
+			if(n>0){
+				lastWriteProgress_=loop_->pollReturnTime();
+				if(!gather){
+					outputBuffer_.retrieve(n);
+				}
+				if(outputBuffer_.readableBytes()>0){
+					return false;
 				}
-				if(state_==kDisconnecting){
-					shutdownInLoop();
+			}
+			else{
+				if(errno!=EWOULDBLOCK){
+					LOG_ERROR("TcpConnection::handleWrite\n");
 				}
+				return false;
 			}
 		}
+		else if(!pendingChunks_.empty()){
+			PendingChunk& chunk=pendingChunks_.front();
+			ssize_t n=chunk.remaining>0?writeChunk(chunk):1;	//已经随前面的数据一起writev完了
+			if(n>0){
+				lastWriteProgress_=loop_->pollReturnTime();
+			}
+			else if(n==0){
+				LOG_ERROR("TcpConnection::handleWrite fd=%d reach EOF with %zu bytes left\n",chunk.fd,chunk.remaining);
+				chunk.remaining=0;
+			}
+			else if(n<0){
+				if(errno!=EWOULDBLOCK){
+					LOG_ERROR("TcpConnection::handleWrite chunk\n");
+				}
+				return false;
+			}
+			if(chunk.remaining>0){
+				return false;
+			}
+			//分片发完，接着发送它后面的数据
+			outputBuffer_.swap(chunk.trailer);
+			finishChunk(chunk);
+			pendingChunks_.pop_front();
+		}
 		else{
-			LOG_ERROR("TcpConnection::handleWrite\n");
+			return true;
+		}
+	}
+}
+
+void TcpConnection::handleWrite(){
+	if(tlsHandshaking_){
+		continueHandshake();
+		return;
+	}
+	if(channel_.isWriting()){
+		bool done=drainOutput();
+		updateOutputBytes();
+		checkLowWaterMark();
+		if(done){
+			if(relay_){	//普通数据发完，继续转发pipe里的数据
+				relay_->handleWrite(this);
+				return;
+			}
+			channel_.disableWriting();
+			if(writeCompleteCallback_){
+				queueWriteComplete();
+			}
+			if(state_==kDisconnecting){
+				shutdownInLoop();
+			}
+		}
+	}
+	else{
+		LOG_ERROR("TcpConnection fd=%d is down , no more writing \n",channel_.fd());
+	}
+}
+
+ssize_t TcpConnection::writeRaw(const void* data,size_t len){
+	if(tlsUserTx_){
+		return tls_->write(data,len);
+	}
+	return ::write(channel_.fd(),data,len);
+}
+
+//前面有还没写出的数据时，它们在等commitOutput或者autoCork的本轮结束，排在后面的分片由那里一起写出，
+//不注册写事件，否则commitOutput看到isWriting就只能等下一次EPOLLOUT
+void TcpConnection::enableWritingUnlessDeferred(){
+	if(!channel_.isWriting()&&outputBuffer_.readableBytes()==0){
+		channel_.enableWriting();
+	}
+}
+
+void TcpConnection::commitOutput(){
+	if(state_==kDisconnected){
+		return;
+	}
+	//outputBytes_是上一次同步时的待发送字节数，差值就是outputTail()追加的数据
+	const size_t old=outputBytes_.load(std::memory_order_relaxed);
+	const size_t bytes=bufferedBytes();
+	if(bytes>old){
+		if(!onOutputQueued(old,bytes-old)){
+			return;
+		}
+		updateOutputBytes();
+	}
+	//sendShared/sendFile排在未提交的数据后面时已经计入了outputBytes_，也要在这里写出
+	if(bytes==0||channel_.isWriting()||corkPending_){
+		return;
+	}
+	if(autoCork_){
+		corkPending_=true;
+		loop_->runAtIterationEnd(std::bind(&TcpConnection::flushCorked,shared_from_this()));
+	}
+	else{
+		writeQueued();
+	}
+}
+
+//本轮事件循环结束，把auto-cork攒下的数据一次写出
+void TcpConnection::flushCorked(){
+	corkPending_=false;
+	writeQueued();
+}
+
+void TcpConnection::writeQueued(){
+	//已经注册了写事件的话由handleWrite继续发送，TLS握手期间等握手完成再发
+	if(state_==kDisconnected||channel_.isWriting()||tlsHandshaking_){
+		return;
+	}
+	bool done=drainOutput();
+	updateOutputBytes();
+	checkLowWaterMark();
+	if(done){
+		if(writeCompleteCallback_){
+			queueWriteComplete();
+		}
+		if(state_==kDisconnecting){
+			shutdownInLoop();
 		}
 	}
 	else{
-		LOG_ERROR("TcpConnection fd=%d is down , no more writing \n",channel_->fd());
+		channel_.enableWriting();
 	}
 }
 
 void TcpConnection::handleClose(){
-	LOG_INFO("fd=%d state=%d \n",channel_->fd(),(int)state_);
+	LOG_INFO("fd=%d state=%d \n",channel_.fd(),(int)state_);
 	setState(kDisconnected);
-	channel_->disableAll();
+	channel_.disableAll();
+	updateOutputBytes();	//待发送的数据不会再发出，从总预算里扣除
 
 	TcpConnectionPtr connPtr(shared_from_this());
-	connectionCallback_(connPtr);
+	if(relay_){
+		std::shared_ptr<SpliceRelay> relay;
+		relay.swap(relay_);
+		relay->handleClose(this);
+	}
+	if(!tlsHandshaking_){
+		connectionCallback_(connPtr);
+	}
 	closeCallback_(connPtr);
 }
 
 void TcpConnection::handleError(){
+	//MSG_ZEROCOPY的完成通知也会触发EPOLLERR
+	bool completion=hasZeroCopyInflight()&&handleZeroCopyCompletion();
 	int optval;
 	socklen_t optlen=sizeof(optval);
 	int err=0;
-	if(::getsockopt(channel_->fd(),SOL_SOCKET,SO_ERROR,&optval,&optlen)<0){
+	if(::getsockopt(channel_.fd(),SOL_SOCKET,SO_ERROR,&optval,&optlen)<0){
 		err=errno;
 	}
 	else{
 		err=optval;
 	}
-	LOG_ERROR("TcpConnection::handleError name=%s -SO_ERROR=%d \n",name_.c_str(),err);
+	if(completion&&err==0){
+		return;
+	}
+	LOG_ERROR("TcpConnection::handleError id=%llu -SO_ERROR=%d \n",static_cast<unsigned long long>(id_),err);
 }
\ No newline at end of file
@@ -2,16 +2,27 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
 
 #include "Buffer.hpp"
 #include "noncopyable.hpp"
 #include "InetAddress.hpp"
 #include "Callbacks.hpp"
 #include "Timestamp.hpp"
+#include "OutputGuard.hpp"
+#include "ConnectionContext.hpp"
+#include "Socket.hpp"
+#include "Channel.hpp"
+#include "MemoryPool.hpp"
 
-class Channel;
 class EventLoop;
-class Socket;
+class SpliceRelay;
+class TlsContext;
+class TlsStream;
 
 /*
 TcpServer通过Acceptor监听到一个新用户连接时，通过accept()函数拿到connfd
@@ -25,20 +36,83 @@ public:
 				,int sockfd
 				,const InetAddress& localAddr
 				,const InetAddress& peerAddr);
+	//TcpServer使用：名字在第一次调用name()时才由namePrefix和id拼出来
+	TcpConnection(EventLoop* loop
+				,uint64_t id
+				,const std::shared_ptr<const std::string>& namePrefix
+				,int sockfd
+				,const InetAddress& localAddr
+				,const InetAddress& peerAddr);
 	~TcpConnection();
 	EventLoop* getLoop()const{return loop_;}
-	const std::string& name()const{return name_;}
+	uint64_t id()const{return id_;}
+	const std::string& name()const;
 	const InetAddress& localAddress()const{return localAddr_;}
 	const InetAddress& peerAddress()const{return peerAddr_;}
 
 	bool connected()const {return state_==kConnected;}
 
+	//跨线程调用时，右值版本把数据移动进loop的任务里，其它版本拷贝一次；在loop线程里则直接从调用方的内存发送
 	void send(const std::string& buf);
-	//void send(const void *message,int len);
+	void send(std::string&& buf);
+	void send(const void* data,size_t len);
+	void send(Buffer* buf);	//发送buf里所有可读数据，调用后buf被清空
+	void send(Buffer&& buf);
+	//用sendfile发送fd的[offset,offset+length)，和send的数据按调用顺序发出
+	//文件数据不经过用户态；fd由调用方持有，writeCompleteCallback之前不能关闭
+	void sendFile(int fd,off_t offset,size_t length);
+	//owner持有fd(例如文件缓存的条目)，这段文件发完以前连接一直持有owner，fd不会在发送途中被关闭
+	void sendFile(int fd,off_t offset,size_t length,const std::shared_ptr<void>& owner);
+	//在loop线程里发送owner持有的内存(例如mmap的文件)，不拷贝进outputBuffer_，发完以前连接一直持有owner
+	//前面排着outputBuffer_里的数据时两者合并成一次writev
+	void sendShared(const std::shared_ptr<void>& owner,const char* data,size_t len);
 	void shutdown();
+	void forceClose();	//不等待数据发完，直接关闭连接
+	void setTcpNoDelay(bool on);
+
+	//AF_UNIX连接上用SCM_RIGHTS随data一起传递fd，len必须大于0，一次最多kMaxFds个
+	//fd在调用时dup，调用方随后可以关闭自己的fd；和send的数据按调用顺序发出，对端收到这段数据的第一个字节时同时收到fd
+	static const size_t kMaxFds=253;
+	void sendFds(const int* fds,size_t count,const void* data,size_t len);
+	//开启后改用recvmsg读取，收到的fd暂存在连接里，需要在loop线程里调用
+	void setReceiveFds(bool on){receiveFds_=on;}
+	//在消息回调里取走已经收到的fd，之后由调用方负责关闭；没有取走的fd在连接析构时关闭
+	std::vector<int> takeReceivedFds(){
+		std::vector<int> fds;
+		fds.swap(receivedFds_);
+		return fds;
+	}
+
+	static const size_t kDefaultZeroCopyThreshold=64*1024;
+	//不小于threshold字节、且内存已交给连接的数据(send(std::string&&)/send(Buffer*)/send(Buffer&&)以及跨线程的send)
+	//使用MSG_ZEROCOPY发送，数据由连接持有直到内核通知完成。socket不支持时返回false，需要在loop线程里调用
+	bool setZeroCopy(bool on,size_t threshold=kDefaultZeroCopyThreshold);
+	bool zeroCopy()const{return zeroCopy_;}
+
+	//在loop线程里直接往待发送数据的末尾追加(例如HTTP响应头)，省掉send的一次拷贝
+	//可以连续追加多段，之后调用一次commitOutput()统一检查上限和水位并发送
+	Buffer* outputTail(){return tailBuffer();}
+	void commitOutput();
+
+	//在连接上启用TLS，必须在connectEstablished之前调用，TcpServer/TcpClient设置了TlsContext时会自动调用
+	//握手在loop里非阻塞进行，完成以后才回调ConnectionCallback；serverName用于客户端的SNI和证书校验
+	//握手以后内核接管了发送方向(kTLS)时仍然走write/sendfile，否则退回SSL_write；接收总是走SSL_read，kTLS时由内核解密
+	//TLS连接上不能使用MSG_ZEROCOPY和sendFds，用户态TLS的连接不能交给SpliceRelay
+	bool startTls(const std::shared_ptr<TlsContext>& context,const std::string& serverName=std::string());
+	bool tlsEnabled()const{return static_cast<bool>(tls_);}
+	//握手完成以后有效，用来确认是否真的用上了kTLS
+	bool kernelTlsTx()const{return tls_&&!tlsHandshaking_&&!tlsUserTx_;}
+	bool kernelTlsRx()const{return tls_&&!tlsHandshaking_&&!tlsUserRx_;}
+
+	//开启后同一轮事件循环里的多次send只追加到outputBuffer_，在本轮结束、poll休眠之前合并成一次写，需要在loop线程里调用
+	void setAutoCork(bool on){autoCork_=on;}
+	bool autoCork()const{return autoCork_;}
 
 	void setConnectionCallback(const ConnectionCallback& cb){connectionCallback_=cb;}
 	void setMessageCallback(const MessageCallback& cb){messageCallback_=cb;}
+	//设置后代替MessageCallback：每条消息不再调用shared_from_this()，Channel::tie在分发期间保证连接存活
+	//回调之外还要使用连接(例如交给其它线程)时，在回调里调用conn.shared_from_this()
+	void setBorrowedMessageCallback(const BorrowedMessageCallback& cb){borrowedMessageCallback_=cb;}
 	void setWriteCompleteCallback(const WriteCompleteCallback& cb){writeCompleteCallback_=cb;}
 	void setCloseCallback(const CloseCallback& cb){closeCallback_=cb;}
 	void setHighWaterMarkCallback(const HighWaterMarkCallback& cb,size_t highWaterMark)
@@ -46,6 +120,36 @@ public:
 		highWaterMarkCallback_=cb;
 		highWaterMark_=highWaterMark;
 	}
+	//触发过高水位以后，待发送数据降到lowWaterMark及以下时回调，和HighWaterMarkCallback配对做流量控制
+	void setLowWaterMarkCallback(const LowWaterMarkCallback& cb,size_t lowWaterMark)
+	{
+		lowWaterMarkCallback_=cb;
+		lowWaterMark_=lowWaterMark;
+	}
+
+	//开启/停止关注读事件，停止后数据留在内核的接收缓冲区里，由TCP把背压传给对端
+	void startRead();
+	void stopRead();
+	bool isReading()const{return reading_;}
+
+	//慢消费者保护，0表示不限制：待发送数据超过maxBytes，或者有待发送数据却超过timeoutMs毫秒没有写出任何字节时强制关闭连接
+	void setMaxOutputBytes(size_t maxBytes){maxOutputBytes_=maxBytes;}
+	void setWriteTimeout(int timeoutMs){writeTimeoutMs_=timeoutMs;}
+	//由TcpServer设置，用于统计总的待发送字节数和驱逐次数
+	void setOutputGuard(const std::shared_ptr<OutputGuard>& guard){guard_=guard;}
+	//待发送的字节数，可以在其它线程读取
+	size_t outputBytes()const{return outputBytes_.load(std::memory_order_relaxed);}
+	//因为reason强制关闭连接并计数，线程安全
+	void evict(OutputGuard::Reason reason);
+
+	//连接上的用户状态，和连接对象一起分配和销毁，只能在loop线程里访问
+	//例如 conn->setContext<HttpContext>() 之后每条消息里 conn->getContext<HttpContext>()
+	template<typename T,typename... Args>
+	T& setContext(Args&&... args){return context_.emplace<T>(std::forward<Args>(args)...);}
+	template<typename T>
+	T* getContext(){return context_.get<T>();}
+	void clearContext(){context_.reset();}
+	ConnectionContext& context(){return context_;}
 
 	//连接建立
 	void connectEstablished();
@@ -53,6 +157,8 @@ public:
 	void connectDestoryed();
 	
 private:
+	friend class SpliceRelay;
+
 	enum StateE{kDisconnected,kConnecting,kConnected,kDisconnecting};
 	void setState(StateE state){state_=state;}
 	
@@ -63,27 +169,139 @@ private:
 
 	
 	void sendInLoop(const void* data,size_t len);
+	void sendStringInLoop(std::string& buf);
+	void sendBufferInLoop(Buffer& buf);
+	void sendFileInLoop(int fd,off_t offset,size_t length,const std::shared_ptr<void>& owner);
+	//owner持有的内存作为分片发送，zeroCopy为true时用MSG_ZEROCOPY
+	void sendOwnedInLoop(const std::shared_ptr<void>& owner,const char* data,size_t len,bool zeroCopy);
+	void sendFdsInLoop(const std::shared_ptr<std::string>& payload,std::vector<int>& fds);
+	ssize_t readWithFds(int* savedErrno);
+	bool useZeroCopy(size_t len)const{return zeroCopy_&&len>=zeroCopyThreshold_;}
+	//返回最后一段待发送数据所在的Buffer，有分片排队时是队尾分片的trailer
+	Buffer* tailBuffer(){return pendingChunks_.empty()?&outputBuffer_:&pendingChunks_.back().trailer;}
+	size_t bufferedBytes()const;
+
+	struct PendingChunk;
+	ssize_t writeChunk(PendingChunk& chunk);
+	ssize_t writeGather(PendingChunk& chunk);
+	void finishChunk(PendingChunk& chunk);
+	//读取错误队列中的MSG_ZEROCOPY完成通知，返回是否读到了通知
+	bool handleZeroCopyCompletion();
+	void completeZeroCopy(uint32_t lo,uint32_t hi);
+	bool hasZeroCopyInflight()const{return zeroCopyNextId_!=zeroCopyCompleted_;}
 	void shutdownInLoop();
+	void forceCloseInLoop();
+	void startReadInLoop();
+	void stopReadInLoop();
+	//新增added字节待发送数据之前调用：检查上限、高水位并启动写超时定时器，返回false表示连接已被驱逐
+	bool onOutputQueued(size_t oldLen,size_t added);
+	void checkLowWaterMark();
+	void queueWriteComplete();
+	//同步outputBytes_以及OutputGuard里的总字节数
+	void updateOutputBytes();
+	void armWriteTimer(double seconds);
+	void checkWriteTimeout();
+	//尽量把outputBuffer_和排队的分片写进内核，全部写完返回true
+	bool drainOutput();
+	//在loop里排队了分片以后调用
+	void enableWritingUnlessDeferred();
+	void flushCorked();
+	//尝试立即发送排队的数据，没发完就关注写事件
+	void writeQueued();
+	//写进socket或者用户态TLS，返回值和errno同write
+	ssize_t writeRaw(const void* data,size_t len);
+	void continueHandshake();
+	//用户态TLS或者握手期间数据不能直接写socket
+	bool directWrite()const{return !tlsHandshaking_&&!tlsUserTx_;}
 
 	EventLoop* loop_;  //这里绝对不是baseloop，因为TcpConnection都是在subloop里管理的
-	const std::string name_;
+	const uint64_t id_;	//TcpServer内唯一的连接id，直接构造的连接为0
+	std::shared_ptr<const std::string> namePrefix_;
+	mutable std::string name_;
+	mutable std::once_flag nameOnce_;
 	std::atomic_int state_;
 	bool reading_;
 
-	std::unique_ptr<Socket> socket_;
-	std::unique_ptr<Channel> channel_;
+	//和连接对象分配在一起，不单独new
+	Socket socket_;
+	Channel channel_;
 
 	const InetAddress localAddr_;
 	const InetAddress peerAddr_;
 
 	ConnectionCallback connectionCallback_;	//有新连接时的回调
 	MessageCallback messageCallback_;	//有读写消息的回调
+	BorrowedMessageCallback borrowedMessageCallback_;
 	WriteCompleteCallback writeCompleteCallback_; 	//消息发送完成以后的回调
 	HighWaterMarkCallback highWaterMarkCallback_;
 	CloseCallback closeCallback_;
 	size_t highWaterMark_;
+	LowWaterMarkCallback lowWaterMarkCallback_;
+	size_t lowWaterMark_;
+	bool aboveHighWaterMark_;	//越过高水位以后还没有降到低水位
+
+	size_t maxOutputBytes_;
+	int writeTimeoutMs_;
+	bool writeTimerArmed_;
+	Timestamp lastWriteProgress_;	//最近一次写出数据的时间
+	std::atomic<size_t> outputBytes_;
+	std::shared_ptr<OutputGuard> guard_;
 
+	std::shared_ptr<MemoryPool> memoryPool_;	//最后一个TcpConnectionPtr可能在loop析构以后才释放，池由连接自己持有
 	Buffer inputBuffer_;
 	Buffer outputBuffer_;
 
+	//排在outputBuffer_之后、不经过Buffer拷贝的待发送分片：sendfile的文件片段、MSG_ZEROCOPY的数据块、带fd的数据或者别人持有的内存
+	//trailer保存该分片之后send的数据
+	struct PendingChunk{
+		enum Kind{kFile,kZeroCopy,kFds,kMemory};
+		PendingChunk(int fdArg,off_t offsetArg,size_t remainingArg,const std::shared_ptr<void>& ownerArg)
+			:kind(kFile),fd(fdArg),offset(offsetArg),owner(ownerArg),data(nullptr),remaining(remainingArg)
+			,zeroCopied(false),lastId(0),trailer(0){}
+		PendingChunk(Kind kindArg,const std::shared_ptr<void>& ownerArg,const char* dataArg,size_t remainingArg)
+			:kind(kindArg),fd(-1),offset(0),owner(ownerArg),data(dataArg),remaining(remainingArg)
+			,zeroCopied(false),lastId(0),trailer(0){}
+		PendingChunk(const std::shared_ptr<void>& ownerArg,const char* dataArg,size_t remainingArg,std::vector<int>&& fdsArg)
+			:kind(kFds),fd(-1),offset(0),owner(ownerArg),data(dataArg),remaining(remainingArg)
+			,zeroCopied(false),lastId(0),fds(std::move(fdsArg)),trailer(0){}
+		Kind kind;
+		int fd;
+		off_t offset;
+		std::shared_ptr<void> owner;	//数据或者fd的持有者
+		const char* data;
+		size_t remaining;
+		bool zeroCopied;	//是否至少有一次以MSG_ZEROCOPY发出
+		uint32_t lastId;	//最后一次MSG_ZEROCOPY发送的序号
+		std::vector<int> fds;	//还没有发出的fd，随第一次发送的数据一起交给内核
+		Buffer trailer;
+	};
+	std::deque<PendingChunk,PoolAllocator<PendingChunk>> pendingChunks_;	//deque构造时就会分配，所以也从内存池分配
+
+	bool zeroCopy_;
+	size_t zeroCopyThreshold_;
+	uint32_t zeroCopyNextId_;	//下一次MSG_ZEROCOPY发送的序号，和内核的计数保持一致
+	uint32_t zeroCopyCompleted_;	//小于该值的序号都已经完成
+	std::vector<std::pair<uint32_t,uint32_t>> zeroCopyRanges_;	//乱序到达、还不能合并的完成区间
+	//已经发出、等待内核完成通知的数据块
+	struct ZeroCopyBlock{
+		uint32_t lastId;
+		std::shared_ptr<void> owner;
+	};
+	std::deque<ZeroCopyBlock,PoolAllocator<ZeroCopyBlock>> zeroCopyInflight_;
+
+	bool autoCork_;
+	bool corkPending_;	//已经注册了本轮结束时的flush
+
+	ConnectionContext context_;
+
+	bool receiveFds_;
+	std::vector<int> receivedFds_;	//收到还没有被取走的fd
+
+	std::shared_ptr<SpliceRelay> relay_;	//非空表示处于splice中继模式，读写事件交给relay处理
+
+	std::unique_ptr<TlsStream> tls_;
+	bool tlsHandshaking_;	//握手还没完成，读写事件用来推进握手
+	bool tlsUserTx_;	//发送方向没有kTLS，走SSL_write
+	bool tlsUserRx_;	//接收方向没有kTLS，由OpenSSL解密
+
 };
\ No newline at end of file
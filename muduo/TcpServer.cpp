@@ -3,6 +3,8 @@
 
 #include <functional>
 #include <strings.h>
+#include <algorithm>
+#include <vector>
 
 static EventLoop* CheckNotNull(EventLoop* loop){
 	if(loop==nullptr){
@@ -17,20 +19,42 @@ TcpServer::TcpServer(EventLoop* loop,const InetAddress& listenAddr,const std::st
 	:loop_(CheckNotNull(loop))
 	,ipPort_(listenAddr.toIpPort())
 	,name_(nameArg)
+	,connNamePrefix_(std::make_shared<const std::string>(nameArg+"-"+ipPort_))
 	,acceptor_(new Acceptor(loop,listenAddr,option==kReusePort))
 	,threadPool_(new EventLoopThreadPool(loop,name_))
-	,connectionCallback_()
-	,messageCallback_()
-	,nextConnId_(1)
+	,connectionCallback_(defaultConnectionCallback)
+	,messageCallback_(defaultMessageCallback)
 	,started_(0)
+	,nextConnId_(1)
+	,connections_(0,std::hash<uint64_t>(),std::equal_to<uint64_t>(),
+		PoolAllocator<std::pair<const uint64_t,TcpConnectionPtr>>(loop->memoryPool()))
+	,outputGuard_(std::make_shared<OutputGuard>())
+	,alive_(this,[](TcpServer*){})
+	,maxOutputBytes_(0)
+	,writeTimeoutMs_(0)
 {
 	//当有用户连接，会执行TcpServer::newConnection回调
 	acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,this,
 		std::placeholders::_1,std::placeholders::_2));
-
+	//任意subloop里的连接发现总预算超限时通知baseloop驱逐
+	//回调可能已经在subloop里复制出去、驱逐任务可能已经在排队，都只持有weak_ptr，TcpServer析构以后什么也不做
+	std::weak_ptr<TcpServer> weakServer(alive_);
+	outputGuard_->setOverBudgetCallback([loop,weakServer](){
+		if(weakServer.expired()){
+			return;
+		}
+		loop->queueInLoop([weakServer](){
+			std::shared_ptr<TcpServer> server=weakServer.lock();	//和析构都在baseloop线程，检查以后不会再失效
+			if(server){
+				server->evictOverBudgetInLoop();
+			}
+		});
+	});
 }
 
 TcpServer::~TcpServer(){
+	alive_.reset();
+	outputGuard_->setOverBudgetCallback(OutputGuard::OverBudgetCallback());
 	for(auto& item:connections_){
 		TcpConnectionPtr conn(item.second);
 		item.second.reset();
@@ -54,32 +78,40 @@ void TcpServer::start(){
 void TcpServer::newConnection(int sockfd,const InetAddress& peerAddr){
 	//轮询算法选择一个subloop来管理channel
 	EventLoop* ioLoop=threadPool_->getNextLoop();
-	char buf[64]={0};
-	snprintf(buf,sizeof(buf),"-%s#%d",ipPort_.c_str(),nextConnId_);
-	++nextConnId_;
-	std::string connName=name_+buf;
+	const uint64_t connId=nextConnId_++;
 
-	LOG_INFO("TcpServer::newConnection [%s]=new connection [%s] from %s\n",
-		name_.c_str(),connName.c_str(),peerAddr.toIpPort().c_str());
+	LOG_INFO("TcpServer::newConnection [%s]=new connection [#%llu] fd=%d\n",
+		name_.c_str(),static_cast<unsigned long long>(connId),sockfd);
 	
-	struct sockaddr_in local;
+	struct sockaddr_storage local;
 	::bzero(&local,sizeof(local));
 	socklen_t addrlen=sizeof(local);
 	if(::getsockname(sockfd,(sockaddr*)&local,&addrlen)<0){
 		LOG_ERROR("sockets::getlocalAddr\n");
 	}
-	InetAddress localAddr(local);
+	InetAddress localAddr;
+	localAddr.setSockAddr((sockaddr*)&local,addrlen);
 
-	//根据连接成功的sockfd创建TcpConnection连接对象
-	TcpConnectionPtr conn(new TcpConnection(ioLoop,connName,sockfd,localAddr,peerAddr));
+	//根据连接成功的sockfd创建TcpConnection连接对象，对象和shared_ptr的控制块一次从subloop的内存池分配
+	TcpConnectionPtr conn=std::allocate_shared<TcpConnection>(PoolAllocator<TcpConnection>(ioLoop->memoryPool()),
+		ioLoop,connId,connNamePrefix_,sockfd,localAddr,peerAddr);
 
-	connections_[connName]=conn;
+	connections_[connId]=conn;
 	//下面的回调都是用户设置给TcpServer=》TcpConnection=》Channel=》Poller最后通知channel调用回调
 	conn->setConnectionCallback(connectionCallback_);
 	conn->setMessageCallback(messageCallback_);
+	conn->setBorrowedMessageCallback(borrowedMessageCallback_);
 	conn->setWriteCompleteCallback(writeCompleteCallback_);
+	conn->setOutputGuard(outputGuard_);
+	conn->setMaxOutputBytes(maxOutputBytes_);
+	conn->setWriteTimeout(writeTimeoutMs_);
+	if(tlsContext_&&!conn->startTls(tlsContext_)){
+		LOG_ERROR("TcpServer::newConnection [%s] start TLS failed, drop #%llu\n",name_.c_str(),static_cast<unsigned long long>(connId));
+		connections_.erase(connId);	//连接析构时关闭sockfd
+		return;
+	}
 
-	conn->setCloseCallback(std::bind(&TcpServer::removeConnection,this,std::placeholders::_1));
+	conn->setCloseCallback([this](const TcpConnectionPtr& connPtr){ removeConnection(connPtr); });
 
 	//直接调用TcpConnection::connectEstablished
 	ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished,conn));
@@ -92,9 +124,40 @@ void TcpServer::removeConnection(const TcpConnectionPtr& conn){
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn){
-	LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",name_.c_str(),conn->name().c_str());
-	connections_.erase(conn->name());
+	LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection #%llu\n",name_.c_str(),static_cast<unsigned long long>(conn->id()));
+	connections_.erase(conn->id());
 	EventLoop* ioLoop=conn->getLoop();
 	ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestoryed,conn));
 
 }
+
+
+//按待发送字节数从大到小强制关闭连接，直到总量回到预算以内
+void TcpServer::evictOverBudgetInLoop(){
+	const size_t budget=outputGuard_->budget();
+	size_t used=outputGuard_->used();
+	if(budget>0&&used>budget){
+		std::vector<std::pair<size_t,TcpConnectionPtr>> offenders;
+		for(auto& item:connections_){
+			size_t bytes=item.second->outputBytes();
+			if(bytes==0){
+				continue;
+			}
+			if(!item.second->connected()){	//已经在关闭中，它的字节很快会被扣除
+				used-=std::min(used,bytes);
+				continue;
+			}
+			offenders.push_back(std::make_pair(bytes,item.second));
+		}
+		std::sort(offenders.begin(),offenders.end(),
+			[](const std::pair<size_t,TcpConnectionPtr>& lhs,const std::pair<size_t,TcpConnectionPtr>& rhs){
+				return lhs.first>rhs.first;
+			});
+		for(size_t i=0;i<offenders.size()&&used>budget;++i){
+			offenders[i].second->evict(OutputGuard::kOverBudget);
+			used-=std::min(used,offenders[i].first);
+		}
+		LOG_INFO("TcpServer::evictOverBudgetInLoop [%s] used=%zu budget=%zu\n",name_.c_str(),outputGuard_->used(),budget);
+	}
+	outputGuard_->evictionDone();
+}
@@ -13,6 +13,9 @@
 #include "Callbacks.hpp"
 #include "TcpConnection.hpp"
 #include "Buffer.hpp"
+#include "OutputGuard.hpp"
+#include "MemoryPool.hpp"
+#include "TlsContext.hpp"
 
 class TcpServer:noncopyable{
 public:
@@ -27,38 +30,65 @@ public:
 	void setThreadInitCallback(const ThreadInitCallback& cb){threadInitCallback_=cb;}
 	void setConnectionCallback(const ConnectionCallback& cb){connectionCallback_=cb;}
 	void setMessageCallback(const MessageCallback& cb){messageCallback_=cb;}
+	//设置后代替MessageCallback，见TcpConnection::setBorrowedMessageCallback
+	void setBorrowedMessageCallback(const BorrowedMessageCallback& cb){borrowedMessageCallback_=cb;}
 	void setWriteCompleteCallback(const WriteCompleteCallback& cb){writeCompleteCallback_=cb;}
 
+	//慢消费者保护，对之后建立的连接生效，0表示不限制
+	void setMaxOutputBytes(size_t maxBytes){maxOutputBytes_=maxBytes;}
+	void setWriteTimeout(int timeoutMs){writeTimeoutMs_=timeoutMs;}
+	//所有连接待发送数据的总预算，超过时从积压最多的连接开始强制关闭
+	void setOutputBudget(size_t bytes){outputGuard_->setBudget(bytes);}
+	//总的待发送字节数以及各种原因的驱逐次数
+	const OutputGuard& outputGuard()const{return *outputGuard_;}
+
+	//设置以后新连接都先做TLS握手，见TcpConnection::startTls
+	void setTlsContext(const std::shared_ptr<TlsContext>& context){tlsContext_=context;}
+
 	//设置subloop的个数
 	void setThreadNum(int num);
 
 	//开启服务器监听
 	void start();
 
+	//start以后可以拿来构造BackendPool，让出站连接和入站连接在同一个loop上
+	std::shared_ptr<EventLoopThreadPool> threadPool()const{return threadPool_;}
+
 private:
 	void newConnection(int sockfd,const InetAddress& peerAddr);
 	void removeConnection(const TcpConnectionPtr& conn);
 	void removeConnectionInLoop(const TcpConnectionPtr& conn);
+	void evictOverBudgetInLoop();
 
-	using ConnectionMap=std::unordered_map<std::string,TcpConnectionPtr>;
+	//节点从baseloop的内存池分配
+	using ConnectionMap=std::unordered_map<uint64_t,TcpConnectionPtr,std::hash<uint64_t>,std::equal_to<uint64_t>,
+		PoolAllocator<std::pair<const uint64_t,TcpConnectionPtr>>>;
 
 	EventLoop* loop_;  //即baseloop
 
 	const std::string ipPort_;
 	const std::string name_;
+	std::shared_ptr<const std::string> connNamePrefix_;	//所有连接共享的名字前缀"name-ip:port"
 
 	std::unique_ptr<Acceptor> acceptor_;	//运行在mainloop，任务就是监听新事件的连接
 	std::shared_ptr<EventLoopThreadPool> threadPool_;	//one loop per thread指向线程池的智能指针
 
 	ConnectionCallback connectionCallback_;	//有新连接时的回调
 	MessageCallback messageCallback_;	//有读写消息的回调
+	BorrowedMessageCallback borrowedMessageCallback_;
 	WriteCompleteCallback writeCompleteCallback_; 	//消息发送完成以后的回调
 
 	ThreadInitCallback threadInitCallback_;	//线程初始化时候的回调
 
 	std::atomic_int started_;
 
-	int nextConnId_;
-	ConnectionMap connections_;	//	保存所有连接
+	uint64_t nextConnId_;
+	ConnectionMap connections_;	//	保存所有连接，key是连接id
+
+	std::shared_ptr<OutputGuard> outputGuard_;
+	std::shared_ptr<TcpServer> alive_;	//不拥有TcpServer，析构时最先reset，驱逐回调用它的weak_ptr判断TcpServer是否还在
+	size_t maxOutputBytes_;
+	int writeTimeoutMs_;
+	std::shared_ptr<TlsContext> tlsContext_;
 
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "CurrentThread.hpp"
 
 #include <semaphore.h>
+#include <stdio.h>
 
 std::atomic_int Thread::numCreated_(0);
 
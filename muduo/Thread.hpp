@@ -4,6 +4,7 @@
 #include <memory>
 #include <unistd.h>
 #include <atomic>
+#include <string>
 
 #include "noncopyable.hpp"
 
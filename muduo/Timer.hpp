@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "noncopyable.hpp"
+#include "Timestamp.hpp"
+#include "Callbacks.hpp"
+
+//定时器：到期时间、到期回调以及重复间隔
+class Timer:noncopyable{
+public:
+	Timer(TimerCallback cb,Timestamp when,double interval)
+		:callback_(std::move(cb))
+		,expiration_(when)
+		,interval_(interval)
+		,repeat_(interval>0.0)
+		,sequence_(++s_numCreated_){}
+
+	void run()const{callback_();}
+
+	Timestamp expiration()const{return expiration_;}
+	bool repeat()const{return repeat_;}
+	int64_t sequence()const{return sequence_;}
+
+	//重复定时器从now开始计算下一次到期时间
+	void restart(Timestamp now);
+
+	static int64_t numCreated(){return s_numCreated_;}
+private:
+	const TimerCallback callback_;
+	Timestamp expiration_;
+	const double interval_;
+	const bool repeat_;
+	const int64_t sequence_;	//用于区分地址相同的新旧定时器
+
+	static std::atomic<int64_t> s_numCreated_;
+};
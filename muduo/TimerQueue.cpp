@@ -0,0 +1,153 @@
+#include "TimerQueue.hpp"
+#include "Timer.hpp"
+#include "TimerId.hpp"
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <strings.h>
+#include <errno.h>
+#include <iterator>
+
+static int createTimerfd(){
+	int timerfd=::timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC);
+	if(timerfd<0){
+		LOG_FATAL("%s:%s:%d timerfd_create err:%d \n",__FILE__,__FUNCTION__,__LINE__,errno);
+	}
+	return timerfd;
+}
+
+//距离when还有多久，最少100微秒
+static struct timespec howMuchTimeFromNow(Timestamp when){
+	int64_t microseconds=when.microSecondsSinceEpoch()-Timestamp::now().microSecondsSinceEpoch();
+	if(microseconds<100){
+		microseconds=100;
+	}
+	struct timespec ts;
+	ts.tv_sec=static_cast<time_t>(microseconds/Timestamp::kMicroSecondsPerSecond);
+	ts.tv_nsec=static_cast<long>((microseconds%Timestamp::kMicroSecondsPerSecond)*1000);
+	return ts;
+}
+
+static void readTimerfd(int timerfd){
+	uint64_t howmany=0;
+	ssize_t n=::read(timerfd,&howmany,sizeof(howmany));
+	if(n!=sizeof(howmany)){
+		LOG_ERROR("TimerQueue::handleRead() reads %zd bytes instead of 8\n",n);
+	}
+}
+
+static void resetTimerfd(int timerfd,Timestamp expiration){
+	struct itimerspec newValue;
+	struct itimerspec oldValue;
+	::bzero(&newValue,sizeof(newValue));
+	::bzero(&oldValue,sizeof(oldValue));
+	newValue.it_value=howMuchTimeFromNow(expiration);
+	if(::timerfd_settime(timerfd,0,&newValue,&oldValue)<0){
+		LOG_ERROR("timerfd_settime err:%d\n",errno);
+	}
+}
+
+TimerQueue::TimerQueue(EventLoop* loop)
+	:loop_(loop)
+	,timerfd_(createTimerfd())
+	,timerfdChannel_(loop,timerfd_)
+	,callingExpiredTimers_(false)
+{
+	timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead,this));
+	timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue(){
+	timerfdChannel_.disableAll();
+	timerfdChannel_.remove();
+	::close(timerfd_);
+	for(const Entry& timer:timers_){
+		delete timer.second;
+	}
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb,Timestamp when,double interval){
+	Timer* timer=new Timer(std::move(cb),when,interval);
+	loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop,this,timer));
+	return TimerId(timer,timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId){
+	loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop,this,timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer* timer){
+	bool earliestChanged=insert(timer);
+	if(earliestChanged){
+		resetTimerfd(timerfd_,timer->expiration());
+	}
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId){
+	ActiveTimer timer(timerId.timer_,timerId.sequence_);
+	ActiveTimerSet::iterator it=activeTimers_.find(timer);
+	if(it!=activeTimers_.end()){
+		timers_.erase(Entry(it->first->expiration(),it->first));
+		delete it->first;
+		activeTimers_.erase(it);
+	}
+	else if(callingExpiredTimers_){	//正在执行的重复定时器在reset时不再重启
+		cancelingTimers_.insert(timer);
+	}
+}
+
+void TimerQueue::handleRead(){
+	Timestamp now(Timestamp::now());
+	readTimerfd(timerfd_);
+
+	std::vector<Entry> expired=getExpired(now);
+	callingExpiredTimers_=true;
+	cancelingTimers_.clear();
+	for(const Entry& it:expired){
+		it.second->run();
+	}
+	callingExpiredTimers_=false;
+	reset(expired,now);
+}
+
+std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now){
+	std::vector<Entry> expired;
+	Entry sentry(now,reinterpret_cast<Timer*>(UINTPTR_MAX));
+	TimerList::iterator end=timers_.lower_bound(sentry);
+	std::copy(timers_.begin(),end,std::back_inserter(expired));
+	timers_.erase(timers_.begin(),end);
+	for(const Entry& it:expired){
+		activeTimers_.erase(ActiveTimer(it.second,it.second->sequence()));
+	}
+	return expired;
+}
+
+void TimerQueue::reset(const std::vector<Entry>& expired,Timestamp now){
+	for(const Entry& it:expired){
+		ActiveTimer timer(it.second,it.second->sequence());
+		if(it.second->repeat()&&cancelingTimers_.find(timer)==cancelingTimers_.end()){
+			it.second->restart(now);
+			insert(it.second);
+		}
+		else{
+			delete it.second;
+		}
+	}
+	if(!timers_.empty()){
+		resetTimerfd(timerfd_,timers_.begin()->second->expiration());
+	}
+}
+
+bool TimerQueue::insert(Timer* timer){
+	bool earliestChanged=false;
+	Timestamp when=timer->expiration();
+	TimerList::iterator it=timers_.begin();
+	if(it==timers_.end()||when<it->first){
+		earliestChanged=true;
+	}
+	timers_.insert(Entry(when,timer));
+	activeTimers_.insert(ActiveTimer(timer,timer->sequence()));
+	return earliestChanged;
+}
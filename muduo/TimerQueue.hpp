@@ -0,0 +1,52 @@
+#pragma once
+#include <set>
+#include <vector>
+#include <utility>
+
+#include "noncopyable.hpp"
+#include "Timestamp.hpp"
+#include "Callbacks.hpp"
+#include "Channel.hpp"
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/*
+定时器队列：所有定时器共用一个timerfd，timerfd总是设置为最早到期的定时器的时间
+timerfd可读时由Channel回调handleRead，执行所有到期的定时器
+*/
+class TimerQueue:noncopyable{
+public:
+	explicit TimerQueue(EventLoop* loop);
+	~TimerQueue();
+
+	//线程安全，可以在其它线程调用
+	TimerId addTimer(TimerCallback cb,Timestamp when,double interval);
+	void cancel(TimerId timerId);
+private:
+	using Entry=std::pair<Timestamp,Timer*>;
+	using TimerList=std::set<Entry>;
+	using ActiveTimer=std::pair<Timer*,int64_t>;
+	using ActiveTimerSet=std::set<ActiveTimer>;
+
+	void addTimerInLoop(Timer* timer);
+	void cancelInLoop(TimerId timerId);
+	//timerfd可读时的回调
+	void handleRead();
+	//取出所有到期的定时器
+	std::vector<Entry> getExpired(Timestamp now);
+	//重启重复定时器，删除一次性的定时器
+	void reset(const std::vector<Entry>& expired,Timestamp now);
+	//插入定时器，返回最早到期的时间是否改变
+	bool insert(Timer* timer);
+
+	EventLoop* loop_;
+	const int timerfd_;
+	Channel timerfdChannel_;
+	TimerList timers_;	//按到期时间排序
+
+	ActiveTimerSet activeTimers_;	//和timers_保存相同的定时器，按地址排序，用于cancel
+	bool callingExpiredTimers_;
+	ActiveTimerSet cancelingTimers_;	//执行到期回调期间被取消的定时器
+};
@@ -1,22 +1,33 @@
 #include "Timestamp.hpp"
+
+#include <sys/time.h>
+
 Timestamp::Timestamp():microSecondsSinceEpoch_(0){}
 
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     :microSecondsSinceEpoch_(microSecondsSinceEpoch){}
 
 Timestamp Timestamp::now(){
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec)*kMicroSecondsPerSecond+tv.tv_usec);
 }
 
 std::string Timestamp::tostring() const{
     char buf[128]={0};
-    tm *tm_time=localtime(&microSecondsSinceEpoch_);
-    snprintf(buf,128,"%4d/%02d/%02d %02d:%02d:%02d",
-        tm_time->tm_year+1900,
-        tm_time->tm_mon+1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
+    format(buf,sizeof(buf));
     return buf;
 }
+
+void Timestamp::format(char* buf,size_t size) const{
+    time_t seconds=static_cast<time_t>(microSecondsSinceEpoch_/kMicroSecondsPerSecond);
+    struct tm tm_time;
+    localtime_r(&seconds,&tm_time);
+    snprintf(buf,size,"%4d/%02d/%02d %02d:%02d:%02d",
+        tm_time.tm_year+1900,
+        tm_time.tm_mon+1,
+        tm_time.tm_mday,
+        tm_time.tm_hour,
+        tm_time.tm_min,
+        tm_time.tm_sec);
+}
@@ -3,13 +3,40 @@
 #include <iostream>
 #include <string>
 #include <time.h>
+#include <stdint.h>
 class Timestamp{
 public:
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
     static Timestamp now();
     std::string tostring() const;
+    //格式化到调用方的缓冲区，不分配内存，日志使用
+    void format(char* buf,size_t size) const;
+    int64_t microSecondsSinceEpoch() const{return microSecondsSinceEpoch_;}
+    bool valid() const{return microSecondsSinceEpoch_>0;}
+
+    static const int kMicroSecondsPerSecond=1000*1000;
 private:
     int64_t microSecondsSinceEpoch_;
 
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs,Timestamp rhs){
+    return lhs.microSecondsSinceEpoch()<rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs,Timestamp rhs){
+    return lhs.microSecondsSinceEpoch()==rhs.microSecondsSinceEpoch();
+}
+
+//两个时间点相差的秒数
+inline double timeDifference(Timestamp high,Timestamp low){
+    int64_t diff=high.microSecondsSinceEpoch()-low.microSecondsSinceEpoch();
+    return static_cast<double>(diff)/Timestamp::kMicroSecondsPerSecond;
+}
+
+//在timestamp基础上增加seconds秒
+inline Timestamp addTime(Timestamp timestamp,double seconds){
+    int64_t delta=static_cast<int64_t>(seconds*Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch()+delta);
+}
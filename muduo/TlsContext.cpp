@@ -0,0 +1,263 @@
+#include "TlsContext.hpp"
+#include "Logger.hpp"
+#include "Buffer.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <arpa/inet.h>
+
+#ifdef MYMUDUO_HAVE_OPENSSL
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#if OPENSSL_VERSION_NUMBER<0x30000000L
+#error "TLS support needs OpenSSL 3.0 or later, build without MYMUDUO_HAVE_OPENSSL"
+#endif
+
+namespace{
+//把OpenSSL错误队列里的第一条错误拿出来打日志，同时清空队列
+const char* lastSslError(){
+	static __thread char buf[256];
+	unsigned long err=::ERR_get_error();
+	::ERR_clear_error();
+	if(err==0){
+		return "no ssl error";
+	}
+	::ERR_error_string_n(err,buf,sizeof(buf));
+	return buf;
+}
+
+SSL_CTX* newContext(bool isServer){
+	SSL_CTX* ctx=::SSL_CTX_new(isServer ? ::TLS_server_method() : ::TLS_client_method());
+	if(ctx==nullptr){
+		LOG_ERROR("TlsContext SSL_CTX_new error:%s \n",lastSslError());
+		return nullptr;
+	}
+	::SSL_CTX_set_min_proto_version(ctx,TLS1_2_VERSION);
+	//非阻塞写：允许只写出一部分，重试时数据可以在Buffer里移动
+	::SSL_CTX_set_mode(ctx,SSL_MODE_ENABLE_PARTIAL_WRITE|SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+	long options=SSL_OP_IGNORE_UNEXPECTED_EOF;	//对端不发close_notify直接关闭时按正常EOF处理
+#ifdef SSL_OP_ENABLE_KTLS
+	options|=SSL_OP_ENABLE_KTLS;
+#endif
+	::SSL_CTX_set_options(ctx,options);
+	return ctx;
+}
+}
+
+std::shared_ptr<TlsContext> TlsContext::newServerContext(const std::string& certFile,const std::string& keyFile){
+	SSL_CTX* ctx=newContext(true);
+	if(ctx==nullptr){
+		return nullptr;
+	}
+	if(::SSL_CTX_use_certificate_chain_file(ctx,certFile.c_str())!=1
+		||::SSL_CTX_use_PrivateKey_file(ctx,keyFile.c_str(),SSL_FILETYPE_PEM)!=1
+		||::SSL_CTX_check_private_key(ctx)!=1){
+		LOG_ERROR("TlsContext load %s/%s error:%s \n",certFile.c_str(),keyFile.c_str(),lastSslError());
+		::SSL_CTX_free(ctx);
+		return nullptr;
+	}
+	return std::shared_ptr<TlsContext>(new TlsContext(ctx,true));
+}
+
+std::shared_ptr<TlsContext> TlsContext::newClientContext(const std::string& caFile){
+	SSL_CTX* ctx=newContext(false);
+	if(ctx==nullptr){
+		return nullptr;
+	}
+	int ret=0;
+	if(caFile.empty()){
+		ret=::SSL_CTX_set_default_verify_paths(ctx);
+	}
+	else{
+		ret=::SSL_CTX_load_verify_locations(ctx,caFile.c_str(),nullptr);
+	}
+	if(ret!=1){
+		LOG_ERROR("TlsContext load ca %s error:%s \n",caFile.empty()?"(system default)":caFile.c_str(),lastSslError());
+		::SSL_CTX_free(ctx);
+		return nullptr;
+	}
+	::SSL_CTX_set_verify(ctx,SSL_VERIFY_PEER,nullptr);
+	return std::shared_ptr<TlsContext>(new TlsContext(ctx,false));
+}
+
+TlsContext::TlsContext(SSL_CTX* ctx,bool isServer)
+	:ctx_(ctx)
+	,isServer_(isServer)
+{
+}
+
+TlsContext::~TlsContext(){
+	::SSL_CTX_free(ctx_);
+}
+
+void TlsContext::setKernelTls(bool on){
+#ifdef SSL_OP_ENABLE_KTLS
+	if(on){
+		::SSL_CTX_set_options(ctx_,SSL_OP_ENABLE_KTLS);
+	}
+	else{
+		::SSL_CTX_clear_options(ctx_,SSL_OP_ENABLE_KTLS);
+	}
+#endif
+}
+
+void TlsContext::setVerifyPeer(bool on){
+	::SSL_CTX_set_verify(ctx_,on?SSL_VERIFY_PEER:SSL_VERIFY_NONE,nullptr);
+}
+
+TlsStream::TlsStream()
+	:ssl_(nullptr)
+	,established_(false)
+	,kernelTx_(false)
+	,kernelRx_(false)
+{
+}
+
+TlsStream::~TlsStream(){
+	if(ssl_){
+		::SSL_free(ssl_);
+	}
+}
+
+bool TlsStream::init(const TlsContext& context,int fd,const std::string& serverName){
+	ssl_=::SSL_new(context.nativeHandle());
+	if(ssl_==nullptr||::SSL_set_fd(ssl_,fd)!=1){
+		LOG_ERROR("TlsStream::init fd=%d error:%s \n",fd,lastSslError());
+		return false;
+	}
+	if(context.isServer()){
+		::SSL_set_accept_state(ssl_);
+	}
+	else{
+		::SSL_set_connect_state(ssl_);
+		char addr[sizeof(struct in6_addr)];
+		const bool isIp=::inet_pton(AF_INET,serverName.c_str(),addr)==1||::inet_pton(AF_INET6,serverName.c_str(),addr)==1;
+		if(isIp){	//IP地址不能用作SNI，按证书里的IP地址校验
+			::X509_VERIFY_PARAM_set1_ip_asc(::SSL_get0_param(ssl_),serverName.c_str());
+		}
+		else if(!serverName.empty()){
+			::SSL_set_tlsext_host_name(ssl_,serverName.c_str());
+			::SSL_set1_host(ssl_,serverName.c_str());
+		}
+		else if(::SSL_get_verify_mode(ssl_)&SSL_VERIFY_PEER){
+			LOG_ERROR("TlsStream::init fd=%d no server name, only the certificate chain is verified \n",fd);
+		}
+	}
+	return true;
+}
+
+TlsStream::Result TlsStream::handshake(){
+	::ERR_clear_error();
+	int ret=::SSL_do_handshake(ssl_);
+	if(ret==1){
+		established_=true;
+		//OpenSSL只在协商出的密码套件内核支持时才会开启kTLS，每个方向分别判断
+		kernelTx_=BIO_get_ktls_send(::SSL_get_wbio(ssl_));
+		kernelRx_=BIO_get_ktls_recv(::SSL_get_rbio(ssl_));
+		return kDone;
+	}
+	int err=::SSL_get_error(ssl_,ret);
+	if(err==SSL_ERROR_WANT_READ){
+		return kWantRead;
+	}
+	if(err==SSL_ERROR_WANT_WRITE){
+		return kWantWrite;
+	}
+	LOG_ERROR("TlsStream::handshake error:%d %s \n",err,lastSslError());
+	return kError;
+}
+
+ssize_t TlsStream::write(const void* data,size_t len){
+	::ERR_clear_error();
+	int ret=::SSL_write(ssl_,data,static_cast<int>(std::min(len,static_cast<size_t>(INT_MAX))));
+	if(ret>0){
+		return ret;
+	}
+	int err=::SSL_get_error(ssl_,ret);
+	if(err==SSL_ERROR_WANT_WRITE||err==SSL_ERROR_WANT_READ){
+		errno=EWOULDBLOCK;
+	}
+	else if(err!=SSL_ERROR_SYSCALL||errno==0){	//SYSCALL时errno是write的错误，比如EPIPE
+		LOG_ERROR("TlsStream::write error:%d %s \n",err,lastSslError());
+		errno=EPROTO;
+	}
+	return -1;
+}
+
+ssize_t TlsStream::readInto(Buffer* buf,int* savedErrno){
+	static const size_t kReadSize=16*1024;	//一个TLS记录最多16KB明文
+	static const ssize_t kMaxReadPerEvent=64*1024;	//对端写得和读得一样快时也要及时交给上层，剩下的等下一次读事件
+	ssize_t total=0;
+	while(total<kMaxReadPerEvent){
+		buf->ensureWritableBytes(kReadSize);
+		::ERR_clear_error();
+		int ret=::SSL_read(ssl_,buf->beginWrite(),static_cast<int>(buf->wirtableBytes()));
+		if(ret>0){
+			buf->hasWritten(ret);
+			total+=ret;
+			continue;
+		}
+		int err=::SSL_get_error(ssl_,ret);
+		if(total>0){	//先交出已经读到的数据，错误或者EOF下一次读事件再处理
+			return total;
+		}
+		if(err==SSL_ERROR_ZERO_RETURN){
+			return 0;
+		}
+		if(err==SSL_ERROR_WANT_READ||err==SSL_ERROR_WANT_WRITE){
+			*savedErrno=EWOULDBLOCK;
+		}
+		else if(err==SSL_ERROR_SYSCALL&&errno!=0){
+			*savedErrno=errno;
+		}
+		else{
+			LOG_ERROR("TlsStream::readInto error:%d %s \n",err,lastSslError());
+			*savedErrno=EPROTO;
+		}
+		return -1;
+	}
+	return total;
+}
+
+bool TlsStream::hasPending()const{
+	return ::SSL_has_pending(ssl_)==1;
+}
+
+void TlsStream::shutdown(){
+	if(established_){
+		::ERR_clear_error();
+		::SSL_shutdown(ssl_);
+		::ERR_clear_error();
+	}
+}
+
+#else	//没有OpenSSL：工厂函数返回空指针，TcpConnection::startTls失败
+
+std::shared_ptr<TlsContext> TlsContext::newServerContext(const std::string&,const std::string&){
+	LOG_ERROR("TlsContext mymuduo is built without OpenSSL \n");
+	return nullptr;
+}
+
+std::shared_ptr<TlsContext> TlsContext::newClientContext(const std::string&){
+	LOG_ERROR("TlsContext mymuduo is built without OpenSSL \n");
+	return nullptr;
+}
+
+TlsContext::TlsContext(SSL_CTX* ctx,bool isServer):ctx_(ctx),isServer_(isServer){}
+TlsContext::~TlsContext(){}
+void TlsContext::setKernelTls(bool){}
+void TlsContext::setVerifyPeer(bool){}
+
+TlsStream::TlsStream():ssl_(nullptr),established_(false),kernelTx_(false),kernelRx_(false){}
+TlsStream::~TlsStream(){}
+bool TlsStream::init(const TlsContext&,int,const std::string&){return false;}
+TlsStream::Result TlsStream::handshake(){return kError;}
+ssize_t TlsStream::write(const void*,size_t){errno=EPROTO;return -1;}
+ssize_t TlsStream::readInto(Buffer*,int* savedErrno){*savedErrno=EPROTO;return -1;}
+bool TlsStream::hasPending()const{return false;}
+void TlsStream::shutdown(){}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "noncopyable.hpp"
+
+class Buffer;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+
+/*
+OpenSSL的SSL_CTX，保存证书、私钥和协议选项，被TcpServer/TcpClient以及它们的所有连接共享
+默认开启SSL_OP_ENABLE_KTLS：握手完成以后OpenSSL会setsockopt(TCP_ULP "tls")并把密钥交给内核(TLS_TX/TLS_RX)
+编译时没有找到OpenSSL的话工厂函数返回空指针
+*/
+class TlsContext:noncopyable{
+public:
+	//证书链和私钥都是PEM文件，加载失败返回nullptr
+	static std::shared_ptr<TlsContext> newServerContext(const std::string& certFile,const std::string& keyFile);
+	//默认校验服务端证书：caFile为空时用系统的CA，否则只信任caFile里的CA(例如回环测试用的自签名证书)
+	//主机名按TcpClient::setTlsContext的serverName校验，没有serverName时按对端IP校验
+	static std::shared_ptr<TlsContext> newClientContext(const std::string& caFile=std::string());
+	~TlsContext();
+
+	bool isServer()const{return isServer_;}
+	SSL_CTX* nativeHandle()const{return ctx_;}
+	//是否请求内核TLS，默认开启；关闭以后一直在用户态SSL_read/SSL_write，对之后的连接生效
+	void setKernelTls(bool on);
+	//客户端是否校验服务端证书，默认开启；只应该在回环测试里关闭，对之后的连接生效
+	void setVerifyPeer(bool on);
+
+private:
+	TlsContext(SSL_CTX* ctx,bool isServer);
+
+	SSL_CTX* ctx_;
+	const bool isServer_;
+};
+
+/*
+一条连接上的SSL对象，由TcpConnection持有，只在loop线程里使用
+读写接口和read/write一致，出错时设置errno：EWOULDBLOCK表示等待事件，EPROTO表示TLS协议错误
+*/
+class TlsStream:noncopyable{
+public:
+	enum Result{kDone,kWantRead,kWantWrite,kError};
+
+	TlsStream();
+	~TlsStream();
+
+	//serverName用于客户端的SNI和证书主机名校验，可以为空
+	bool init(const TlsContext& context,int fd,const std::string& serverName);
+	//推进非阻塞握手，kDone以后kernelTx()/kernelRx()才有意义
+	Result handshake();
+	bool established()const{return established_;}
+	//内核是否接管了发送/接收方向的加解密，接管的方向直接用socket读写
+	bool kernelTx()const{return kernelTx_;}
+	bool kernelRx()const{return kernelRx_;}
+
+	ssize_t write(const void* data,size_t len);
+	//把解密出的数据读进buf，一次最多64KB，对端close_notify或者关闭连接时返回0
+	ssize_t readInto(Buffer* buf,int* savedErrno);
+	//OpenSSL里还有没交给上层的数据，不会再触发socket的读事件
+	bool hasPending()const;
+	//发送close_notify，尽力而为
+	void shutdown();
+
+private:
+	SSL* ssl_;
+	bool established_;
+	bool kernelTx_;
+	bool kernelRx_;
+};
@@ -0,0 +1,45 @@
+#include "UdpServer.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+
+static EventLoop* CheckLoopNotNull(EventLoop* loop){
+	if(loop==nullptr){
+		LOG_FATAL("%s:%s:%d udp server loop is null \n",__FILE__,__FUNCTION__,__LINE__);
+	}
+	return loop;
+}
+
+UdpServer::UdpServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& nameArg,int batchSize,size_t maxDatagramSize)
+	:loop_(CheckLoopNotNull(loop))
+	,listenAddr_(listenAddr)
+	,name_(nameArg)
+	,batchSize_(batchSize)
+	,maxDatagramSize_(maxDatagramSize)
+	,threadPool_(new EventLoopThreadPool(loop,nameArg))
+	,started_(0)
+{
+}
+
+UdpServer::~UdpServer(){
+	//socket的channel要在各自的loop里注销，任务里持有shared_ptr，注销以后才释放
+	for(UdpSocketPtr& socket:sockets_){
+		UdpSocketPtr s(socket);
+		socket->getLoop()->runInLoop([s](){ s->stop(); });
+	}
+}
+
+void UdpServer::start(){
+	if(started_++==0){
+		threadPool_->start(threadInitCallback_);
+		InetAddress addr(listenAddr_);
+		for(EventLoop* ioLoop:threadPool_->getAllLoops()){
+			UdpSocketPtr socket=std::make_shared<UdpSocket>(ioLoop,addr,true,batchSize_,maxDatagramSize_);
+			socket->setDatagramsCallback(datagramsCallback_);
+			//监听0端口时，其余socket绑定到第一个socket分到的端口上
+			addr=socket->localAddress();
+			sockets_.push_back(socket);
+			ioLoop->runInLoop([socket](){ socket->start(); });
+		}
+		LOG_INFO("UdpServer [%s] listening on %s with %zu sockets \n",name_.c_str(),addr.toIpPort().c_str(),sockets_.size());
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "noncopyable.hpp"
+#include "InetAddress.hpp"
+#include "UdpSocket.hpp"
+#include "EventLoopThreadPool.hpp"
+
+class EventLoop;
+
+/*
+UDP服务器：每个loop各有一个用SO_REUSEPORT绑定同一地址的UdpSocket
+内核按四元组把数据报分到各个socket上，同一个对端的数据报总在同一个loop里处理
+回调里用UdpSocket::sendTo回复，回复在本轮事件循环结束前批量发出
+*/
+class UdpServer:noncopyable{
+public:
+	using ThreadInitCallback=EventLoopThreadPool::ThreadInitCallback;
+
+	UdpServer(EventLoop* loop,const InetAddress& listenAddr,const std::string& nameArg
+			,int batchSize=UdpSocket::kDefaultBatchSize,size_t maxDatagramSize=UdpSocket::kDefaultMaxDatagramSize);
+	~UdpServer();
+
+	//以下设置都需要在start之前调用
+	void setThreadNum(int num){threadPool_->setThreadNum(num);}
+	void setThreadInitCallback(const ThreadInitCallback& cb){threadInitCallback_=cb;}
+	void setDatagramsCallback(const UdpSocket::DatagramsCallback& cb){datagramsCallback_=cb;}
+
+	void start();
+
+	const std::string& name()const{return name_;}
+	//start以后每个loop一个socket
+	const std::vector<UdpSocketPtr>& sockets()const{return sockets_;}
+
+private:
+	EventLoop* loop_;
+	const InetAddress listenAddr_;
+	const std::string name_;
+	const int batchSize_;
+	const size_t maxDatagramSize_;
+	std::shared_ptr<EventLoopThreadPool> threadPool_;
+	ThreadInitCallback threadInitCallback_;
+	UdpSocket::DatagramsCallback datagramsCallback_;
+	std::vector<UdpSocketPtr> sockets_;
+	std::atomic_int started_;
+};
@@ -0,0 +1,182 @@
+#include "UdpSocket.hpp"
+#include "Logger.hpp"
+#include "EventLoop.hpp"
+
+#include <sys/types.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+static int createNonBlockingUdp(){
+	int sockfd=::socket(AF_INET,SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+	if(sockfd<0){
+		LOG_FATAL("%s:%s:%d  udp socket create err:%d \n",__FILE__, __FUNCTION__, __LINE__,errno);
+	}
+	return sockfd;
+}
+
+UdpSocket::UdpSocket(EventLoop* loop,const InetAddress& bindAddr,bool reusePort,int batchSize,size_t maxDatagramSize)
+	:loop_(loop)
+	,socket_(createNonBlockingUdp())
+	,channel_(loop,socket_.fd())
+	,localAddr_(bindAddr)
+	,started_(false)
+	,batchSize_(std::max(batchSize,1))
+	,maxDatagramSize_(maxDatagramSize)
+	,recvData_(batchSize_*maxDatagramSize_)
+	,recvMsgs_(batchSize_)
+	,recvIovecs_(batchSize_)
+	,recvAddrs_(batchSize_)
+	,datagrams_(batchSize_)
+	,truncated_(0)
+	,sendHead_(0)
+	,sendMsgs_(batchSize_)
+	,sendIovecs_(batchSize_)
+	,flushQueued_(false)
+	,droppedSends_(0)
+{
+	socket_.setReuseAddr(true);
+	socket_.setReusePort(reusePort);
+	socket_.bindAddress(bindAddr);
+	//绑定0端口时取回内核分配的端口
+	sockaddr_in local;
+	socklen_t len=sizeof(local);
+	::memset(&local,0,sizeof(local));
+	if(::getsockname(socket_.fd(),(sockaddr*)&local,&len)==0){
+		localAddr_.setSockAddr(local);
+	}
+
+	for(int i=0;i<batchSize_;++i){
+		recvIovecs_[i].iov_base=&recvData_[i*maxDatagramSize_];
+		recvIovecs_[i].iov_len=maxDatagramSize_;
+	}
+	channel_.setReadCallback([this](Timestamp receiveTime){ handleRead(receiveTime); });
+	channel_.setWriteCallback([this](){ handleWrite(); });
+}
+
+UdpSocket::~UdpSocket(){
+	if(started_){
+		LOG_ERROR("UdpSocket::dtor fd=%d is still registered \n",socket_.fd());
+	}
+}
+
+void UdpSocket::start(){
+	if(!started_){
+		started_=true;
+		channel_.enableReading();
+	}
+}
+
+void UdpSocket::stop(){
+	if(started_){
+		started_=false;
+		channel_.disableAll();
+		channel_.remove();
+	}
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime){
+	//msg_namelen和msg_len每次都会被内核改写，收之前重置
+	for(int i=0;i<batchSize_;++i){
+		msghdr& hdr=recvMsgs_[i].msg_hdr;
+		::memset(&hdr,0,sizeof(hdr));
+		hdr.msg_name=&recvAddrs_[i];
+		hdr.msg_namelen=sizeof(sockaddr_in);
+		hdr.msg_iov=&recvIovecs_[i];
+		hdr.msg_iovlen=1;
+		recvMsgs_[i].msg_len=0;
+	}
+	int n=::recvmmsg(socket_.fd(),recvMsgs_.data(),batchSize_,MSG_DONTWAIT,nullptr);
+	if(n<0){
+		if(errno!=EAGAIN&&errno!=EWOULDBLOCK&&errno!=EINTR){
+			LOG_ERROR("UdpSocket::handleRead fd=%d recvmmsg err:%d \n",socket_.fd(),errno);
+		}
+		return;
+	}
+	size_t count=0;
+	for(int i=0;i<n;++i){
+		if(recvMsgs_[i].msg_hdr.msg_flags&MSG_TRUNC){	//数据报比maxDatagramSize_大，剩下的部分已经被内核丢弃
+			++truncated_;
+			continue;
+		}
+		Datagram& datagram=datagrams_[count++];
+		datagram.data=static_cast<const char*>(recvIovecs_[i].iov_base);
+		datagram.len=recvMsgs_[i].msg_len;
+		datagram.peer.setSockAddr(recvAddrs_[i]);
+	}
+	if(count>0&&datagramsCallback_){
+		datagramsCallback_(*this,datagrams_.data(),count,receiveTime);
+	}
+}
+
+void UdpSocket::sendTo(const InetAddress& peer,const void* data,size_t len){
+	if(pendingSends_.size()-sendHead_>=kMaxPendingSends){
+		++droppedSends_;
+		return;
+	}
+	PendingSend pending;
+	pending.addr=*peer.getSockAddr();
+	pending.offset=sendData_.size();
+	pending.len=len;
+	const char* p=static_cast<const char*>(data);
+	sendData_.insert(sendData_.end(),p,p+len);
+	pendingSends_.push_back(pending);
+	//等可写时由handleWrite发送，不用再排队
+	if(!flushQueued_&&!channel_.isWriting()){
+		flushQueued_=true;
+		UdpSocketPtr self(shared_from_this());
+		loop_->runAtIterationEnd([self](){
+			self->flushQueued_=false;
+			self->flush();
+		});
+	}
+}
+
+void UdpSocket::handleWrite(){
+	flush();
+}
+
+void UdpSocket::flush(){
+	while(sendHead_<pendingSends_.size()){
+		const int batch=static_cast<int>(std::min(pendingSends_.size()-sendHead_,static_cast<size_t>(batchSize_)));
+		for(int i=0;i<batch;++i){
+			PendingSend& pending=pendingSends_[sendHead_+i];
+			sendIovecs_[i].iov_base=&sendData_[pending.offset];
+			sendIovecs_[i].iov_len=pending.len;
+			msghdr& hdr=sendMsgs_[i].msg_hdr;
+			::memset(&hdr,0,sizeof(hdr));
+			hdr.msg_name=&pending.addr;
+			hdr.msg_namelen=sizeof(sockaddr_in);
+			hdr.msg_iov=&sendIovecs_[i];
+			hdr.msg_iovlen=1;
+		}
+		int n=::sendmmsg(socket_.fd(),sendMsgs_.data(),batch,MSG_DONTWAIT);
+		if(n<0){
+			if(errno==EAGAIN||errno==EWOULDBLOCK||errno==ENOBUFS){
+				if(!started_){	//没有注册到loop上，等不到可写事件
+					droppedSends_+=pendingSends_.size()-sendHead_;
+					break;
+				}
+				if(!channel_.isWriting()){
+					channel_.enableWriting();
+				}
+				return;
+			}
+			if(errno!=EINTR){
+				//第一个数据报就发送失败(例如目标不可达)，丢掉它继续发后面的
+				LOG_ERROR("UdpSocket::flush fd=%d sendmmsg err:%d \n",socket_.fd(),errno);
+				++droppedSends_;
+				++sendHead_;
+			}
+			continue;
+		}
+		sendHead_+=n;
+	}
+	//全部发出，清空队列但保留容量
+	sendData_.clear();
+	pendingSends_.clear();
+	sendHead_=0;
+	if(channel_.isWriting()){
+		channel_.disableWriting();
+	}
+}
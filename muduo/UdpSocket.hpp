@@ -0,0 +1,92 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "noncopyable.hpp"
+#include "Callbacks.hpp"
+#include "InetAddress.hpp"
+#include "Timestamp.hpp"
+#include "Socket.hpp"
+#include "Channel.hpp"
+
+class EventLoop;
+class UdpSocket;
+using UdpSocketPtr=std::shared_ptr<UdpSocket>;
+
+/*
+绑定在一个EventLoop上的UDP socket
+- 读事件里用recvmmsg一次收一批数据报，收进预先分配好的数组，整批交给回调
+- sendTo只追加到发送队列，本轮事件循环结束前用sendmmsg一次发出；EAGAIN时等可写再发
+- 必须由shared_ptr管理，除构造以外的接口都只能在loop线程里调用
+*/
+class UdpSocket:noncopyable,public std::enable_shared_from_this<UdpSocket>{
+public:
+	//data指向接收数组内部，只在回调期间有效
+	struct Datagram{
+		const char* data;
+		size_t len;
+		InetAddress peer;
+	};
+	using DatagramsCallback=Callable<void(UdpSocket& socket,const Datagram* datagrams,size_t count,Timestamp receiveTime)>;
+
+	static const int kDefaultBatchSize=64;
+	static const size_t kDefaultMaxDatagramSize=2048;
+	static const size_t kMaxPendingSends=16384;	//发送队列满了以后直接丢弃，和网络丢包一样处理
+
+	//reusePort为true时多个socket可以绑定同一个地址，由内核按四元组分流
+	UdpSocket(EventLoop* loop,const InetAddress& bindAddr,bool reusePort=false
+			,int batchSize=kDefaultBatchSize,size_t maxDatagramSize=kDefaultMaxDatagramSize);
+	~UdpSocket();
+
+	void setDatagramsCallback(const DatagramsCallback& cb){datagramsCallback_=cb;}
+
+	void start();	//开始接收
+	void stop();
+
+	void sendTo(const InetAddress& peer,const void* data,size_t len);
+
+	EventLoop* getLoop()const{return loop_;}
+	int fd()const{return socket_.fd();}
+	const InetAddress& localAddress()const{return localAddr_;}
+	//超过maxDatagramSize被截断、以及发送队列满或发送失败而丢弃的数据报数
+	size_t truncatedCount()const{return truncated_;}
+	size_t droppedSendCount()const{return droppedSends_;}
+
+private:
+	struct PendingSend{
+		sockaddr_in addr;
+		size_t offset;	//数据在sendData_里的位置
+		size_t len;
+	};
+
+	void handleRead(Timestamp receiveTime);
+	void handleWrite();
+	void flush();
+
+	EventLoop* loop_;
+	Socket socket_;
+	Channel channel_;
+	InetAddress localAddr_;
+	bool started_;
+	DatagramsCallback datagramsCallback_;
+
+	const int batchSize_;
+	const size_t maxDatagramSize_;
+	//接收用的数组，构造时分配好以后一直复用
+	std::vector<char> recvData_;
+	std::vector<mmsghdr> recvMsgs_;
+	std::vector<iovec> recvIovecs_;
+	std::vector<sockaddr_in> recvAddrs_;
+	std::vector<Datagram> datagrams_;
+	size_t truncated_;
+
+	std::vector<char> sendData_;
+	std::vector<PendingSend> pendingSends_;
+	size_t sendHead_;	//pendingSends_里第一个还没有发出的下标
+	std::vector<mmsghdr> sendMsgs_;
+	std::vector<iovec> sendIovecs_;
+	bool flushQueued_;
+	size_t droppedSends_;
+};
@@ -0,0 +1,102 @@
+/*
+连接建立/关闭的压测：统计稳定状态下每个连接的内存分配次数
+用法: churn_bench [ioThreads] [connections] [warmup] [maxInflight]
+客户端RST关闭以后不等服务器处理就继续连接，服务器积压的连接越来越多，输入输出Buffer跟着变多；
+所以同时未被服务器关闭的连接最多maxInflight个，测出的才是稳定状态
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/TcpServer.hpp>
+#include <mymuduo/Logger.hpp>
+
+#include <atomic>
+#include <thread>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static std::atomic<uint64_t> g_allocs(0);
+
+//替换全局operator new，统计整个进程(包括libmymuduo)的分配次数
+void* operator new(size_t size){
+	g_allocs.fetch_add(1,std::memory_order_relaxed);
+	void* p=malloc(size==0?1:size);
+	if(p==nullptr){
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void operator delete(void* p)noexcept{
+	free(p);
+}
+
+static std::atomic<int> g_closed(0);
+
+static void runClients(EventLoop* loop,uint16_t port,int warmup,int connections,int maxInflight){
+	struct sockaddr_in addr;
+	addr.sin_family=AF_INET;
+	addr.sin_port=htons(port);
+	addr.sin_addr.s_addr=inet_addr("127.0.0.1");
+
+	uint64_t allocsBefore=0;
+	Timestamp start;
+	for(int i=0;i<warmup+connections;++i){
+		if(i==warmup){
+			while(g_closed.load()<warmup){	//等服务器处理完预热的连接
+				usleep(1000);
+			}
+			allocsBefore=g_allocs.load();
+			start=Timestamp::now();
+		}
+		while(i-g_closed.load()>=maxInflight){
+			std::this_thread::yield();
+		}
+		int fd=::socket(AF_INET,SOCK_STREAM,0);
+		if(::connect(fd,(struct sockaddr*)&addr,sizeof(addr))<0){
+			perror("connect");
+			::close(fd);
+			continue;
+		}
+		struct linger lin={1,0};	//RST关闭，客户端不留TIME_WAIT
+		::setsockopt(fd,SOL_SOCKET,SO_LINGER,&lin,sizeof(lin));
+		::close(fd);
+	}
+	while(g_closed.load()<warmup+connections){
+		usleep(1000);
+	}
+	double seconds=timeDifference(Timestamp::now(),start);
+	uint64_t allocs=g_allocs.load()-allocsBefore;
+	fprintf(stderr,"%d connections in %.3fs, %.0f conn/s, %llu allocations, %.2f per connection\n",
+		connections,seconds,connections/seconds,(unsigned long long)allocs,(double)allocs/connections);
+	loop->queueInLoop([loop](){ loop->quit(); });
+}
+
+int main(int argc,char* argv[]){
+	int ioThreads=argc>1?atoi(argv[1]):2;
+	int connections=argc>2?atoi(argv[2]):20000;
+	int warmup=argc>3?atoi(argv[3]):2000;
+	int maxInflight=argc>4?atoi(argv[4]):64;
+	const uint16_t port=9981;
+
+	EventLoop loop;
+	InetAddress addr(port);
+	TcpServer server(&loop,addr,"ChurnBench");
+	server.setConnectionCallback([](const TcpConnectionPtr& conn){
+		if(!conn->connected()){
+			g_closed.fetch_add(1);
+		}
+	});
+	server.setMessageCallback([](const TcpConnectionPtr&,Buffer* buf,Timestamp){
+		buf->retrieveAll();
+	});
+	server.setThreadNum(ioThreads);
+	server.start();
+
+	std::thread clients(runClients,&loop,port,warmup,connections,maxInflight);
+	loop.loop();
+	clients.join();
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+HTTP/2(h2c)示例服务器
+  /            一个小页面
+  /echo        POST的body原样返回
+  /stream?n=N  流式响应N MiB，用来观察流量控制和多个流交错发送
+  /static/...  参数dir目录下的文件
+用法: http2_server [port] [dir]
+测试: curl --http2-prior-knowledge http://127.0.0.1:8000/
+      h2load -n 10000 -c 10 -m 32 http://127.0.0.1:8000/
+*/
+#include <mymuduo/Http2Server.hpp>
+#include <mymuduo/EventLoop.hpp>
+
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static std::string g_dir=".";
+
+static void serveFile(const std::string& path,Http2Response* resp){
+	if(path.find("..")!=std::string::npos){
+		resp->setStatus(400);
+		resp->setBody("Bad Request");
+		return;
+	}
+	int fd=::open((g_dir+path).c_str(),O_RDONLY|O_CLOEXEC);
+	if(fd<0){
+		resp->setStatus(404);
+		resp->setBody("Not Found");
+		return;
+	}
+	std::shared_ptr<int> file(new int(fd),[](int* p){ ::close(*p); delete p; });
+	resp->setContentType("application/octet-stream");
+	resp->setStreamBody([file](Buffer* out)->bool{
+		char buf[16*1024];
+		ssize_t n=::read(*file,buf,sizeof buf);
+		if(n>0){
+			out->append(buf,n);
+		}
+		return n>0;
+	});
+}
+
+static void onRequest(const Http2Request& req,Http2Response* resp){
+	const std::string& path=req.path();
+	if(path=="/"){
+		resp->setContentType("text/html");
+		resp->setBody("<html><body><h1>hello, HTTP/2</h1></body></html>\n");
+	}
+	else if(path=="/echo"){
+		resp->setContentType("application/octet-stream");
+		resp->setBody(req.body());
+	}
+	else if(path.compare(0,10,"/stream?n=")==0){
+		std::shared_ptr<size_t> left(new size_t(strtoul(path.c_str()+10,nullptr,10)*1024*1024));
+		resp->setContentType("text/plain");
+		resp->setStreamBody([left](Buffer* out)->bool{
+			char block[16*1024];
+			const size_t n=*left<sizeof block?*left:sizeof block;
+			::memset(block,'x',n);
+			out->append(block,n);
+			*left-=n;
+			return *left>0;
+		});
+	}
+	else if(path.compare(0,8,"/static/")==0){
+		serveFile(path.substr(7),resp);
+	}
+	else{
+		resp->setStatus(404);
+		resp->setBody("Not Found");
+	}
+}
+
+int main(int argc,char* argv[]){
+	const uint16_t port=static_cast<uint16_t>(argc>1?atoi(argv[1]):8000);
+	if(argc>2){
+		g_dir=argv[2];
+	}
+	EventLoop loop;
+	Http2Server server(&loop,InetAddress(port),"Http2Server");
+	server.setHttpCallback(onRequest);
+	server.setThreadNum(2);
+	server.start();
+	loop.loop();
+	return 0;
+}
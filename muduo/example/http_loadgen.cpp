@@ -0,0 +1,173 @@
+/*
+wrk风格的HTTP/1.1压测工具：每条连接保持pipeline个请求在途，收到一个完整响应就补发一个
+target为local时在进程内起一个返回hello world的HttpServer，否则连接ip:port
+用法: http_loadgen [local|ip] [port] [connections] [threads] [pipeline] [seconds] [path]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/HttpServer.hpp>
+#include <mymuduo/TcpClient.hpp>
+#include <mymuduo/EventLoopThreadPool.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+//延迟按log2(微秒)分桶，每个2的幂再分kSubBuckets份
+static const int kSubBuckets=8;
+static const int kBuckets=40*kSubBuckets;
+static std::atomic<int64_t> g_histogram[kBuckets];
+static std::atomic<int64_t> g_requests(0);
+static std::atomic<int64_t> g_bytes(0);
+static std::atomic<int64_t> g_errors(0);
+static std::atomic<int64_t> g_latencySum(0);
+
+static int bucketOf(int64_t micros){
+	if(micros<1){
+		micros=1;
+	}
+	int b=static_cast<int>(log2(static_cast<double>(micros))*kSubBuckets);
+	return b<kBuckets?b:kBuckets-1;
+}
+
+static double percentile(double p,int64_t total){
+	int64_t target=static_cast<int64_t>(total*p);
+	int64_t seen=0;
+	for(int i=0;i<kBuckets;++i){
+		seen+=g_histogram[i].load();
+		if(seen>target){
+			return pow(2.0,static_cast<double>(i+1)/kSubBuckets);
+		}
+	}
+	return 0;
+}
+
+//每条连接的状态，放在连接的context里
+struct LoadState{
+	std::deque<int64_t> sendTimes;	//在途请求的发送时间
+};
+
+static void sendRequest(TcpConnection& conn,LoadState* state,const std::string& request){
+	state->sendTimes.push_back(Timestamp::now().microSecondsSinceEpoch());
+	conn.send(request.data(),request.size());
+}
+
+//从buf里切出所有完整的响应，只认Content-Length
+static void onResponse(TcpConnection& conn,Buffer* buf,const std::string& request){
+	LoadState* state=conn.getContext<LoadState>();
+	while(state&&buf->readableBytes()>0){
+		const char* begin=buf->peek();
+		const char* headerEnd=static_cast<const char*>(::memmem(begin,buf->readableBytes(),"\r\n\r\n",4));
+		if(headerEnd==nullptr){
+			return;
+		}
+		size_t contentLength=0;
+		for(const char* p=begin;p<headerEnd;){
+			const char* eol=static_cast<const char*>(::memchr(p,'\n',headerEnd-p));
+			if(eol==nullptr){
+				eol=headerEnd;
+			}
+			if(eol-p>15&&::strncasecmp(p,"Content-Length:",15)==0){
+				contentLength=strtoul(p+15,nullptr,10);
+			}
+			p=eol+1;
+		}
+		const size_t total=headerEnd+4-begin+contentLength;
+		if(buf->readableBytes()<total){
+			return;
+		}
+		if(::strncmp(begin+9,"200",3)!=0){
+			g_errors.fetch_add(1,std::memory_order_relaxed);
+		}
+		buf->retrieve(total);
+		const int64_t latency=Timestamp::now().microSecondsSinceEpoch()-state->sendTimes.front();
+		state->sendTimes.pop_front();
+		g_histogram[bucketOf(latency)].fetch_add(1,std::memory_order_relaxed);
+		g_latencySum.fetch_add(latency,std::memory_order_relaxed);
+		g_requests.fetch_add(1,std::memory_order_relaxed);
+		g_bytes.fetch_add(total,std::memory_order_relaxed);
+		sendRequest(conn,state,request);
+	}
+}
+
+int main(int argc,char* argv[]){
+	const std::string target=argc>1?argv[1]:"local";
+	const uint16_t port=static_cast<uint16_t>(argc>2?atoi(argv[2]):9986);
+	const int connections=argc>3?atoi(argv[3]):64;
+	const int threads=argc>4?atoi(argv[4]):1;
+	const int pipeline=argc>5?atoi(argv[5]):1;
+	const double seconds=argc>6?atof(argv[6]):5;
+	const std::string path=argc>7?argv[7]:"/";
+
+	EventLoop loop;
+	std::unique_ptr<HttpServer> server;
+	if(target=="local"){
+		server.reset(new HttpServer(&loop,InetAddress(port),"HelloServer"));
+		server->setHttpCallback([](const HttpRequest&,HttpResponse* resp){
+			resp->setContentType("text/plain");
+			resp->setBody("hello, world!\n");
+		});
+		server->setThreadNum(1);
+		server->start();
+	}
+	const InetAddress serverAddr=target=="local"?InetAddress(port):InetAddress(port,target);
+	const std::string request="GET "+path+" HTTP/1.1\r\nHost: "+target+"\r\nUser-Agent: http_loadgen\r\n\r\n";
+
+	EventLoopThreadPool clientPool(&loop,"HttpLoadgen");
+	clientPool.setThreadNum(threads);
+	clientPool.start();
+	std::vector<std::unique_ptr<TcpClient>> clients;
+	for(int i=0;i<connections;++i){
+		std::unique_ptr<TcpClient> client(new TcpClient(clientPool.getNextLoop(),serverAddr,"HttpLoadgen"));
+		client->setConnectionCallback([request,pipeline](const TcpConnectionPtr& conn){
+			if(conn->connected()){
+				conn->setTcpNoDelay(true);
+				LoadState& state=conn->setContext<LoadState>();
+				for(int j=0;j<pipeline;++j){
+					sendRequest(*conn,&state,request);
+				}
+			}
+		});
+		client->setBorrowedMessageCallback([request](TcpConnection& conn,Buffer* buf,Timestamp){
+			onResponse(conn,buf,request);
+		});
+		client->connect();
+		clients.push_back(std::move(client));
+	}
+
+	loop.runAfter(seconds,[&](){
+		const int64_t requests=g_requests.load();
+		fprintf(stderr,"%d connections, %d threads, pipeline %d, %.1fs\n",connections,threads,pipeline,seconds);
+		fprintf(stderr,"  Latency avg %.1fus p50 %.0fus p99 %.0fus\n",
+			requests>0?static_cast<double>(g_latencySum.load())/requests:0.0,percentile(0.5,requests),percentile(0.99,requests));
+		fprintf(stderr,"  Requests/sec: %.0f  Transfer/sec: %.2f MiB  non-200: %lld\n",
+			requests/seconds,g_bytes.load()/seconds/1024/1024,static_cast<long long>(g_errors.load()));
+		for(const std::unique_ptr<TcpClient>& client:clients){
+			TcpConnectionPtr conn=client->connection();
+			if(conn){
+				conn->forceClose();
+			}
+		}
+		//TcpClient要在自己的loop线程里、loop退出之前析构
+		loop.runAfter(0.5,[&](){
+			for(EventLoop* ioLoop:clientPool.getAllLoops()){
+				ioLoop->runInLoop([&,ioLoop](){
+					for(std::unique_ptr<TcpClient>& client:clients){
+						if(client&&client->getLoop()==ioLoop){
+							client.reset();
+						}
+					}
+				});
+			}
+			loop.runAfter(0.5,[&](){ loop.quit(); });
+		});
+	});
+	loop.loop();
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+pingpong吞吐压测：客户端每个会话先发出一块数据，之后两端都把收到的数据原样发回
+比较MessageCallback(每条消息shared_from_this)和BorrowedMessageCallback(借用连接引用)
+用法: pingpong_bench [shared|borrowed] [serverThreads] [clientThreads] [sessions] [blockSize] [seconds]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/TcpServer.hpp>
+#include <mymuduo/EventLoopThreadPool.hpp>
+#include <mymuduo/Logger.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static std::atomic<int64_t> g_bytes(0);
+static std::atomic<int64_t> g_messages(0);
+
+static void echoShared(const TcpConnectionPtr& conn,Buffer* buf,Timestamp){
+	g_messages.fetch_add(1,std::memory_order_relaxed);
+	conn->send(buf);
+}
+
+static void echoBorrowed(TcpConnection& conn,Buffer* buf,Timestamp){
+	g_messages.fetch_add(1,std::memory_order_relaxed);
+	conn.send(buf);
+}
+
+static void countShared(const TcpConnectionPtr& conn,Buffer* buf,Timestamp time){
+	g_bytes.fetch_add(buf->readableBytes(),std::memory_order_relaxed);
+	echoShared(conn,buf,time);
+}
+
+static void countBorrowed(TcpConnection& conn,Buffer* buf,Timestamp time){
+	g_bytes.fetch_add(buf->readableBytes(),std::memory_order_relaxed);
+	echoBorrowed(conn,buf,time);
+}
+
+static int connectTo(uint16_t port){
+	struct sockaddr_in addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family=AF_INET;
+	addr.sin_port=htons(port);
+	addr.sin_addr.s_addr=inet_addr("127.0.0.1");
+	int fd=::socket(AF_INET,SOCK_STREAM,0);
+	if(::connect(fd,(struct sockaddr*)&addr,sizeof(addr))<0){
+		perror("connect");
+		exit(1);
+	}
+	int one=1;
+	::setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+	return fd;
+}
+
+int main(int argc,char* argv[]){
+	const bool borrowed=argc>1&&strcmp(argv[1],"borrowed")==0;
+	const int serverThreads=argc>2?atoi(argv[2]):2;
+	const int clientThreads=argc>3?atoi(argv[3]):2;
+	const int sessions=argc>4?atoi(argv[4]):100;
+	const int blockSize=argc>5?atoi(argv[5]):1024;
+	const double seconds=argc>6?atof(argv[6]):5;
+	const uint16_t port=9982;
+
+	EventLoop loop;
+	TcpServer server(&loop,InetAddress(port),"PingPongServer");
+	if(borrowed){
+		server.setBorrowedMessageCallback(echoBorrowed);
+	}
+	else{
+		server.setMessageCallback(echoShared);
+	}
+	server.setConnectionCallback([](const TcpConnectionPtr& conn){
+		if(conn->connected()){
+			conn->setTcpNoDelay(true);
+		}
+	});
+	server.setThreadNum(serverThreads);
+	server.start();
+
+	//客户端的连接分到自己的loop线程里，没有Connector，直接用阻塞connect得到的fd构造TcpConnection
+	EventLoopThreadPool clientPool(&loop,"PingPongClient");
+	clientPool.setThreadNum(clientThreads);
+	clientPool.start();
+	std::vector<TcpConnectionPtr> clients;
+	const std::string block(blockSize,'p');
+	for(int i=0;i<sessions;++i){
+		EventLoop* ioLoop=clientPool.getNextLoop();
+		int fd=connectTo(port);
+		struct sockaddr_in local;
+		socklen_t len=sizeof(local);
+		::getsockname(fd,(struct sockaddr*)&local,&len);
+		TcpConnectionPtr conn=std::make_shared<TcpConnection>(ioLoop,"client",fd,InetAddress(local),InetAddress(port));
+		if(borrowed){
+			conn->setBorrowedMessageCallback(countBorrowed);
+		}
+		else{
+			conn->setMessageCallback(countShared);
+		}
+		conn->setConnectionCallback([](const TcpConnectionPtr&){});
+		conn->setCloseCallback([](const TcpConnectionPtr&){});
+		ioLoop->runInLoop([conn,block](){
+			conn->connectEstablished();
+			conn->send(block);
+		});
+		clients.push_back(conn);
+	}
+
+	loop.runAfter(seconds,[&](){
+		int64_t bytes=g_bytes.load();
+		int64_t messages=g_messages.load();
+		fprintf(stderr,"%s: %d sessions, %d byte blocks, %.2f MiB/s, %.0f messages/s\n",
+			borrowed?"borrowed":"shared",sessions,blockSize,
+			bytes/seconds/1024/1024,messages/seconds);
+		for(const TcpConnectionPtr& conn:clients){
+			conn->forceClose();
+		}
+		loop.runAfter(0.5,[&](){ loop.quit(); });
+	});
+	loop.loop();
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+同机往返延迟压测：一个会话来回传递一条消息，比较共享内存传输和AF_UNIX流式socket
+服务端在主线程的loop里，客户端在另一个loop线程里
+用法: shm_bench [shm|unix] [messageSize] [seconds] [busyPollMicros]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/ShmServer.hpp>
+#include <mymuduo/ShmClient.hpp>
+#include <mymuduo/TcpServer.hpp>
+#include <mymuduo/TcpClient.hpp>
+#include <mymuduo/EventLoopThread.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+static std::atomic<int64_t> g_roundTrips(0);
+
+int main(int argc,char* argv[]){
+	const bool useShm=!(argc>1&&strcmp(argv[1],"unix")==0);
+	const int messageSize=argc>2?atoi(argv[2]):64;
+	const double seconds=argc>3?atof(argv[3]):5;
+	const int busyPoll=argc>4?atoi(argv[4]):0;
+	const InetAddress addr=InetAddress::fromUnixPath(useShm?"@mymuduo-shm-bench":"@mymuduo-uds-latency");
+	const std::string message(messageSize,'m');
+	::signal(SIGPIPE,SIG_IGN);	//退出时对端先关闭，回显写到已关闭的socket上
+
+	EventLoop loop;
+	EventLoopThread clientThread;
+	EventLoop* clientLoop=clientThread.startLoop();
+
+	//两种传输都是原样回显，客户端收齐一条消息算一次往返
+	std::unique_ptr<ShmServer> shmServer;
+	std::unique_ptr<TcpServer> udsServer;
+	std::unique_ptr<ShmClient> shmClient;
+	std::unique_ptr<TcpClient> udsClient;
+	if(useShm){
+		shmServer.reset(new ShmServer(&loop,addr,"ShmBenchServer"));
+		shmServer->setBusyPoll(busyPoll);
+		shmServer->setMessageCallback([](const ShmConnectionPtr& conn,Buffer* buf,Timestamp){ conn->send(buf); });
+		shmServer->start();
+		clientLoop->runInLoop([&](){
+			shmClient.reset(new ShmClient(clientLoop,addr,"ShmBenchClient"));
+			shmClient->setBusyPoll(busyPoll);
+			shmClient->setConnectionCallback([&message](const ShmConnectionPtr& conn){
+				if(conn->connected()){
+					conn->send(message);
+				}
+			});
+			shmClient->setMessageCallback([messageSize](const ShmConnectionPtr& conn,Buffer* buf,Timestamp){
+				if(buf->readableBytes()>=static_cast<size_t>(messageSize)){
+					g_roundTrips.fetch_add(1,std::memory_order_relaxed);
+					conn->send(buf);
+				}
+			});
+			shmClient->connect();
+		});
+	}
+	else{
+		udsServer.reset(new TcpServer(&loop,addr,"UdsBenchServer"));
+		udsServer->setBorrowedMessageCallback([](TcpConnection& conn,Buffer* buf,Timestamp){ conn.send(buf); });
+		udsServer->start();
+		clientLoop->runInLoop([&](){
+			udsClient.reset(new TcpClient(clientLoop,addr,"UdsBenchClient"));
+			udsClient->setConnectionCallback([&message](const TcpConnectionPtr& conn){
+				if(conn->connected()){
+					conn->send(message);
+				}
+			});
+			udsClient->setBorrowedMessageCallback([messageSize](TcpConnection& conn,Buffer* buf,Timestamp){
+				if(buf->readableBytes()>=static_cast<size_t>(messageSize)){
+					g_roundTrips.fetch_add(1,std::memory_order_relaxed);
+					conn.send(buf);
+				}
+			});
+			udsClient->connect();
+		});
+	}
+
+	loop.runAfter(seconds,[&](){
+		const int64_t trips=g_roundTrips.load();
+		fprintf(stderr,"%s: %d byte messages, busy poll %d us, %.0f round trips/s, %.2f us per round trip\n",
+			useShm?"shm":"unix",messageSize,busyPoll,trips/seconds,trips>0?seconds*1e6/trips:0.0);
+		//客户端在自己的loop线程里断开并析构
+		clientLoop->runInLoop([&](){
+			shmClient.reset();
+			udsClient.reset();
+			loop.runAfter(0.3,[&](){ loop.quit(); });
+		});
+	});
+	loop.loop();
+	return 0;
+}
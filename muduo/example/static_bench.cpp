@@ -0,0 +1,164 @@
+/*
+静态文件压测：进程内起一个StaticFileHandler的HttpServer，客户端连接按顺序轮流请求目录树里的所有文件
+结束时打印吞吐和缓存命中率；缓存装不下整个目录树时可以看到淘汰和命中率下降
+用法: static_bench [dir] [port] [connections] [pipeline] [seconds] [maxEntries]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/HttpServer.hpp>
+#include <mymuduo/StaticFileHandler.hpp>
+#include <mymuduo/TcpClient.hpp>
+#include <mymuduo/EventLoopThreadPool.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static std::vector<std::string> g_paths;
+static size_t g_rootLen=0;
+static std::atomic<int64_t> g_requests(0);
+static std::atomic<int64_t> g_bytes(0);
+static std::atomic<int64_t> g_errors(0);
+
+static int collect(const char* path,const struct stat*,int type,struct FTW*){
+	if(type==FTW_F){
+		g_paths.push_back(std::string(path+g_rootLen));
+	}
+	return 0;
+}
+
+//每条连接的状态：下一个要请求的文件
+struct BenchState{
+	size_t next;
+};
+
+static void sendRequest(TcpConnection& conn,BenchState* state){
+	const std::string& path=g_paths[state->next++%g_paths.size()];
+	std::string request="GET "+path+" HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	conn.send(request.data(),request.size());
+}
+
+//只认Content-Length
+static void onResponse(TcpConnection& conn,Buffer* buf){
+	BenchState* state=conn.getContext<BenchState>();
+	while(state&&buf->readableBytes()>0){
+		const char* begin=buf->peek();
+		const char* headerEnd=static_cast<const char*>(::memmem(begin,buf->readableBytes(),"\r\n\r\n",4));
+		if(headerEnd==nullptr){
+			return;
+		}
+		size_t contentLength=0;
+		for(const char* p=begin;p<headerEnd;){
+			const char* eol=static_cast<const char*>(::memchr(p,'\n',headerEnd-p));
+			if(eol==nullptr){
+				eol=headerEnd;
+			}
+			if(eol-p>15&&::strncasecmp(p,"Content-Length:",15)==0){
+				contentLength=strtoul(p+15,nullptr,10);
+			}
+			p=eol+1;
+		}
+		const size_t total=headerEnd+4-begin+contentLength;
+		if(buf->readableBytes()<total){
+			return;
+		}
+		if(::strncmp(begin+9,"200",3)!=0){
+			g_errors.fetch_add(1,std::memory_order_relaxed);
+		}
+		buf->retrieve(total);
+		g_requests.fetch_add(1,std::memory_order_relaxed);
+		g_bytes.fetch_add(total,std::memory_order_relaxed);
+		sendRequest(conn,state);
+	}
+}
+
+int main(int argc,char* argv[]){
+	const std::string dir=argc>1?argv[1]:".";
+	const uint16_t port=static_cast<uint16_t>(argc>2?atoi(argv[2]):9987);
+	const int connections=argc>3?atoi(argv[3]):16;
+	const int pipeline=argc>4?atoi(argv[4]):4;
+	const double seconds=argc>5?atof(argv[5]):5;
+	const size_t maxEntries=argc>6?strtoul(argv[6],nullptr,10):1024;
+
+	g_rootLen=dir.size();
+	if(::nftw(dir.c_str(),collect,32,FTW_PHYS)!=0||g_paths.empty()){
+		fprintf(stderr,"no files under %s\n",dir.c_str());
+		return 1;
+	}
+	for(std::string& path:g_paths){
+		if(path.empty()||path[0]!='/'){
+			path.insert(0,"/");
+		}
+	}
+	fprintf(stderr,"%zu files under %s\n",g_paths.size(),dir.c_str());
+
+	EventLoop loop;
+	StaticFileHandler handler(dir);
+	handler.setMaxEntries(maxEntries);
+	HttpServer server(&loop,InetAddress(port),"StaticServer");
+	server.setHttpCallback([&handler](const HttpRequest& request,HttpResponse* resp){
+		handler.handle(request,resp);
+	});
+	server.setThreadNum(1);
+	server.start();
+
+	EventLoopThreadPool clientPool(&loop,"StaticBench");
+	clientPool.setThreadNum(1);
+	clientPool.start();
+	std::vector<std::unique_ptr<TcpClient>> clients;
+	for(int i=0;i<connections;++i){
+		std::unique_ptr<TcpClient> client(new TcpClient(clientPool.getNextLoop(),InetAddress(port),"StaticBench"));
+		client->setConnectionCallback([i,pipeline](const TcpConnectionPtr& conn){
+			if(conn->connected()){
+				conn->setTcpNoDelay(true);
+				BenchState& state=conn->setContext<BenchState>();
+				state.next=static_cast<size_t>(i)*7919;	//各条连接从不同的文件开始
+				for(int j=0;j<pipeline;++j){
+					sendRequest(*conn,&state);
+				}
+			}
+		});
+		client->setBorrowedMessageCallback([](TcpConnection& conn,Buffer* buf,Timestamp){
+			onResponse(conn,buf);
+		});
+		client->connect();
+		clients.push_back(std::move(client));
+	}
+
+	loop.runAfter(seconds,[&](){
+		const int64_t requests=g_requests.load();
+		const StaticFileHandler::Stats stats=handler.stats();
+		fprintf(stderr,"%d connections, pipeline %d, %.1fs, cache %zu entries\n",connections,pipeline,seconds,maxEntries);
+		fprintf(stderr,"  Requests/sec: %.0f  Transfer/sec: %.2f MiB  non-200: %lld\n",
+			requests/seconds,g_bytes.load()/seconds/1024/1024,static_cast<long long>(g_errors.load()));
+		fprintf(stderr,"  cache hits %lld misses %lld evictions %lld notFound %lld hit rate %.2f%%\n",
+			static_cast<long long>(stats.hits),static_cast<long long>(stats.misses),static_cast<long long>(stats.evictions),
+			static_cast<long long>(stats.notFound),stats.hitRate()*100);
+		for(const std::unique_ptr<TcpClient>& client:clients){
+			TcpConnectionPtr conn=client->connection();
+			if(conn){
+				conn->forceClose();
+			}
+		}
+		//TcpClient要在自己的loop线程里、loop退出之前析构
+		loop.runAfter(0.5,[&](){
+			for(EventLoop* ioLoop:clientPool.getAllLoops()){
+				ioLoop->runInLoop([&,ioLoop](){
+					for(std::unique_ptr<TcpClient>& client:clients){
+						if(client&&client->getLoop()==ioLoop){
+							client.reset();
+						}
+					}
+				});
+			}
+			loop.runAfter(0.5,[&](){ loop.quit(); });
+		});
+	});
+	loop.loop();
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+TLS下载压测：服务端用sendFile反复发送同一个文件，客户端只计数，比较明文、kTLS和用户态SSL_write
+内核没有tls模块(/proc/sys/net/ipv4/tcp_available_ulp里没有tls)时自动退回用户态，结果里会打印实际用的路径
+自签名证书: openssl req -x509 -newkey rsa:2048 -nodes -keyout key.pem -out cert.pem -days 1 -subj /CN=localhost
+用法: tls_bench cert.pem key.pem file [tls|nokernel|plain] [seconds]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/TcpServer.hpp>
+#include <mymuduo/TcpClient.hpp>
+#include <mymuduo/TlsContext.hpp>
+#include <mymuduo/EventLoopThreadPool.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static std::atomic<int64_t> g_bytes(0);
+
+int main(int argc,char* argv[]){
+	if(argc<4){
+		fprintf(stderr,"usage: %s cert.pem key.pem file [tls|nokernel|plain] [seconds]\n",argv[0]);
+		return 1;
+	}
+	const std::string mode=argc>4?argv[4]:"tls";
+	const double seconds=argc>5?atof(argv[5]):5;
+	const uint16_t port=9984;
+
+	const int fileFd=::open(argv[3],O_RDONLY|O_CLOEXEC);
+	struct stat st;
+	if(fileFd<0||::fstat(fileFd,&st)<0||st.st_size==0){
+		fprintf(stderr,"can not open %s\n",argv[3]);
+		return 1;
+	}
+	const size_t fileSize=st.st_size;
+
+	std::shared_ptr<TlsContext> serverContext,clientContext;
+	if(mode!="plain"){
+		serverContext=TlsContext::newServerContext(argv[1],argv[2]);
+		clientContext=TlsContext::newClientContext(argv[1]);	//自签名证书就是自己的CA
+		if(!serverContext||!clientContext){
+			fprintf(stderr,"TLS context error\n");
+			return 1;
+		}
+		if(mode=="nokernel"){
+			serverContext->setKernelTls(false);
+			clientContext->setKernelTls(false);
+		}
+	}
+
+	EventLoop loop;
+	TcpServer server(&loop,InetAddress(port),"TlsFileServer");
+	server.setTlsContext(serverContext);
+	server.setConnectionCallback([fileFd,fileSize](const TcpConnectionPtr& conn){
+		if(conn->connected()){
+			fprintf(stderr,"server: kernel tx=%d rx=%d\n",(int)conn->kernelTlsTx(),(int)conn->kernelTlsRx());
+			conn->sendFile(fileFd,0,fileSize);
+		}
+	});
+	//上一份发完再发下一份，待发送数据不会无限增长
+	server.setWriteCompleteCallback([fileFd,fileSize](const TcpConnectionPtr& conn){
+		if(conn->connected()){
+			conn->sendFile(fileFd,0,fileSize);
+		}
+	});
+	server.start();
+
+	EventLoopThreadPool clientPool(&loop,"TlsFileClient");
+	clientPool.setThreadNum(1);
+	clientPool.start();
+	EventLoop* clientLoop=clientPool.getNextLoop();
+	std::unique_ptr<TcpClient> client(new TcpClient(clientLoop,InetAddress(port),"TlsFileClient"));
+	client->setTlsContext(clientContext,"localhost");
+	client->setMessageCallback([](const TcpConnectionPtr&,Buffer* buf,Timestamp){
+		g_bytes.fetch_add(buf->readableBytes(),std::memory_order_relaxed);
+		buf->retrieveAll();
+	});
+	client->connect();
+
+	loop.runAfter(seconds,[&](){
+		fprintf(stderr,"%s: %.1f MiB/s\n",mode.c_str(),g_bytes.load()/seconds/(1024*1024));
+		//连接在客户端loop里断开和销毁
+		clientLoop->runInLoop([&](){
+			client->disconnect();
+			client.reset();
+			loop.runAfter(0.2,[&](){ loop.quit(); });
+		});
+	});
+	loop.loop();
+	::close(fileFd);
+	return 0;
+}
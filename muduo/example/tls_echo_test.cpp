@@ -0,0 +1,97 @@
+/*
+TLS握手和回显测试，回环地址上用自签名证书，两端都关闭kTLS走用户态SSL_read/SSL_write
+- 信任自签名证书、按主机名localhost校验：握手成功，1字节到1MB的消息原样回显
+- 用系统CA校验自签名证书、主机名不匹配、不给主机名时按IP 127.0.0.1校验(证书里没有这个IP)：握手失败
+- setVerifyPeer(false)：不校验也能握手
+自签名证书: openssl req -x509 -newkey rsa:2048 -nodes -keyout key.pem -out cert.pem -days 1 -subj /CN=localhost
+用法: tls_echo_test cert.pem key.pem，全部通过时返回0
+*/
+#include <mymuduo/TcpServer.hpp>
+#include <mymuduo/TcpClient.hpp>
+#include <mymuduo/TcpConnection.hpp>
+#include <mymuduo/TlsContext.hpp>
+#include <mymuduo/EventLoop.hpp>
+
+#include <memory>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+//返回客户端是否完成握手并收到了完整的回显
+static bool runCase(const std::shared_ptr<TlsContext>& serverContext,const std::shared_ptr<TlsContext>& clientContext,
+	const std::string& serverName,uint16_t port){
+	EventLoop loop;
+	TcpServer server(&loop,InetAddress(port),"TlsEchoServer");
+	server.setTlsContext(serverContext);
+	server.setMessageCallback([](const TcpConnectionPtr& conn,Buffer* buf,Timestamp){
+		conn->send(buf);
+	});
+	server.start();
+
+	std::string payload;
+	for(size_t len:{size_t(1),size_t(100*1000),size_t(1024*1024)}){
+		for(size_t i=0;i<len;++i){
+			payload.push_back(static_cast<char>('a'+(payload.size()*7+i)%26));
+		}
+	}
+	std::string received;
+	bool ok=false;
+	TcpClient client(&loop,InetAddress(port),"TlsEchoClient");
+	client.setTlsContext(clientContext,serverName);
+	client.setConnectionCallback([&](const TcpConnectionPtr& conn){
+		if(conn->connected()){
+			conn->send(payload);
+		}
+	});
+	client.setMessageCallback([&](const TcpConnectionPtr& conn,Buffer* buf,Timestamp){
+		received.append(buf->retrieveAllAsString());
+		if(received.size()>=payload.size()){
+			ok=received==payload;
+			conn->shutdown();
+			loop.quit();
+		}
+	});
+	client.connect();
+	loop.runAfter(3.0,[&](){ loop.quit(); });
+	loop.loop();
+	client.stop();
+	return ok;
+}
+
+int main(int argc,char* argv[]){
+	if(argc<3){
+		fprintf(stderr,"usage: %s cert.pem key.pem\n",argv[0]);
+		return 1;
+	}
+	std::shared_ptr<TlsContext> serverContext=TlsContext::newServerContext(argv[1],argv[2]);
+	std::shared_ptr<TlsContext> trusting=TlsContext::newClientContext(argv[1]);
+	std::shared_ptr<TlsContext> systemCa=TlsContext::newClientContext();
+	std::shared_ptr<TlsContext> noVerify=TlsContext::newClientContext();
+	if(!serverContext||!trusting||!systemCa||!noVerify){
+		fprintf(stderr,"TLS context error\n");
+		return 1;
+	}
+	serverContext->setKernelTls(false);
+	trusting->setKernelTls(false);
+	systemCa->setKernelTls(false);
+	noVerify->setKernelTls(false);
+	noVerify->setVerifyPeer(false);
+
+	int failures=0;
+	const bool verified=runCase(serverContext,trusting,"localhost",9971);
+	fprintf(stderr,"trusted self-signed cert, echo: %s\n",verified?"ok":"FAILED");
+	failures+=!verified;
+	const bool rejected=!runCase(serverContext,systemCa,"localhost",9972);
+	fprintf(stderr,"untrusted cert rejected: %s\n",rejected?"ok":"FAILED");
+	failures+=!rejected;
+	const bool wrongName=!runCase(serverContext,trusting,"example.com",9974);
+	fprintf(stderr,"wrong host name rejected: %s\n",wrongName?"ok":"FAILED");
+	failures+=!wrongName;
+	const bool byIp=!runCase(serverContext,trusting,"",9975);
+	fprintf(stderr,"no host name, checked against peer IP and rejected: %s\n",byIp?"ok":"FAILED");
+	failures+=!byIp;
+	const bool unverified=runCase(serverContext,noVerify,"localhost",9973);
+	fprintf(stderr,"verification disabled, echo: %s\n",unverified?"ok":"FAILED");
+	failures+=!unverified;
+	return failures==0?0:1;
+}
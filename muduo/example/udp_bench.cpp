@@ -0,0 +1,72 @@
+/*
+UDP回显压测：每个客户端socket保持window个数据报在途，收到多少就再发多少
+batchSize为1时相当于每个数据报一次系统调用，和默认的批量收发对比
+用法: udp_bench [batchSize] [serverThreads] [clients] [window] [datagramSize] [seconds]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/UdpServer.hpp>
+#include <mymuduo/EventLoop.hpp>
+#include <mymuduo/EventLoopThreadPool.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+static std::atomic<int64_t> g_datagrams(0);
+
+int main(int argc,char* argv[]){
+	const int batchSize=argc>1?atoi(argv[1]):UdpSocket::kDefaultBatchSize;
+	const int serverThreads=argc>2?atoi(argv[2]):1;
+	const int clients=argc>3?atoi(argv[3]):4;
+	const int window=argc>4?atoi(argv[4]):256;
+	const int datagramSize=argc>5?atoi(argv[5]):64;
+	const double seconds=argc>6?atof(argv[6]):5;
+	const uint16_t port=9983;
+
+	EventLoop loop;
+	UdpServer server(&loop,InetAddress(port),"UdpEchoServer",batchSize);
+	server.setDatagramsCallback([](UdpSocket& socket,const UdpSocket::Datagram* datagrams,size_t count,Timestamp){
+		for(size_t i=0;i<count;++i){
+			socket.sendTo(datagrams[i].peer,datagrams[i].data,datagrams[i].len);
+		}
+	});
+	server.setThreadNum(serverThreads);
+	server.start();
+
+	EventLoopThreadPool clientPool(&loop,"UdpEchoClient");
+	clientPool.setThreadNum(1);
+	clientPool.start();
+	EventLoop* clientLoop=clientPool.getNextLoop();
+	const InetAddress serverAddr(port);
+	const std::string payload(datagramSize,'u');
+	std::vector<UdpSocketPtr> sockets;
+	for(int i=0;i<clients;++i){
+		UdpSocketPtr socket=std::make_shared<UdpSocket>(clientLoop,InetAddress(0),false,batchSize);
+		socket->setDatagramsCallback([serverAddr](UdpSocket& s,const UdpSocket::Datagram* datagrams,size_t count,Timestamp){
+			g_datagrams.fetch_add(count,std::memory_order_relaxed);
+			for(size_t j=0;j<count;++j){
+				s.sendTo(serverAddr,datagrams[j].data,datagrams[j].len);
+			}
+		});
+		clientLoop->runInLoop([socket,serverAddr,payload,window](){
+			socket->start();
+			for(int j=0;j<window;++j){
+				socket->sendTo(serverAddr,payload.data(),payload.size());
+			}
+		});
+		sockets.push_back(socket);
+	}
+
+	loop.runAfter(seconds,[&](){
+		fprintf(stderr,"batch %d: %d clients, window %d, %d byte datagrams, %.0f datagrams/s\n",
+			batchSize,clients,window,datagramSize,g_datagrams.load()/seconds);
+		for(const UdpSocketPtr& socket:sockets){
+			clientLoop->runInLoop([socket](){ socket->stop(); });
+		}
+		loop.runAfter(0.5,[&](){ loop.quit(); });
+	});
+	loop.loop();
+	return 0;
+}
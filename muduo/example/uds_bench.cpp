@@ -0,0 +1,77 @@
+/*
+同机传输压测：同样的pingpong分别跑在回环TCP和AF_UNIX流式socket上
+客户端用TcpClient连接，每个会话先发出一块数据，之后两端都把收到的数据原样发回
+用法: uds_bench [tcp|unix] [sessions] [blockSize] [seconds]
+日志很多，运行时把stdout重定向到/dev/null，结果打印到stderr
+*/
+#include <mymuduo/TcpServer.hpp>
+#include <mymuduo/TcpClient.hpp>
+#include <mymuduo/EventLoopThreadPool.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static std::atomic<int64_t> g_bytes(0);
+
+int main(int argc,char* argv[]){
+	const bool useUnix=!(argc>1&&strcmp(argv[1],"tcp")==0);
+	const int sessions=argc>2?atoi(argv[2]):16;
+	const int blockSize=argc>3?atoi(argv[3]):4096;
+	const double seconds=argc>4?atof(argv[4]):5;
+	//抽象命名空间的地址，不在文件系统里留下socket文件
+	const InetAddress addr=useUnix?InetAddress::fromUnixPath("@mymuduo-uds-bench"):InetAddress(9984);
+
+	EventLoop loop;
+	TcpServer server(&loop,addr,"UdsBenchServer");
+	server.setBorrowedMessageCallback([](TcpConnection& conn,Buffer* buf,Timestamp){
+		conn.send(buf);
+	});
+	server.setThreadNum(1);
+	server.start();
+
+	EventLoopThreadPool clientPool(&loop,"UdsBenchClient");
+	clientPool.setThreadNum(1);
+	clientPool.start();
+	const std::string block(blockSize,'u');
+	std::vector<std::unique_ptr<TcpClient>> clients;
+	for(int i=0;i<sessions;++i){
+		std::unique_ptr<TcpClient> client(new TcpClient(clientPool.getNextLoop(),addr,"UdsBenchClient"));
+		client->setConnectionCallback([block](const TcpConnectionPtr& conn){
+			if(conn->connected()){
+				conn->setTcpNoDelay(true);
+				conn->send(block);
+			}
+		});
+		client->setBorrowedMessageCallback([](TcpConnection& conn,Buffer* buf,Timestamp){
+			g_bytes.fetch_add(buf->readableBytes(),std::memory_order_relaxed);
+			conn.send(buf);
+		});
+		client->connect();
+		clients.push_back(std::move(client));
+	}
+
+	loop.runAfter(seconds,[&](){
+		fprintf(stderr,"%s: %d sessions, %d byte blocks, %.2f MiB/s\n",
+			useUnix?"unix":"tcp",sessions,blockSize,g_bytes.load()/seconds/1024/1024);
+		for(const std::unique_ptr<TcpClient>& client:clients){
+			TcpConnectionPtr conn=client->connection();
+			if(conn){
+				conn->forceClose();
+			}
+		}
+		//TcpClient要在自己的loop线程里、loop退出之前析构
+		loop.runAfter(0.5,[&](){
+			clientPool.getNextLoop()->runInLoop([&](){
+				clients.clear();
+				loop.quit();
+			});
+		});
+	});
+	loop.loop();
+	return 0;
+}